@@ -1,3 +1,6 @@
 C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shaders/shader.vert -o shaders/vert.spv
 C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shaders/shader.frag -o shaders/frag.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shaders/mesh.vert -o shaders/mesh_vert.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shaders/meshlet_cull.comp -o shaders/meshlet_cull.spv
+C:/VulkanSDK/1.3.231.1/Bin/glslc.exe shaders/object_cull.comp -o shaders/object_cull.spv
 pause
\ No newline at end of file
@@ -0,0 +1,58 @@
+#version 450
+
+layout(binding = 0) uniform uniformBufferObject
+{
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+} ubo;
+
+//undoes the load-time vertex quantization, value = fetched * scale + offset
+layout(push_constant) uniform dequantization
+{
+    vec4 positionScale;
+    //w = 1 when normals are octahedral-encoded
+    vec4 positionOffset;
+    vec4 coordScaleOffset;
+} pc;
+
+//snorm/unorm/half formats arrive already converted to float, missing components read as 0
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aCoord;
+
+//per-instance stream, the object's affine transform as its top three rows and its material
+layout(location = 3) in vec4 aModelRow0;
+layout(location = 4) in vec4 aModelRow1;
+layout(location = 5) in vec4 aModelRow2;
+layout(location = 6) in uint aMaterial;
+
+layout(location = 0) out vec3 v_Color;
+layout(location = 1) out vec2 v_Coord;
+
+//stand-in until materials carry real parameters, material 0 leaves the color untouched
+const vec3 materialTints[4] = vec3[](vec3(1.0), vec3(1.0, 0.6, 0.5), vec3(0.5, 0.9, 0.6), vec3(0.6, 0.7, 1.0));
+
+mat4 InstanceTransform()
+{
+    return transpose(mat4(aModelRow0, aModelRow1, aModelRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+vec3 DecodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = aPosition * pc.positionScale.xyz + pc.positionOffset.xyz;
+    vec3 normal = pc.positionOffset.w > 0.5 ? DecodeOctahedral(aNormal.xy) : aNormal;
+    //no lighting yet, the normal is shown as a color
+    mat4 model = ubo.model * InstanceTransform();
+    v_Color = (normalize(mat3(model) * normal) * 0.5 + 0.5) * materialTints[aMaterial % 4u];
+    v_Coord = aCoord * pc.coordScaleOffset.xy + pc.coordScaleOffset.zw;
+    gl_Position = ubo.projection * ubo.view * model * vec4(position, 1.0);
+}
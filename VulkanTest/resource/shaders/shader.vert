@@ -11,11 +11,25 @@ layout(location = 0) in vec2 aPosition;
 layout(location = 1) in vec3 aColor;
 layout(location = 2) in vec2 aCoord;
 
+//per-instance stream, the object's affine transform as its top three rows and its material
+layout(location = 3) in vec4 aModelRow0;
+layout(location = 4) in vec4 aModelRow1;
+layout(location = 5) in vec4 aModelRow2;
+layout(location = 6) in uint aMaterial;
+
 layout(location = 0) out vec3 v_Color;
 layout(location = 1) out vec2 v_Coord;
 
+//stand-in until materials carry real parameters, material 0 leaves the color untouched
+const vec3 materialTints[4] = vec3[](vec3(1.0), vec3(1.0, 0.6, 0.5), vec3(0.5, 0.9, 0.6), vec3(0.6, 0.7, 1.0));
+
+mat4 InstanceTransform()
+{
+    return transpose(mat4(aModelRow0, aModelRow1, aModelRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
 void main() {
-    v_Color = aColor;
+    v_Color = aColor * materialTints[aMaterial % 4u];
     v_Coord = aCoord;
-    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(aPosition, 0.0, 1.0);
+    gl_Position = ubo.projection * ubo.view * ubo.model * InstanceTransform() * vec4(aPosition, 0.0, 1.0);
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <cstdint>
 #include <chrono>
+#include <cctype>
+#include <cmath>
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <stb_image.h>
@@ -12,7 +14,9 @@
 #include "Application.h"
 #include "../utils/readFile.h"
 
-static const uint32_t MAX_FRAME_IN_FLIGHT = 2;
+//per-frame budget for uniform data handed out by the ring
+static const vk::DeviceSize UNIFORM_RING_FRAME_SIZE = 1 << 20;
+static const vk::DeviceSize STAGING_RING_SIZE = 32 << 20;
 const std::vector<const char*> validationLayers =
 {
 	"VK_LAYER_KHRONOS_validation"
@@ -20,45 +24,146 @@ const std::vector<const char*> validationLayers =
 
 void Application::InitWindow()
 {
+	if (m_Config.Headless)
+	{
+		return;
+	}
+
 	if (!glfwInit())
 	{
 		std::cout << "init glfw failed!" << std::endl;
 	}
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
 
-	m_Window = glfwCreateWindow(1024, 768, "Vulkan", nullptr, nullptr);
+	m_Window = glfwCreateWindow(m_Config.Width, m_Config.Height, "Vulkan", nullptr, nullptr);
 	if (!m_Window)
 	{
 		std::cout << "create Window failed!" << std::endl;
 	}
+	glfwSetWindowUserPointer(m_Window, this);
+	glfwSetFramebufferSizeCallback(m_Window, FramebufferResizeCallback);
+	glfwSetMouseButtonCallback(m_Window, MouseButtonCallback);
+}
+
+void Application::FramebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+	//not every platform reports out-of-date after a resize, so do not wait for the driver to tell us
+	Application* app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+	app->m_SwapChainDirty = true;
+}
+
+void Application::MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+	{
+		Application* app = static_cast<Application*>(glfwGetWindowUserPointer(window));
+		double x, y;
+		glfwGetCursorPos(window, &x, &y);
+		app->PickObject(x, y);
+	}
+}
+
+void Application::PickObject(double x, double y)
+{
+	int width, height;
+	glfwGetWindowSize(m_Window, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		return;
+	}
+	//the ray starts at the eye and goes through the cursor on the far plane, in the space the objects live in
+	//(before ubo.model). the projection's y is already flipped, so window y maps to NDC y directly
+	glm::mat4 modelView = m_FrameUniforms.view * m_FrameUniforms.model;
+	glm::vec3 eye = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	glm::vec2 ndc = glm::vec2(x / width, y / height) * 2.0f - 1.0f;
+	glm::vec4 farPoint = glm::inverse(m_FrameUniforms.projection * modelView) * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - eye;
+
+	uint32_t object;
+	float distance;
+	if (m_Bvh.Raycast(eye, direction, 1.0f, object, distance))
+	{
+		glm::vec4 sphere = m_Scene.Spheres[object];
+		std::cout << "picked object " << object << " at (" << sphere.x << ", " << sphere.y << ", " << sphere.z << ")" << std::endl;
+	}
+	else
+	{
+		std::cout << "picked nothing" << std::endl;
+	}
 }
 
 void Application::MainLoop()
 {
-	while (!glfwWindowShouldClose(m_Window))
+	double frameRate = m_Config.FrameRateCap;
+	if (m_Config.Present == PresentPolicy::Capped && frameRate == 0 && !m_Config.Headless)
+	{
+		const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		frameRate = mode ? mode->refreshRate : 60;
+	}
+	m_FrameLimiter.SetTargetRate(frameRate);
+
+	if (m_Config.Headless)
+	{
+		uint32_t frameCount = m_Config.FrameCount > 0 ? m_Config.FrameCount : 1000;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			m_FrameLimiter.Wait();
+			DrawFrame();
+		}
+		m_LogicDevice.waitIdle();
+		float seconds = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+		std::cout << "headless: " << frameCount << " frames in " << seconds << "s (" << frameCount / seconds << " fps)" << std::endl;
+		m_FrameStats.Print();
+		return;
+	}
+
+	uint32_t frame = 0;
+	while (!glfwWindowShouldClose(m_Window) && (m_Config.FrameCount == 0 || frame++ < m_Config.FrameCount))
 	{
+		//sleep before polling so the input the frame is built from is as fresh as possible
+		m_FrameLimiter.Wait();
 		glfwPollEvents();
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(m_Window, &width, &height);
+		if (width == 0 || height == 0)
+		{
+			//minimized: there is nothing to present to, sleep until the window comes back
+			glfwWaitEvents();
+			continue;
+		}
 		DrawFrame();
 	}
+	m_LogicDevice.waitIdle();
+	std::cout << "swapchain: recreated " << m_SwapChainRecreations << " times" << std::endl;
+	m_FrameStats.Print();
 }
 
 void Application::Cleanup()
 {
-	for (size_t i = 0; i < MAX_FRAME_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_ImageAvailableSemaphores.size(); i++)
 	{
 		m_LogicDevice.destroySemaphore(m_ImageAvailableSemaphores[i]);
 		m_LogicDevice.destroySemaphore(m_RenderFinishedSemaphores[i]);
-		m_LogicDevice.destroyFence(m_InFlightFences[i]);
 	}
-	m_LogicDevice.destroyCommandPool(m_CommandPool);
+	//MainLoop idled the device, whatever is still queued can go now
+	m_Deletions.Flush();
+	m_FrameTimeline.Destroy();
+	m_Recorder.Destroy();
 	
 	for (auto& fb : m_FrameBuffers)
 	{
 		m_LogicDevice.destroyFramebuffer(fb);
 	}
-	m_LogicDevice.destroyPipeline(m_Pipeline);
+	if (!m_Config.PipelineWarmupPath.empty())
+	{
+		m_PipelineRegistry.SaveWarmupList(m_Config.PipelineWarmupPath);
+	}
+	m_PipelineRegistry.Destroy();
+	m_PipelineCache.Save();
+	m_PipelineCache.Destroy();
 	m_LogicDevice.destroyPipelineLayout(m_PipelineLayout);
 	m_LogicDevice.destroyRenderPass(m_Renderpass);
 
@@ -66,51 +171,109 @@ void Application::Cleanup()
 	{
 		m_LogicDevice.destroyImageView(imageView);
 	}
-	m_LogicDevice.destroySwapchainKHR(m_SwapChain);
+	if (m_Config.Headless)
+	{
+		for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+		{
+			m_LogicDevice.destroyImage(m_SwapChainImages[i]);
+			m_Allocator.Free(m_OffscreenAllocations[i]);
+		}
+	}
+	else
+	{
+		m_LogicDevice.destroySwapchainKHR(m_SwapChain);
+	}
 
 	m_LogicDevice.destroyImage(m_Image);
-	m_LogicDevice.freeMemory(m_Memory);
+	m_Allocator.Free(m_ImageAllocation);
 
-	for (size_t i = 0; i < MAX_FRAME_IN_FLIGHT; i++)
+	m_UniformRing.Destroy();
+	if (m_UseCpuCulling)
 	{
-		m_LogicDevice.destroyBuffer(m_UniformBuffers[i]);
-		m_LogicDevice.freeMemory(m_UniformBufferMemory[i]);
+		m_InstanceRing.Destroy();
 	}
 
 	m_LogicDevice.destroyDescriptorSetLayout(m_DescriptorSetLayout);
+	m_MeshletCulling.Destroy();
+	m_ObjectCulling.Destroy();
+	m_LogicDevice.destroyBuffer(m_InstanceBuffer);
+	m_Allocator.Free(m_InstanceBufferAllocation);
 	m_LogicDevice.destroyBuffer(m_IndexBuffer);
-	m_LogicDevice.freeMemory(m_IndexBufferMemory);
+	m_Allocator.Free(m_IndexBufferAllocation);
 	m_LogicDevice.destroyBuffer(m_VertexBuffer);
-	m_LogicDevice.freeMemory(m_VertexBufferMemory);	
+	m_Allocator.Free(m_VertexBufferAllocation);
+	m_Uploads.Destroy();
+	m_RenderGraph.Reset();
+	m_Allocator.Destroy();
 
 	m_LogicDevice.destroy();
-	m_Vkinstance.destroySurfaceKHR(m_Surface);
+	if (!m_Config.Headless)
+	{
+		m_Vkinstance.destroySurfaceKHR(m_Surface);
+	}
 	m_Vkinstance.destroy();
-	glfwDestroyWindow(m_Window);
-	glfwTerminate();
+	if (!m_Config.Headless)
+	{
+		glfwDestroyWindow(m_Window);
+		glfwTerminate();
+	}
 }
 
 void Application::InitVulkan()
 {
+	m_Config.FramesInFlight = (std::max)(m_Config.FramesInFlight, 1u);
+	if (m_Config.Headless)
+	{
+		//no surface and no swapchain: frames go to device-owned color images
+		m_DeviceExtesions.clear();
+	}
 	CreateInstance();
-	CreateSurface();
+	if (!m_Config.Headless)
+	{
+		CreateSurface();
+	}
 	PickPhysicalDevice();
+	m_DynamicRendering = m_Config.DynamicRendering && m_DeviceCaps.DynamicRendering;
 	CreateLogicDevice();
-	CreateSwapChain();
+	m_Allocator.Init(m_PhyiscalDevice, m_LogicDevice);
+	QueueFamilyIndices indices = FindQueueFamilies(m_PhyiscalDevice);
+	m_Uploads.Init(m_LogicDevice, &m_Allocator, m_TransferQueue, indices.TransferFamily.value_or(indices.GraphicFamily.value()),
+		m_GraphicQueue, indices.GraphicFamily.value(), STAGING_RING_SIZE, m_DeviceCaps.TimelineSemaphore, m_DeviceCaps.Synchronization2);
+	m_PipelineCache.Load(m_LogicDevice, m_PhyiscalDevice.getProperties(), m_Config.PipelineCachePath);
+	if (m_Config.Headless)
+	{
+		CreateOffscreenTargets();
+	}
+	else
+	{
+		CreateSwapChain();
+	}
 	CreateImageViews();
 	CreateRenderPass();
+	LoadMesh();
+	BuildScene();
 	createDescriptorSetLayout();
 	CreateGraphicsPipeline();
 	CreateFrameBuffer();
+	CreateRenderGraph();
+	//once here rather than on every Compile
+	m_RenderGraph.PrintSummary();
 	CreateCommandPool();
 	CreateImageTexture();
 	CreateSampler();
 	CreateVertexBuffer();
 	CreateIndexBuffer();
+	CreateInstanceBuffer();
+	CreateMeshletCulling();
+	CreateObjectCulling();
+	//texture, vertex, index, instance and culling data all go out in one submission
+	m_Uploads.Wait(m_Uploads.Flush());
+	m_Mesh = MeshData();
+	m_Meshlets = MeshletData();
+	std::vector<uint8_t>().swap(m_PackedVertices.Data);
 	CreateUniformBuffers();
 	CreateDescriptorPool();
 	CreateDescriptorSets();
-	CreateCommandBuffer();
 	CreateSyncObjects();
 }
 
@@ -121,19 +284,28 @@ void Application::CreateInstance()
 	appInfo.setPApplicationName("vulkanTest")
 		   .setApiVersion(VK_API_VERSION_1_3);
 
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
-	
-	extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	std::vector<const char*> extensions;
+	if (!m_Config.Headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
+
+	bool enableValidation = CheckValidationLayerSupport();
+	if (enableValidation)
+	{
+		//render nodes usually ship without the SDK layers, only ask for debug utils alongside them
+		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
 	vk::InstanceCreateInfo instanceInfo{};
 	instanceInfo.sType = vk::StructureType::eInstanceCreateInfo;
 	instanceInfo.setPApplicationInfo(&appInfo)
 			    .setEnabledExtensionCount(extensions.size())
 			    .setPpEnabledExtensionNames(extensions.data());
 
-	if (CheckValidationLayerSupport())
+	if (enableValidation)
 	{
 		//default enalbe validationLayer
 		instanceInfo.setEnabledLayerCount(validationLayers.size())
@@ -169,7 +341,6 @@ bool Application::CheckValidationLayerSupport()
 
 void Application::PickPhysicalDevice()
 {
-	uint32_t phisicalDeviceCount = 0;
 	auto devices = m_Vkinstance.enumeratePhysicalDevices();
 	
 	if (devices.size() == 0)
@@ -177,64 +348,226 @@ void Application::PickPhysicalDevice()
 		throw std::runtime_error("can not found device!");
 	}
 
-
+	int64_t bestScore = -1;
 	for (auto& device : devices)
 	{
-		if (IsDeviceSuitable(device))
+		if (!IsDeviceSuitable(device))
 		{
+			continue;
+		}
+		DeviceCapabilities capabilities = QueryDeviceCapabilities(device);
+		int64_t score = RateDevice(capabilities);
+		std::cout << "device: " << capabilities.Name << " score: " << score << std::endl;
+
+		if (!m_Config.DeviceOverride.empty())
+		{
+			//an explicit override wins over any score
+			if (MatchesDeviceOverride(device))
+			{
+				m_PhyiscalDevice = device;
+				m_DeviceCaps = capabilities;
+				break;
+			}
+			continue;
+		}
+		if (score > bestScore)
+		{
+			bestScore = score;
 			m_PhyiscalDevice = device;
+			m_DeviceCaps = capabilities;
 		}
 	}
 	if (!m_PhyiscalDevice)
 	{
+		if (!m_Config.DeviceOverride.empty())
+		{
+			throw std::runtime_error("no suitable device matches '" + m_Config.DeviceOverride + "'!");
+		}
 		throw std::runtime_error("can not found stuitable device!");
 	}
+	std::cout << "picked device: " << m_DeviceCaps.Name
+			  << " (timelineSemaphore " << m_DeviceCaps.TimelineSemaphore
+			  << ", synchronization2 " << m_DeviceCaps.Synchronization2
+			  << ", dynamicRendering " << m_DeviceCaps.DynamicRendering
+			  << ", descriptorIndexing " << m_DeviceCaps.DescriptorIndexing
+			  << ", drawIndirectCount " << m_DeviceCaps.DrawIndirectCount
+			  << ", drawIndirectFirstInstance " << m_DeviceCaps.DrawIndirectFirstInstance
+			  << ", meshShader " << m_DeviceCaps.MeshShader << ")" << std::endl;
 }
 
 bool Application::IsDeviceSuitable(const vk::PhysicalDevice& device)
 {
 	bool isDeviceExtensionSupport = false;
-
-	vk::PhysicalDeviceProperties properties = device.getProperties();
-	vk::PhysicalDeviceFeatures features = device.getFeatures();
 	
 	QueueFamilyIndices indices = FindQueueFamilies(device);
 	
 	isDeviceExtensionSupport = IsDeviceExtensionSupport(device);
-	SwapChainSupportDetail swapChainsupport = QuerySwapChainSupport(device);
-
+	bool swapChainsupport = m_Config.Headless || QuerySwapChainSupport(device);
+	//frame pacing is built on a timeline semaphore
+	bool timelineSupport = QueryDeviceCapabilities(device).TimelineSemaphore;
 
 	return  indices.IsComplete() && 
 			isDeviceExtensionSupport &&
 			swapChainsupport &&
-			properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu &&
-		    features.geometryShader;
+			timelineSupport;
+}
+
+DeviceCapabilities Application::QueryDeviceCapabilities(const vk::PhysicalDevice& device)
+{
+	DeviceCapabilities capabilities;
+	vk::PhysicalDeviceProperties properties = device.getProperties();
+	capabilities.Name = properties.deviceName.data();
+	capabilities.ApiVersion = properties.apiVersion;
+	capabilities.Type = properties.deviceType;
+
+	vk::PhysicalDeviceMemoryProperties memoryProperties = device.getMemoryProperties();
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if (memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+		{
+			capabilities.DeviceLocalBytes += memoryProperties.memoryHeaps[i].size;
+		}
+	}
+
+	QueueFamilyIndices indices = FindQueueFamilies(device);
+	capabilities.UnifiedGraphicsPresent = indices.IsComplete() && indices.GraphicFamily == indices.PresentFamily;
+	capabilities.DedicatedTransferQueue = indices.TransferFamily.has_value();
+	for (auto& family : device.getQueueFamilyProperties())
+	{
+		bool graphics = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eGraphics);
+		bool compute = static_cast<bool>(family.queueFlags & vk::QueueFlagBits::eCompute);
+		if (compute && !graphics)
+		{
+			capabilities.AsyncComputeQueue = true;
+		}
+	}
+
+	//feature structs are only valid to chain for the core version the device implements
+	vk::PhysicalDeviceVulkan12Features features12{};
+	vk::PhysicalDeviceVulkan13Features features13{};
+	vk::PhysicalDeviceFeatures2 features2{};
+	if (capabilities.SupportsApi(VK_API_VERSION_1_2))
+	{
+		features2.setPNext(&features12);
+		if (capabilities.SupportsApi(VK_API_VERSION_1_3))
+		{
+			features12.setPNext(&features13);
+		}
+		device.getFeatures2(&features2);
+	}
+	capabilities.TimelineSemaphore = features12.timelineSemaphore;
+	capabilities.DescriptorIndexing = features12.descriptorIndexing;
+	capabilities.Synchronization2 = features13.synchronization2;
+	capabilities.DynamicRendering = features13.dynamicRendering;
+	capabilities.DrawIndirectCount = features12.drawIndirectCount;
+	vk::PhysicalDeviceFeatures features = device.getFeatures();
+	capabilities.MultiDrawIndirect = features.multiDrawIndirect;
+	capabilities.DrawIndirectFirstInstance = features.drawIndirectFirstInstance;
+	for (auto& extension : device.enumerateDeviceExtensionProperties())
+	{
+		if (std::string(extension.extensionName.data()) == VK_EXT_MESH_SHADER_EXTENSION_NAME)
+		{
+			capabilities.MeshShader = true;
+		}
+	}
+	return capabilities;
+}
+
+int64_t Application::RateDevice(const DeviceCapabilities& capabilities)
+{
+	int64_t score = 0;
+	switch (capabilities.Type)
+	{
+	case vk::PhysicalDeviceType::eDiscreteGpu:   score += 10000; break;
+	case vk::PhysicalDeviceType::eIntegratedGpu: score += 5000;  break;
+	case vk::PhysicalDeviceType::eVirtualGpu:    score += 2500;  break;
+	case vk::PhysicalDeviceType::eCpu:           score += 1000;  break;
+	default: break;
+	}
+
+	//one point per 256MB of device-local memory, capped so it never outweighs the device type
+	score += (std::min)(static_cast<int64_t>(capabilities.DeviceLocalBytes >> 28), static_cast<int64_t>(2000));
+
+	if (capabilities.DedicatedTransferQueue) score += 300;
+	if (capabilities.AsyncComputeQueue)      score += 200;
+	if (capabilities.UnifiedGraphicsPresent) score += 100;
+
+	if (capabilities.TimelineSemaphore)  score += 400;
+	if (capabilities.Synchronization2)   score += 300;
+	if (capabilities.DynamicRendering)   score += 300;
+	if (capabilities.DescriptorIndexing) score += 200;
+	return score;
+}
+
+bool Application::MatchesDeviceOverride(const vk::PhysicalDevice& device)
+{
+	auto lower = [](std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return text;
+	};
+	std::string wanted = lower(m_Config.DeviceOverride);
+	wanted.erase(std::remove(wanted.begin(), wanted.end(), '-'), wanted.end());
+
+	vk::PhysicalDeviceProperties properties = device.getProperties();
+	if (lower(properties.deviceName.data()).find(wanted) != std::string::npos)
+	{
+		return true;
+	}
+
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return false;
+	}
+	vk::PhysicalDeviceIDProperties idProperties{};
+	vk::PhysicalDeviceProperties2 properties2{};
+	properties2.setPNext(&idProperties);
+	device.getProperties2(&properties2);
+
+	static const char* hex = "0123456789abcdef";
+	std::string uuid;
+	for (uint8_t byte : idProperties.deviceUUID)
+	{
+		uuid += hex[byte >> 4];
+		uuid += hex[byte & 0xF];
+	}
+	return uuid == wanted;
 }
 
 Application::QueueFamilyIndices Application::FindQueueFamilies(const vk::PhysicalDevice& device)
 {
 	QueueFamilyIndices indices;
 	auto properties = device.getQueueFamilyProperties();
-	int i = 0;
+	uint32_t i = 0;
 	
 	for (auto& property : properties)
 	{		
-		if (property.queueFlags & vk::QueueFlagBits::eGraphics)
+		if (!indices.GraphicFamily.has_value() && (property.queueFlags & vk::QueueFlagBits::eGraphics))
 		{
 			indices.GraphicFamily = i;
 		}
 
-		VkBool32 presentSupport = false;
-		device.getSurfaceSupportKHR(i, m_Surface, &presentSupport);
-		
-		if (presentSupport)
+		if (m_Config.Headless)
+		{
+			//nothing is presented, the graphics queue stands in for the present queue
+			indices.PresentFamily = indices.GraphicFamily;
+		}
+		else if (!indices.PresentFamily.has_value())
 		{
-			indices.PresentFamily = i;
+			VkBool32 presentSupport = false;
+			device.getSurfaceSupportKHR(i, m_Surface, &presentSupport);
+			
+			if (presentSupport)
+			{
+				indices.PresentFamily = i;
+			}
 		}
 
-		if (indices.IsComplete())
+		//keep scanning after graphics and present are found, the transfer-only family usually comes last
+		if (!indices.TransferFamily.has_value() && (property.queueFlags & vk::QueueFlagBits::eTransfer) &&
+			!(property.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
 		{
-			break;
+			indices.TransferFamily = i;
 		}
 		i++;
 	}
@@ -247,6 +580,10 @@ void Application::CreateLogicDevice()
 	QueueFamilyIndices indices = FindQueueFamilies(m_PhyiscalDevice);
 	std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = { indices.GraphicFamily.value(), indices.PresentFamily.value() };
+	if (indices.TransferFamily.has_value())
+	{
+		uniqueQueueFamilies.insert(indices.TransferFamily.value());
+	}
 	for (auto& queueIndex : uniqueQueueFamilies)
 	{
 		vk::DeviceQueueCreateInfo queueCreateInfo{};
@@ -258,9 +595,28 @@ void Application::CreateLogicDevice()
 	}
 
 	vk::PhysicalDeviceFeatures deviceFeatures{};
+	deviceFeatures.setMultiDrawIndirect(m_DeviceCaps.MultiDrawIndirect)
+				  .setDrawIndirectFirstInstance(m_DeviceCaps.DrawIndirectFirstInstance);
+
+	//turn on every optional feature the device reported so later code can take the fast path
+	vk::PhysicalDeviceVulkan12Features features12{};
+	features12.setTimelineSemaphore(m_DeviceCaps.TimelineSemaphore)
+			  .setDescriptorIndexing(m_DeviceCaps.DescriptorIndexing)
+			  .setDrawIndirectCount(m_DeviceCaps.DrawIndirectCount);
+	vk::PhysicalDeviceVulkan13Features features13{};
+	features13.setSynchronization2(m_DeviceCaps.Synchronization2)
+			  .setDynamicRendering(m_DeviceCaps.DynamicRendering);
+	if (m_DeviceCaps.SupportsApi(VK_API_VERSION_1_3))
+	{
+		features12.setPNext(&features13);
+	}
 
 	vk::DeviceCreateInfo createInfo{};
 	createInfo.sType = vk::StructureType::eDeviceCreateInfo;
+	if (m_DeviceCaps.SupportsApi(VK_API_VERSION_1_2))
+	{
+		createInfo.setPNext(&features12);
+	}
 	createInfo.setQueueCreateInfoCount(static_cast<uint32_t>(uniqueQueueFamilies.size()))
 			  .setPQueueCreateInfos(queueCreateInfos.data())
 			  .setPEnabledFeatures(&deviceFeatures)
@@ -275,10 +631,13 @@ void Application::CreateLogicDevice()
 	}
 	m_GraphicQueue = m_LogicDevice.getQueue(indices.GraphicFamily.value(), 0);
 	m_PresentQueue = m_LogicDevice.getQueue(indices.PresentFamily.value(), 0);
+	//without a dedicated family uploads share the graphics queue
+	m_TransferQueue = indices.TransferFamily.has_value() ? m_LogicDevice.getQueue(indices.TransferFamily.value(), 0) : m_GraphicQueue;
 }
 
 void Application::CreateSurface()
 {
+#ifdef _WIN32
 	vk::Win32SurfaceCreateInfoKHR surfaceInfo{};
 	surfaceInfo.sType = vk::StructureType::eWin32SurfaceCreateInfoKHR;
 	surfaceInfo.setHwnd(glfwGetWin32Window(m_Window))
@@ -287,6 +646,14 @@ void Application::CreateSurface()
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
+#else
+	VkSurfaceKHR surface;
+	if (glfwCreateWindowSurface(static_cast<VkInstance>(m_Vkinstance), m_Window, nullptr, &surface) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create window surface!");
+	}
+	m_Surface = surface;
+#endif
 }
 
 bool Application::IsDeviceExtensionSupport(const vk::PhysicalDevice& device)
@@ -309,10 +676,21 @@ Application::SwapChainSupportDetail Application::QuerySwapChainSupport(const vk:
 	return swapChainDetail;
 }
 
-void Application::CreateSwapChain()
+void Application::CreateSwapChain(vk::SwapchainKHR oldSwapChain)
 {
 	SwapChainSupportDetail detail = QuerySwapChainSupport(m_PhyiscalDevice);
 	vk::SurfaceFormatKHR format = ChooseSwapSurfaceFormat(detail.formats);
+	if (oldSwapChain && !m_DynamicRendering)
+	{
+		//the render pass and pipelines are built for the current format, keep it as long as the surface offers it
+		auto current = std::find_if(detail.formats.begin(), detail.formats.end(),
+			[this](const vk::SurfaceFormatKHR& candidate) { return candidate.format == m_SwapChainFormat; });
+		if (current == detail.formats.end())
+		{
+			throw std::runtime_error("surface no longer supports the swap chain format!");
+		}
+		format = *current;
+	}
 	vk::PresentModeKHR mode = ChooseSwapSurfacePresentMode(detail.presentModes);
 	vk::Extent2D extent = ChooseSwapExtent(detail.capabilities);
 
@@ -335,7 +713,7 @@ void Application::CreateSwapChain()
 				 .setPreTransform(detail.capabilities.currentTransform)
 				 .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
 				 .setClipped(VK_TRUE)
-				 .setOldSwapchain(VK_NULL_HANDLE);
+				 .setOldSwapchain(oldSwapChain);
 
 	QueueFamilyIndices indices = FindQueueFamilies(m_PhyiscalDevice);
 	uint32_t queueIndices[] = {indices.GraphicFamily.value(), indices.PresentFamily.value()};
@@ -360,6 +738,68 @@ void Application::CreateSwapChain()
 	m_SwapChainExtent = extent;
 }
 
+bool Application::RecreateSwapChain()
+{
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(m_Window, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		return false;
+	}
+	m_SwapChainDirty = false;
+
+	//the old chain is retired by handing it to the new one. it, its views and framebuffers and the graph built on
+	//them are destroyed once the last frame submitted against them has retired, nothing waits for the device here
+	vk::SwapchainKHR oldSwapChain = m_SwapChain;
+	std::vector<vk::ImageView> oldViews = std::move(m_ImageViews);
+	std::vector<vk::Framebuffer> oldFrameBuffers = std::move(m_FrameBuffers);
+	auto oldGraph = std::make_shared<RenderGraph>(std::move(m_RenderGraph));
+	m_ImageViews.clear();
+	m_FrameBuffers.clear();
+	m_RenderGraph = RenderGraph();
+
+	vk::Format oldFormat = m_SwapChainFormat;
+	CreateSwapChain(oldSwapChain);
+	CreateImageViews();
+	CreateFrameBuffer();
+	CreateRenderGraph();
+	if (m_SwapChainFormat != oldFormat)
+	{
+		//only possible with dynamic rendering, where a pipeline for the new format is all it takes
+		m_PipelineDesc.ColorFormat = m_SwapChainFormat;
+		m_PipelineKey = m_PipelineRegistry.Request(m_PipelineDesc);
+	}
+
+	m_Deletions.Push(m_FrameTimeline.GetFrame(), [this, oldSwapChain, oldViews, oldFrameBuffers, oldGraph]()
+	{
+		for (auto& framebuffer : oldFrameBuffers)
+		{
+			m_LogicDevice.destroyFramebuffer(framebuffer);
+		}
+		for (auto& view : oldViews)
+		{
+			m_LogicDevice.destroyImageView(view);
+		}
+		oldGraph->Reset();
+		m_LogicDevice.destroySwapchainKHR(oldSwapChain);
+	});
+	m_SwapChainRecreations++;
+	return true;
+}
+
+void Application::CreateOffscreenTargets()
+{
+	//one color target per frame in flight so consecutive frames never write the same image
+	m_SwapChainFormat = vk::Format::eR8G8B8A8Unorm;
+	m_SwapChainExtent = vk::Extent2D(m_Config.Width, m_Config.Height);
+	m_SwapChainImages.resize(m_Config.FramesInFlight);
+	m_OffscreenAllocations.resize(m_Config.FramesInFlight);
+	for (size_t i = 0; i < m_Config.FramesInFlight; i++)
+	{
+		CreateImage(m_SwapChainExtent.width, m_SwapChainExtent.height, m_SwapChainFormat, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, m_SwapChainImages[i], m_OffscreenAllocations[i]);
+	}
+}
+
 vk::SurfaceFormatKHR Application::ChooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& formats)
 {
 	vk::SurfaceFormatKHR res = formats[0];
@@ -375,12 +815,26 @@ vk::SurfaceFormatKHR Application::ChooseSwapSurfaceFormat(const std::vector<vk::
 
 vk::PresentModeKHR Application::ChooseSwapSurfacePresentMode(const std::vector<vk::PresentModeKHR>& presentModes)
 {
+	std::vector<vk::PresentModeKHR> preferred;
+	switch (m_Config.Present)
+	{
+	case PresentPolicy::LowLatency:
+	case PresentPolicy::Capped:
+		preferred = { vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate };
+		break;
+	case PresentPolicy::Immediate:
+		preferred = { vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox };
+		break;
+	case PresentPolicy::VSync:
+		break;
+	}
+	//fifo is the one mode every surface supports
 	vk::PresentModeKHR res = vk::PresentModeKHR::eFifo;
-	for (const auto& mode : presentModes)
+	for (auto wanted : preferred)
 	{
-		if (mode == vk::PresentModeKHR::eMailbox)
+		if (std::find(presentModes.begin(), presentModes.end(), wanted) != presentModes.end())
 		{
-			res = mode;
+			res = wanted;
 			break;
 		}
 	}
@@ -420,102 +874,23 @@ void Application::CreateImageViews()
 
 void Application::CreateGraphicsPipeline()
 {
-	#pragma region shader
-	std::vector<char> vertexShaderCode    = ReadFile("resource/shaders/vert.spv");
-	std::vector<char> fragmentShaderCode  = ReadFile("resource/shaders/frag.spv");
-	vk::ShaderModule vertexShaderModule   = CreateShaderModule(vertexShaderCode);
-	vk::ShaderModule fragmentShaderModule = CreateShaderModule(fragmentShaderCode);
-	vk::PipelineShaderStageCreateInfo vertexShaderInfo{};
-	vertexShaderInfo.sType = vk::StructureType::ePipelineShaderStageCreateInfo;
-	vertexShaderInfo.setStage(vk::ShaderStageFlagBits::eVertex)
-					.setModule(vertexShaderModule)
-					.setPName("main");
-	
-	vk::PipelineShaderStageCreateInfo fragmentShaderInfo{};
-	fragmentShaderInfo.sType = vk::StructureType::ePipelineShaderStageCreateInfo;
-	fragmentShaderInfo.setStage(vk::ShaderStageFlagBits::eFragment)
-					  .setModule(fragmentShaderModule)
-					  .setPName("main");
-
-	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertexShaderInfo, fragmentShaderInfo };
-	#pragma endregion
-
-	#pragma region vertexInput
-	vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
-	vertexInputInfo.sType = vk::StructureType::ePipelineVertexInputStateCreateInfo;
-	vk::VertexInputBindingDescription vertexBinding = Vertex::GetBindingDescription();
-	std::vector<vk::VertexInputAttributeDescription> vertexAttributes = Vertex::GetAttribuDescription();
-	vertexInputInfo.setVertexBindingDescriptionCount(1)
-				   .setPVertexBindingDescriptions(&vertexBinding)
-				   .setVertexAttributeDescriptionCount(static_cast<uint32_t>(vertexAttributes.size()))
-				   .setPVertexAttributeDescriptions(vertexAttributes.data());
-	#pragma endregion
-
-	#pragma region inputAssembly
-	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
-	inputAssemblyInfo.sType = vk::StructureType::ePipelineInputAssemblyStateCreateInfo;
-	inputAssemblyInfo.setTopology(vk::PrimitiveTopology::eTriangleList)
-			         .setPrimitiveRestartEnable(VK_FALSE);
-	#pragma endregion
-
-	#pragma region viewport
-	vk::PipelineViewportStateCreateInfo viewportInfo{};
-	viewportInfo.sType = vk::StructureType::ePipelineViewportStateCreateInfo;
-	viewportInfo.setViewportCount(1)
-			    .setScissorCount(1);
-	#pragma endregion
-
-	#pragma region rasterizer
-	vk::PipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = vk::StructureType::ePipelineRasterizationStateCreateInfo;
-	rasterizer.setDepthClampEnable(VK_FALSE)
-			  .setRasterizerDiscardEnable(VK_FALSE)
-			  .setPolygonMode(vk::PolygonMode::eFill)
-			  .setLineWidth(1.0f)
-			  .setCullMode(vk::CullModeFlagBits::eBack)
-			  .setFrontFace(vk::FrontFace::eCounterClockwise)
-			  .setDepthBiasEnable(VK_FALSE);
-	#pragma endregion
-
-	#pragma region multisamples
-	vk::PipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = vk::StructureType::ePipelineMultisampleStateCreateInfo;
-	multisampling.setSampleShadingEnable(VK_FALSE)
-				 .setRasterizationSamples(vk::SampleCountFlagBits::e1);
-	#pragma endregion
-
-	#pragma region blending
-	vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA)
-						.setBlendEnable(VK_FALSE);
-
-	std::array<float, 4> blendConstants = { 0.0f, 0.0f, 0.0f, 0.0f };
-	vk::PipelineColorBlendStateCreateInfo colorBlending{};
-	colorBlending.sType = vk::StructureType::ePipelineColorBlendStateCreateInfo;
-	colorBlending.setLogicOpEnable(VK_FALSE)
-				 .setLogicOp(vk::LogicOp::eCopy)
-				 .setAttachmentCount(1)
-				 .setPAttachments(&colorBlendAttachment)
-				 .setBlendConstants(blendConstants);
-	#pragma endregion
-
-	#pragma region dynamicState
-	std::vector<vk::DynamicState> dynamicStates = {
-		vk::DynamicState::eViewport,
-		vk::DynamicState::eScissor
-	};
-	vk::PipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = vk::StructureType::ePipelineDynamicStateCreateInfo;
-	dynamicState.setDynamicStateCount(dynamicStates.size())
-		        .setPDynamicStates(dynamicStates.data());
-	#pragma endregion
-
 	#pragma region layout
+	//the mesh shader undoes the vertex quantization with per-mesh bounds
+	m_PipelineDesc.PushConstantRanges.clear();
+	if (m_HasMesh)
+	{
+		vk::PushConstantRange dequantizationRange;
+		dequantizationRange.setStageFlags(vk::ShaderStageFlagBits::eVertex)
+						   .setOffset(0)
+						   .setSize(sizeof(VertexDequantization));
+		m_PipelineDesc.PushConstantRanges.push_back(dequantizationRange);
+	}
 	vk::PipelineLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = vk::StructureType::ePipelineLayoutCreateInfo;
 	layoutInfo.setSetLayoutCount(1)
 			  .setPSetLayouts(&m_DescriptorSetLayout)
-		      .setPushConstantRangeCount(0);
+		      .setPushConstantRangeCount(static_cast<uint32_t>(m_PipelineDesc.PushConstantRanges.size()))
+			  .setPPushConstantRanges(m_PipelineDesc.PushConstantRanges.data());
 	if (m_LogicDevice.createPipelineLayout(&layoutInfo, nullptr, &m_PipelineLayout) != vk::Result::eSuccess)
 	{
 		throw std::runtime_error("failed to create pipeline layout!");
@@ -523,52 +898,41 @@ void Application::CreateGraphicsPipeline()
 	#pragma endregion	  
 
 	#pragma region pipeline
-	vk::GraphicsPipelineCreateInfo pipelineInfo{};
-	pipelineInfo.sType = vk::StructureType::eGraphicsPipelineCreateInfo;
-	pipelineInfo.setStageCount(2)
-				.setPStages(shaderStages)
-				.setPVertexInputState(&vertexInputInfo)
-				.setPInputAssemblyState(&inputAssemblyInfo)
-				.setPViewportState(&viewportInfo)
-				.setPRasterizationState(&rasterizer)
-				.setPMultisampleState(&multisampling)
-				.setPDepthStencilState(nullptr)
-				.setPColorBlendState(&colorBlending)
-				.setPDynamicState(&dynamicState)
-				.setLayout(m_PipelineLayout)
-				.setRenderPass(m_Renderpass)
-				.setSubpass(0)
-				.setBasePipelineHandle(VK_NULL_HANDLE)
-				.setBasePipelineIndex(-1);
-	
-	if (m_LogicDevice.createGraphicsPipelines(nullptr, 1, &pipelineInfo, nullptr, &m_Pipeline) != vk::Result::eSuccess)
+	m_PipelineRegistry.Init(m_LogicDevice, &m_PipelineCache, m_PipelineLayout, m_DynamicRendering ? vk::RenderPass() : m_Renderpass,
+		m_DeviceCaps.SupportsApi(VK_API_VERSION_1_3));
+	if (!m_Config.PipelineWarmupPath.empty())
 	{
-		throw std::runtime_error("failed to create graphics pipeline!");
+		m_PipelineRegistry.LoadWarmupList(m_Config.PipelineWarmupPath, m_SwapChainFormat, m_PipelineDesc.PushConstantRanges);
 	}
-	#pragma endregion
-
-	m_LogicDevice.destroyShaderModule(vertexShaderModule, nullptr);
-	m_LogicDevice.destroyShaderModule(fragmentShaderModule, nullptr);
-}
-
-vk::ShaderModule Application::CreateShaderModule(const std::vector<char>& sourceCode)
-{
-	vk::ShaderModuleCreateInfo shaderModuleInfo{};
-	shaderModuleInfo.sType = vk::StructureType::eShaderModuleCreateInfo;
-	shaderModuleInfo.setPCode(reinterpret_cast<const uint32_t*>(sourceCode.data()))
-			        .setCodeSize(sourceCode.size());
 
-	vk::ShaderModule shaderModule;
-	
-	if (m_LogicDevice.createShaderModule(&shaderModuleInfo, nullptr, &shaderModule) != vk::Result::eSuccess)
+	m_PipelineDesc.VertexShader = m_HasMesh ? "resource/shaders/mesh_vert.spv" : "resource/shaders/vert.spv";
+	m_PipelineDesc.FragmentShader = "resource/shaders/frag.spv";
+	if (m_HasMesh)
+	{
+		//the packed format is picked at runtime, its layout comes from the encoder
+		m_PipelineDesc.Bindings = { GetMeshBindingDescription(m_PackedVertices), InstanceStream::GetBinding() };
+		m_PipelineDesc.Attributes = GetMeshAttributeDescription(m_PackedVertices);
+		for (const auto& attribute : InstanceStream::GetAttributes())
+		{
+			m_PipelineDesc.Attributes.push_back(attribute);
+		}
+	}
+	else
 	{
-		throw std::runtime_error("failed to create shader module!");
+		m_PipelineDesc.SetVertexLayout<VertexLayoutType>();
 	}
-	return shaderModule;
+	m_PipelineDesc.ColorFormat = m_SwapChainFormat;
+	//compiles in the background while the rest of InitVulkan runs, the first draw picks it up
+	m_PipelineKey = m_PipelineRegistry.Request(m_PipelineDesc);
+	#pragma endregion
 }
 
 void Application::CreateRenderPass()
 {
+	if (m_DynamicRendering)
+	{
+		return;
+	}
 	vk::AttachmentDescription colorAttachment{};
 	colorAttachment.setFormat(m_SwapChainFormat)
 				   .setSamples(vk::SampleCountFlagBits::e1)
@@ -576,8 +940,9 @@ void Application::CreateRenderPass()
 				   .setStoreOp(vk::AttachmentStoreOp::eStore)
 				   .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
 				   .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
-				   .setInitialLayout(vk::ImageLayout::eUndefined)
-				   .setFinalLayout(vk::ImageLayout::ePresentSrcKHR);
+				   //the render graph moves the image in and out of the attachment layout, the render pass never transitions it
+				   .setInitialLayout(vk::ImageLayout::eColorAttachmentOptimal)
+				   .setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
 	
 	vk::AttachmentReference colorAttachmentRef{};
 	colorAttachmentRef.setAttachment(0)
@@ -587,24 +952,14 @@ void Application::CreateRenderPass()
 	subpassInfo.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
 			   .setColorAttachmentCount(1)
 			   .setPColorAttachments(&colorAttachmentRef);
-	
-	vk::SubpassDependency dependencyInfo{};
-	
-	dependencyInfo.setSrcSubpass(VK_SUBPASS_EXTERNAL)
-				  .setDstSubpass(0)
-				  .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-				  .setSrcAccessMask(vk::AccessFlagBits::eNone)
-				  .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-				  .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+
 
 	vk::RenderPassCreateInfo renderPassInfo{};
 	renderPassInfo.sType = vk::StructureType::eRenderPassCreateInfo;
 	renderPassInfo.setAttachmentCount(1)
 			      .setPAttachments(&colorAttachment)
 			      .setSubpassCount(1)
-			      .setPSubpasses(&subpassInfo)
-			      .setDependencyCount(1)
-			      .setPDependencies(&dependencyInfo);
+			      .setPSubpasses(&subpassInfo);
 	
 	if (m_LogicDevice.createRenderPass(&renderPassInfo, nullptr, &m_Renderpass) != vk::Result::eSuccess)
 	{
@@ -614,6 +969,10 @@ void Application::CreateRenderPass()
 
 void Application::CreateFrameBuffer()
 {
+	if (m_DynamicRendering)
+	{
+		return;
+	}
 	m_FrameBuffers.resize(m_ImageViews.size());
 	for (uint32_t i = 0; i < m_ImageViews.size(); i++)
 	{
@@ -637,140 +996,318 @@ void Application::CreateFrameBuffer()
 
 void Application::CreateCommandPool()
 {
-	vk::CommandPoolCreateInfo commandpoolInfo{};
 	QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(m_PhyiscalDevice);
-	commandpoolInfo.sType = vk::StructureType::eCommandPoolCreateInfo;
-	commandpoolInfo.setQueueFamilyIndex(queueFamilyIndices.GraphicFamily.value())
-			       .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
-	if (m_LogicDevice.createCommandPool(&commandpoolInfo, nullptr, &m_CommandPool) != vk::Result::eSuccess)
-	{
-		throw std::runtime_error("failed to create command pool!");
-	}
+	m_Recorder.Init(m_LogicDevice, queueFamilyIndices.GraphicFamily.value(), m_Config.FramesInFlight);
 }
 
-void Application::CreateCommandBuffer()
+void Application::CreateRenderGraph()
 {
-	vk::CommandBufferAllocateInfo commandBufferAllocInfo{};
-	commandBufferAllocInfo.sType = vk::StructureType::eCommandBufferAllocateInfo;
-	commandBufferAllocInfo.setCommandPool(m_CommandPool)
-						  .setCommandBufferCount(1)
-						  .setLevel(vk::CommandBufferLevel::ePrimary);
-	m_CommandBuffers.resize(MAX_FRAME_IN_FLIGHT);
-	for (size_t i = 0; i < MAX_FRAME_IN_FLIGHT; i++)
-	{
-		if (m_LogicDevice.allocateCommandBuffers(&commandBufferAllocInfo, &m_CommandBuffers[i]) != vk::Result::eSuccess)
-		{
-			throw std::runtime_error("failed to allocate command buffers!");
-		}
+	//offscreen frames are read back after rendering instead of presented
+	m_BackbufferHandle = m_RenderGraph.ImportImage("backbuffer", m_SwapChainFormat, m_SwapChainExtent, vk::ImageLayout::eUndefined,
+		vk::PipelineStageFlagBits2::eColorAttachmentOutput, m_Config.Headless ? ImageUsage::TransferSrc : ImageUsage::Present);
+	if (m_UseMeshlets)
+	{
+		//only touches its own buffers and places the barriers for them itself
+		m_RenderGraph.AddPass("meshlet cull", [this](vk::CommandBuffer commandBuffer) { RecordMeshletCull(commandBuffer); })
+					 .SideEffect();
 	}
+	if (m_UseGpuCulling)
+	{
+		m_RenderGraph.AddPass("object cull", [this](vk::CommandBuffer commandBuffer) { RecordObjectCull(commandBuffer); })
+					 .SideEffect();
+	}
+	m_RenderGraph.AddPass("main", [this](vk::CommandBuffer commandBuffer) { RecordMainPass(commandBuffer); })
+				 .Write(m_BackbufferHandle, ImageUsage::ColorAttachment);
+	m_RenderGraph.Compile(m_LogicDevice, &m_Allocator, m_DeviceCaps.Synchronization2);
 }
 
 void Application::RecordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex)
 {
 	vk::CommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = vk::StructureType::eCommandBufferBeginInfo;	
+	beginInfo.sType = vk::StructureType::eCommandBufferBeginInfo;
+	beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
 	if (commandBuffer.begin(&beginInfo) != vk::Result::eSuccess)
 	{
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
-		vk::Rect2D renderArea;
-		renderArea.setExtent(m_SwapChainExtent)
-			      .setOffset(vk::Offset2D(0, 0));
+	m_ImageIndex = imageIndex;
+	m_RenderGraph.SetImportedImage(m_BackbufferHandle, m_SwapChainImages[imageIndex], m_ImageViews[imageIndex]);
+	m_RenderGraph.Execute(commandBuffer);
+	commandBuffer.end();
+}
 
-		vk::ClearValue clearColor;
-		
+void Application::RecordMainPass(vk::CommandBuffer commandBuffer)
+{
+	vk::Rect2D renderArea;
+	renderArea.setExtent(m_SwapChainExtent)
+		      .setOffset(vk::Offset2D(0, 0));
+
+	vk::ClearValue clearColor;
+
+	vk::CommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = vk::StructureType::eCommandBufferInheritanceInfo;
+	vk::CommandBufferInheritanceRenderingInfo renderingInheritance{};
+	renderingInheritance.sType = vk::StructureType::eCommandBufferInheritanceRenderingInfo;
+	if (m_DynamicRendering)
+	{
+		vk::RenderingAttachmentInfo colorAttachment{};
+		colorAttachment.sType = vk::StructureType::eRenderingAttachmentInfo;
+		colorAttachment.setImageView(m_RenderGraph.GetImageView(m_BackbufferHandle))
+					   .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+					   .setLoadOp(vk::AttachmentLoadOp::eClear)
+					   .setStoreOp(vk::AttachmentStoreOp::eStore)
+					   .setClearValue(clearColor);
+
+		vk::RenderingInfo renderingInfo{};
+		renderingInfo.sType = vk::StructureType::eRenderingInfo;
+		renderingInfo.setFlags(vk::RenderingFlagBits::eContentsSecondaryCommandBuffers)
+					 .setRenderArea(renderArea)
+					 .setLayerCount(1)
+					 .setColorAttachmentCount(1)
+					 .setPColorAttachments(&colorAttachment);
+		commandBuffer.beginRendering(renderingInfo);
+
+		//secondaries only need the attachment formats, there is no render pass or framebuffer to name
+		renderingInheritance.setColorAttachmentCount(1)
+							.setPColorAttachmentFormats(&m_SwapChainFormat)
+							.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+		inheritanceInfo.setPNext(&renderingInheritance);
+	}
+	else
+	{
 		vk::RenderPassBeginInfo renderPassBeginInfo{};
 		renderPassBeginInfo.sType = vk::StructureType::eRenderPassBeginInfo;
 		renderPassBeginInfo.setRenderPass(m_Renderpass)
-						   .setFramebuffer(m_FrameBuffers[imageIndex])
+						   .setFramebuffer(m_FrameBuffers[m_ImageIndex])
 						   .setRenderArea(renderArea)
 						   .setClearValueCount(1)
 						   .setPClearValues(&clearColor);
+		commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
 
-		commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
-			commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_Pipeline);
-			vk::Viewport viewport{};
-			viewport.setX(0.0f)
-					.setY(0.0f)
-					.setWidth((float)m_SwapChainExtent.width)
-					.setHeight((float)m_SwapChainExtent.height)
-					.setMinDepth(0.0f)
-					.setMaxDepth(1.0f);
-			
-			commandBuffer.setViewport(0, 1, &viewport);
-
-			vk::Rect2D scissor{};
-			scissor.setOffset(vk::Offset2D(0, 0))
-				   .setExtent(m_SwapChainExtent);
+		inheritanceInfo.setRenderPass(m_Renderpass)
+					   .setSubpass(0)
+					   .setFramebuffer(m_FrameBuffers[m_ImageIndex]);
+	}
 
-			commandBuffer.setScissor(0, 1, &scissor);
+	//draws are recorded into secondaries on the worker pool and stitched back in draw order. the GPU-driven paths
+	//are a single indirect call whatever the object count
+	vk::Pipeline pipeline = m_PipelineRegistry.Get(m_PipelineKey);
+	uint32_t drawCount = m_UseMeshlets || m_UseGpuCulling ? 1 : static_cast<uint32_t>(m_UseCpuCulling ? m_VisibleBatches.size() : m_InstanceBatches.size());
+	std::vector<vk::CommandBuffer> secondaries = m_Recorder.RecordSecondaries(inheritanceInfo, drawCount,
+		[this, pipeline](vk::CommandBuffer secondary, uint32_t firstDraw, uint32_t drawCount)
+		{
+			RecordDraws(secondary, pipeline, firstDraw, drawCount);
+		});
+	//everything culled leaves nothing to execute, and executeCommands needs at least one buffer
+	if (!secondaries.empty())
+	{
+		commandBuffer.executeCommands(static_cast<uint32_t>(secondaries.size()), secondaries.data());
+	}
 
-			vk::Buffer vertexBuffers[] = { m_VertexBuffer };
-			vk::DeviceSize offsets[] = { 0 };
-			commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
-			commandBuffer.bindIndexBuffer(m_IndexBuffer, 0, vk::IndexType::eUint16);
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, 1, &m_DescriptorSets[m_CurrentFrame], 0, nullptr);
-			commandBuffer.drawIndexed(static_cast<uint32_t>(m_Indices.size()), 1, 0, 0, 0);
-			//commandBuffer.draw(m_Vertices.size(), 1, 0, 0);
-		
+	if (m_DynamicRendering)
+	{
+		commandBuffer.endRendering();
+	}
+	else
+	{
 		commandBuffer.endRenderPass();
+	}
+}
 
-	commandBuffer.end();
+void Application::RecordMeshletCull(vk::CommandBuffer commandBuffer)
+{
+	glm::mat4 modelView = m_FrameUniforms.view * m_FrameUniforms.model;
+	Frustum frustum = Frustum::FromMatrix(m_FrameUniforms.projection * modelView);
+	glm::vec3 camera = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	m_MeshletCulling.RecordCull(commandBuffer, m_CurrentFrame, frustum, camera);
+}
+
+void Application::RecordObjectCull(vk::CommandBuffer commandBuffer)
+{
+	//object spheres are in the space ubo.model is applied to
+	Frustum frustum = Frustum::FromMatrix(m_FrameUniforms.projection * m_FrameUniforms.view * m_FrameUniforms.model);
+	m_ObjectCulling.RecordCull(commandBuffer, m_CurrentFrame, frustum, m_LodSelector);
+}
+
+void Application::CullObjects()
+{
+	//the same space the GPU path culls in, objects before ubo.model
+	Frustum frustum = Frustum::FromMatrix(m_FrameUniforms.projection * m_FrameUniforms.view * m_FrameUniforms.model);
+	if (m_UseBvhCulling)
+	{
+		m_Bvh.QueryFrustum(frustum, m_VisibleObjects);
+		m_Bvh.SortObjects(m_VisibleObjects, m_VisibleBits);
+	}
+	else
+	{
+		m_Culler->Cull(m_CullingBounds, frustum, m_VisibleObjects);
+	}
+	//objects are sorted by batch, so each level's ascending share of the visible list still has every batch's
+	//survivors together
+	m_LodSelector.GatherBatches(m_Scene, m_VisibleObjects, m_InstanceOrder, m_VisibleBatches);
+	m_InstanceOffset = 0;
+	if (!m_InstanceOrder.empty())
+	{
+		RingAllocation instances = m_InstanceRing.Allocate(sizeof(InstanceData) * m_InstanceOrder.size());
+		m_Scene.WriteInstances(instances.Mapped, m_InstanceOrder);
+		m_InstanceOffset = instances.Offset;
+	}
+}
+
+void Application::RecordDraws(vk::CommandBuffer commandBuffer, vk::Pipeline pipeline, uint32_t firstDraw, uint32_t drawCount)
+{
+	//secondaries inherit nothing but the render target, every one binds its own state
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+	vk::Viewport viewport{};
+	viewport.setX(0.0f)
+			.setY(0.0f)
+			.setWidth((float)m_SwapChainExtent.width)
+			.setHeight((float)m_SwapChainExtent.height)
+			.setMinDepth(0.0f)
+			.setMaxDepth(1.0f);
+	
+	commandBuffer.setViewport(0, 1, &viewport);
+
+	vk::Rect2D scissor{};
+	scissor.setOffset(vk::Offset2D(0, 0))
+		   .setExtent(m_SwapChainExtent);
+
+	commandBuffer.setScissor(0, 1, &scissor);
+
+	vk::Buffer vertexBuffers[] = { m_VertexBuffer, m_UseCpuCulling ? m_InstanceRing.GetBuffer() : m_InstanceBuffer };
+	vk::DeviceSize offsets[] = { 0, m_UseCpuCulling ? m_InstanceOffset : 0 };
+	commandBuffer.bindVertexBuffers(0, 2, vertexBuffers, offsets);
+	commandBuffer.bindIndexBuffer(m_IndexBuffer, 0, m_IndexType);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, 1, &m_DescriptorSets[m_CurrentFrame], 1, &m_UniformOffset);
+	if (m_HasMesh)
+	{
+		commandBuffer.pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(VertexDequantization), &m_PackedVertices.Dequantization);
+	}
+	for (uint32_t draw = firstDraw; draw < firstDraw + drawCount; draw++)
+	{
+		if (m_UseMeshlets)
+		{
+			m_MeshletCulling.RecordDraws(commandBuffer, m_CurrentFrame);
+		}
+		else if (m_UseGpuCulling)
+		{
+			m_ObjectCulling.RecordDraws(commandBuffer, m_CurrentFrame);
+		}
+		else
+		{
+			//a batch's objects are consecutive, so its instances are too
+			const InstanceBatch& batch = m_UseCpuCulling ? m_VisibleBatches[draw] : m_InstanceBatches[draw];
+			const SceneMesh& mesh = m_Scene.Meshes[batch.Mesh];
+			MeshLod lod = mesh.GetLod(batch.Lod);
+			commandBuffer.drawIndexed(lod.IndexCount, batch.InstanceCount, lod.FirstIndex, mesh.VertexOffset, batch.FirstInstance);
+		}
+	}
 }
 
 void Application::CreateSyncObjects()
 {
 	vk::SemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = vk::StructureType::eSemaphoreCreateInfo;
-	vk::FenceCreateInfo fenceInfo{};
-	fenceInfo.sType = vk::StructureType::eFenceCreateInfo;
-	fenceInfo.setFlags(vk::FenceCreateFlagBits::eSignaled);
-
-	m_CommandBuffers.resize(MAX_FRAME_IN_FLIGHT);
-	m_ImageAvailableSemaphores.resize(MAX_FRAME_IN_FLIGHT);
-	m_RenderFinishedSemaphores.resize(MAX_FRAME_IN_FLIGHT);
-	m_InFlightFences.resize(MAX_FRAME_IN_FLIGHT);
+
+	//acquire and present only take binary semaphores, frame completion is tracked by the timeline
+	m_ImageAvailableSemaphores.resize(m_Config.FramesInFlight);
+	m_RenderFinishedSemaphores.resize(m_Config.FramesInFlight);
 		
-	for (size_t i = 0; i < MAX_FRAME_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_Config.FramesInFlight; i++)
 	{
 		if (m_LogicDevice.createSemaphore(&semaphoreInfo, nullptr, &m_ImageAvailableSemaphores[i]) != vk::Result::eSuccess ||
-			m_LogicDevice.createSemaphore(&semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) != vk::Result::eSuccess ||
-			m_LogicDevice.createFence(&fenceInfo, nullptr, &m_InFlightFences[i]) != vk::Result::eSuccess
+			m_LogicDevice.createSemaphore(&semaphoreInfo, nullptr, &m_RenderFinishedSemaphores[i]) != vk::Result::eSuccess
 			)
 		{
 			throw std::runtime_error("failed to create semaphores!");
 		}
 	}
+	m_FrameTimeline.Init(m_LogicDevice, m_Config.FramesInFlight);
 }
 
 void Application::DrawFrame()
 {
-	m_LogicDevice.waitForFences(1, &m_InFlightFences[m_CurrentFrame], VK_TRUE, UINT64_MAX);
-	uint32_t imageIndex;
-	m_LogicDevice.acquireNextImageKHR(m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex);
-	UploadUniformBuffer(m_CurrentFrame);
-	m_LogicDevice.resetFences(1, &m_InFlightFences[m_CurrentFrame]);
-	m_CommandBuffers[m_CurrentFrame].reset();
-	RecordCommandBuffer(m_CommandBuffers[m_CurrentFrame], imageIndex);
+	if (m_SwapChainDirty && !RecreateSwapChain())
+	{
+		return;
+	}
+	FrameTiming timing;
+	uint64_t frame = m_FrameTimeline.BeginFrame();
+	timing.FrameWait = m_FrameTimeline.GetLastWait();
+	m_Deletions.Collect(m_FrameTimeline.GetCompletedFrame());
+	m_CurrentFrame = m_FrameTimeline.GetSlot();
+	uint32_t imageIndex = m_CurrentFrame;
+	if (!m_Config.Headless)
+	{
+		auto acquireStart = std::chrono::steady_clock::now();
+		vk::Result result = m_LogicDevice.acquireNextImageKHR(m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE, &imageIndex);
+		timing.AcquireWait = std::chrono::duration<double>(std::chrono::steady_clock::now() - acquireStart).count();
+		if (result == vk::Result::eErrorOutOfDateKHR)
+		{
+			//nothing was acquired and the semaphore stays unsignaled, retry with a new swapchain next frame
+			m_FrameTimeline.CancelFrame();
+			m_SwapChainDirty = true;
+			return;
+		}
+		if (result == vk::Result::eSuboptimalKHR)
+		{
+			//the image is usable, finish this frame and rebuild before the next one
+			m_SwapChainDirty = true;
+		}
+		else if (result != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to acquire swap chain image!");
+		}
+	}
+	m_UniformRing.BeginFrame(m_CurrentFrame);
+	m_UniformOffset = UploadUniformBuffer();
+	if (m_UseCpuCulling)
+	{
+		m_InstanceRing.BeginFrame(m_CurrentFrame);
+		CullObjects();
+	}
+	m_Recorder.BeginFrame(m_CurrentFrame);
+	vk::CommandBuffer commandBuffer = m_Recorder.GetPrimary();
+	RecordCommandBuffer(commandBuffer, imageIndex);
 
 	vk::SubmitInfo submitInfo{};
 	vk::Semaphore waitSemaphores[] = { m_ImageAvailableSemaphores[m_CurrentFrame]};
-	vk::Semaphore signadSemaphores[] = { m_RenderFinishedSemaphores[m_CurrentFrame]};
+	//the binary value is ignored, headless frames only signal the timeline
+	vk::Semaphore signadSemaphores[] = { m_FrameTimeline.GetSemaphore(), m_RenderFinishedSemaphores[m_CurrentFrame] };
+	uint64_t signalValues[] = { frame, 0 };
+	uint64_t waitValues[] = { 0 };
 	vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+	uint32_t signalCount = m_Config.Headless ? 1 : 2;
+	vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = vk::StructureType::eTimelineSemaphoreSubmitInfo;
+	timelineInfo.setSignalSemaphoreValueCount(signalCount)
+				.setPSignalSemaphoreValues(signalValues);
 	submitInfo.sType = vk::StructureType::eSubmitInfo;
-	submitInfo.setCommandBufferCount(1)
-			  .setPCommandBuffers(&m_CommandBuffers[m_CurrentFrame])
-			  .setWaitSemaphoreCount(1)
-			  .setPWaitSemaphores(waitSemaphores)
-			  .setSignalSemaphoreCount(1)
-			  .setPSignalSemaphores(signadSemaphores)
-			  .setPWaitDstStageMask(waitStages);
+	submitInfo.setPNext(&timelineInfo)
+			  .setCommandBufferCount(1)
+			  .setPCommandBuffers(&commandBuffer)
+			  .setSignalSemaphoreCount(signalCount)
+			  .setPSignalSemaphores(signadSemaphores);
+	if (!m_Config.Headless)
+	{
+		timelineInfo.setWaitSemaphoreValueCount(1)
+					.setPWaitSemaphoreValues(waitValues);
+		submitInfo.setWaitSemaphoreCount(1)
+				  .setPWaitSemaphores(waitSemaphores)
+				  .setPWaitDstStageMask(waitStages);
+	}
 	
-	if (m_GraphicQueue.submit(1, &submitInfo, m_InFlightFences[m_CurrentFrame]) != vk::Result::eSuccess)
+	if (m_GraphicQueue.submit(1, &submitInfo, VK_NULL_HANDLE) != vk::Result::eSuccess)
 	{
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}	
 
+	if (m_Config.Headless)
+	{
+		RecordFrameTiming(timing);
+		return;
+	}
+
 	vk::SwapchainKHR swapChains[] = { m_SwapChain };
 	vk::PresentInfoKHR presentInfo{};
 	presentInfo.sType = vk::StructureType::ePresentInfoKHR;
@@ -778,129 +1315,189 @@ void Application::DrawFrame()
 			   .setSwapchainCount(1)
 			   .setPSwapchains(swapChains)
 			   .setWaitSemaphoreCount(1)
-			   .setPWaitSemaphores(signadSemaphores)
+			   .setPWaitSemaphores(&m_RenderFinishedSemaphores[m_CurrentFrame])
 			   .setPResults(nullptr);
 	
-	if (m_PresentQueue.presentKHR(&presentInfo) != vk::Result::eSuccess)
+	vk::Result result = m_PresentQueue.presentKHR(&presentInfo);
+	if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
+	{
+		m_SwapChainDirty = true;
+	}
+	else if (result != vk::Result::eSuccess)
 	{
 		throw std::runtime_error("failed to present Image!");
 	}
-	m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAME_IN_FLIGHT;
-}
-
-void Application::CreateVertexBuffer()
-{
-	VkDeviceSize bufferSize = sizeof(m_Vertices[0]) * m_Vertices.size();
-	vk::Buffer stagingBuffer;
-	vk::DeviceMemory stagingBufferMemory;
-	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer, stagingBufferMemory);
-	void* data;
-	m_LogicDevice.mapMemory(stagingBufferMemory, 0, bufferSize, {}, &data);
-	memcpy(data, m_Vertices.data(), (size_t)bufferSize);
-	m_LogicDevice.unmapMemory(stagingBufferMemory);
-
-	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, m_VertexBuffer, m_VertexBufferMemory);
-	
-	CopyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
-	m_LogicDevice.destroyBuffer(stagingBuffer, nullptr);
-	m_LogicDevice.freeMemory(stagingBufferMemory, nullptr);
+	RecordFrameTiming(timing);
 }
 
-void Application::CreateIndexBuffer()
+void Application::RecordFrameTiming(FrameTiming& timing)
 {
-	VkDeviceSize bufferSize = sizeof(m_Indices[0]) * m_Indices.size();
-	vk::Buffer stagingBuffer;
-	vk::DeviceMemory stagingMemory;
-	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer, stagingMemory);
-	void* data;
-	m_LogicDevice.mapMemory(stagingMemory, 0, bufferSize, {}, &data);
-	memcpy(data, m_Indices.data(), (size_t)bufferSize);
-	m_LogicDevice.unmapMemory(stagingMemory);
-
-	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, m_IndexBuffer, m_IndexBufferMemory);
-	CopyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
-	m_LogicDevice.destroyBuffer(stagingBuffer, nullptr);
-	m_LogicDevice.freeMemory(stagingMemory, nullptr);
+	auto now = std::chrono::steady_clock::now();
+	if (m_LastPresentTime != std::chrono::steady_clock::time_point())
+	{
+		timing.PresentInterval = std::chrono::duration<double>(now - m_LastPresentTime).count();
+	}
+	m_LastPresentTime = now;
+	m_FrameStats.Record(timing);
 }
 
-void Application::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory)
+void Application::LoadMesh()
 {
-	vk::BufferCreateInfo bufferInfo{};
-	bufferInfo.sType = vk::StructureType::eBufferCreateInfo;
-	bufferInfo.setUsage(usage)
-			  .setSize(size)
-			  .setSharingMode(vk::SharingMode::eExclusive);
-	if (m_LogicDevice.createBuffer(&bufferInfo, nullptr, &buffer) != vk::Result::eSuccess)
+	if (m_Config.MeshPath.empty())
 	{
-		throw std::runtime_error("failed to create vertex buffer!");
+		return;
 	}
-	vk::MemoryRequirements requirment;
-	m_LogicDevice.getBufferMemoryRequirements(buffer, &requirment);
-
-	vk::MemoryAllocateInfo allocateInfo{};
-	allocateInfo.sType = vk::StructureType::eMemoryAllocateInfo;
-	allocateInfo.setAllocationSize(requirment.size)
-			    .setMemoryTypeIndex(FindMemoryType(requirment.memoryTypeBits, properties));
-	if (m_LogicDevice.allocateMemory(&allocateInfo, nullptr, &bufferMemory) != vk::Result::eSuccess)
+	MeshLoader loader;
+	m_Mesh = loader.LoadObj(m_Config.MeshPath);
+	if (m_Mesh.Indices.empty())
+	{
+		throw std::runtime_error("mesh has no triangles!");
+	}
+	if (m_Config.MeshOptimization)
 	{
-		throw std::runtime_error("failed to allocate vertex buffer memory!");
+		OptimizeMesh(m_Mesh);
 	}
-	m_LogicDevice.bindBufferMemory(buffer, bufferMemory, 0);
+	//built from the optimized index order, and before the float positions are gone
+	m_SceneMesh.Bounds = m_Mesh.ComputeBounds(m_SceneMesh.BoxMin, m_SceneMesh.BoxMax);
+	m_UseMeshlets = m_Config.Meshlets && m_Config.ObjectCount <= 1 && m_DeviceCaps.MultiDrawIndirect;
+	if (m_UseMeshlets)
+	{
+		m_Meshlets = BuildMeshlets(m_Mesh);
+	}
+	//the levels go behind the full-detail triangles in the same index buffer and reuse its vertices
+	m_SceneMesh.IndexCount = static_cast<uint32_t>(m_Mesh.Indices.size());
+	if (m_Config.Lods && !m_UseMeshlets && m_Config.ObjectCount > 1)
+	{
+		m_SceneMesh.Lods = GenerateLods(m_Mesh);
+	}
+	m_PackedVertices = EncodeVertices(m_Mesh.Vertices, m_Config.MeshEncoding);
+	std::vector<MeshVertex>().swap(m_Mesh.Vertices);
+	m_HasMesh = true;
 }
 
-uint32_t Application::FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags flags)
+void Application::BuildScene()
 {
-	 vk::PhysicalDeviceMemoryProperties properties;
-	 m_PhyiscalDevice.getMemoryProperties(&properties);
-	for (size_t i = 0; i < properties.memoryTypeCount; i++)
+	if (!m_HasMesh)
 	{
-		if ((typeFilter &  (1 << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags)
+		m_SceneMesh.IndexCount = static_cast<uint32_t>(m_Indices.size());
+		glm::vec2 min = m_Vertices[0].pos;
+		glm::vec2 max = min;
+		for (const Vertex& vertex : m_Vertices)
 		{
-			return i;
+			min = glm::min(min, vertex.pos);
+			max = glm::max(max, vertex.pos);
 		}
+		m_SceneMesh.Bounds = glm::vec4((min + max) * 0.5f, 0.0f, glm::length(max - min) * 0.5f);
+		m_SceneMesh.BoxMin = glm::vec3(min, 0.0f);
+		m_SceneMesh.BoxMax = glm::vec3(max, 0.0f);
+	}
+	uint32_t meshId = m_Scene.AddMesh(m_SceneMesh);
+	if (m_Config.ObjectCount <= 1)
+	{
+		m_Scene.AddObject(glm::mat4(1.0f), meshId);
+	}
+	else
+	{
+		m_Scene.PopulateGrid(meshId, m_Config.ObjectCount, m_Config.MaterialCount);
 	}
-	throw std::runtime_error("failed to find suitable memory type!");
+	m_InstanceBatches = m_Scene.SortIntoBatches();
+	m_SceneBounds = m_Scene.ComputeBounds();
+
+	m_UseGpuCulling = !m_UseMeshlets && m_Config.GpuCulling &&
+		ObjectCulling::IsSupported(m_DeviceCaps.MultiDrawIndirect, m_DeviceCaps.DrawIndirectCount, m_DeviceCaps.DrawIndirectFirstInstance);
+	m_UseCpuCulling = !m_UseMeshlets && !m_UseGpuCulling && m_Config.CpuCulling;
+	m_UseBvhCulling = m_UseCpuCulling && m_Config.BvhThreshold > 0 && m_Scene.GetObjectCount() >= m_Config.BvhThreshold;
+	m_LodSelector.Init(m_Scene.GetObjectCount(), m_Config.LodErrorPixels);
+	if (m_UseCpuCulling && !m_UseBvhCulling)
+	{
+		m_CullingBounds.Build(m_Scene);
+		m_Culler = std::make_unique<FrustumCuller>();
+	}
+
+	auto bvhStart = std::chrono::steady_clock::now();
+	m_Bvh.Build(m_Scene.BoxMins, m_Scene.BoxMaxs);
+	double bvhMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhStart).count();
+	std::cout << "scene bvh: " << m_Bvh.GetNodes().size() << " nodes built in " << bvhMilliseconds << " ms, SAH cost " << m_Bvh.ComputeCost() << std::endl;
+	std::cout << "scene: " << m_Scene.GetObjectCount() << " objects in " << m_InstanceBatches.size() << " mesh/material batches, "
+			  << (m_UseMeshlets ? "meshlets culled on the GPU" : m_UseGpuCulling ? "culled on the GPU" :
+				  m_UseBvhCulling ? "culled on the CPU (bvh)" :
+				  m_UseCpuCulling ? std::string("culled on the CPU (") + FrustumCuller::GetPathName(m_Culler->GetPath()) + ")" : "not culled")
+			  << ((m_UseGpuCulling || m_UseCpuCulling) && !m_SceneMesh.Lods.empty() ? ", " + std::to_string(m_SceneMesh.GetLodCount()) + " levels of detail" : "") << std::endl;
 }
 
-void Application::CopyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size)
+void Application::CreateInstanceBuffer()
 {
-	vk::CommandBuffer commandBuffer;
-	
-	vk::CommandBufferAllocateInfo commandBufferAllocInfo{};
-	commandBufferAllocInfo.sType = vk::StructureType::eCommandBufferAllocateInfo;
-	commandBufferAllocInfo.setCommandPool(m_CommandPool)
-					      .setCommandBufferCount(1)
-					      .setLevel(vk::CommandBufferLevel::ePrimary);
-	
-	if (m_LogicDevice.allocateCommandBuffers(&commandBufferAllocInfo, &commandBuffer) != vk::Result::eSuccess)
+	VkDeviceSize bufferSize = sizeof(InstanceData) * m_Scene.GetObjectCount();
+	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, m_InstanceBuffer, m_InstanceBufferAllocation);
+	m_Uploads.UploadBuffer(m_InstanceBuffer, 0, bufferSize, vk::PipelineStageFlagBits2::eVertexInput, vk::AccessFlagBits2::eVertexAttributeRead,
+		[this](void* staging) { m_Scene.WriteInstances(staging); });
+}
+
+void Application::CreateObjectCulling()
+{
+	if (!m_UseGpuCulling)
 	{
-		throw std::runtime_error("failed to allocate command buffers!");
+		return;
 	}
+	m_ObjectCulling.Init(m_LogicDevice, &m_Allocator, &m_Uploads, m_PipelineCache.Get(), m_Scene, m_Config.FramesInFlight,
+		m_DeviceCaps.Synchronization2);
+}
 
+void Application::CreateMeshletCulling()
+{
+	if (!m_UseMeshlets)
+	{
+		return;
+	}
+	m_MeshletCulling.Init(m_LogicDevice, &m_Allocator, &m_Uploads, m_PipelineCache.Get(), m_Meshlets, m_Config.FramesInFlight,
+		m_DeviceCaps.Synchronization2, m_DeviceCaps.DrawIndirectCount);
+}
 
-	vk::CommandBufferBeginInfo commandBeginInfo{};
-	commandBeginInfo.sType = vk::StructureType::eCommandBufferBeginInfo;
-	commandBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+void Application::CreateVertexBuffer()
+{
+	const void* vertices = m_HasMesh ? static_cast<const void*>(m_PackedVertices.Data.data()) : m_Vertices.data();
+	VkDeviceSize bufferSize = m_HasMesh ? m_PackedVertices.Data.size() : sizeof(m_Vertices[0]) * m_Vertices.size();
+	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, m_VertexBuffer, m_VertexBufferAllocation);
+	m_Uploads.UploadBuffer(m_VertexBuffer, 0, vertices, bufferSize, vk::PipelineStageFlagBits2::eVertexInput, vk::AccessFlagBits2::eVertexAttributeRead);
+}
 
-	if (commandBuffer.begin(&commandBeginInfo) != vk::Result::eSuccess)
+void Application::CreateIndexBuffer()
+{
+	if (!m_HasMesh)
 	{
-		throw std::runtime_error("failed to begin command buffer!");
+		m_IndexType = vk::IndexType::eUint16;
+		m_IndexCount = static_cast<uint32_t>(m_Indices.size());
+		VkDeviceSize bufferSize = sizeof(m_Indices[0]) * m_Indices.size();
+		CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, m_IndexBuffer, m_IndexBufferAllocation);
+		m_Uploads.UploadBuffer(m_IndexBuffer, 0, m_Indices.data(), bufferSize, vk::PipelineStageFlagBits2::eVertexInput, vk::AccessFlagBits2::eIndexRead);
+		return;
 	}
-		vk::BufferCopy copyRegion{};
-		copyRegion.setDstOffset(0)
-				  .setSrcOffset(0)
-				  .setSize(size);
-		commandBuffer.copyBuffer(srcBuffer, dstBuffer, copyRegion);
-	commandBuffer.end();
 
-	vk::SubmitInfo submitInfo{};
-	submitInfo.sType = vk::StructureType::eSubmitInfo;
-	submitInfo.setCommandBufferCount(1)
-			  .setPCommandBuffers(&commandBuffer);
-	m_GraphicQueue.submit(1, &submitInfo, VK_NULL_HANDLE);
-	m_GraphicQueue.waitIdle();
+	m_IndexType = m_Mesh.IndexType == MeshIndexType::UInt16 ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+	m_IndexCount = static_cast<uint32_t>(m_Mesh.Indices.size());
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(m_Mesh.GetIndexSize()) * m_Mesh.Indices.size();
+	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, m_IndexBuffer, m_IndexBufferAllocation);
+	//narrowed to 16 bits straight into staging memory, no intermediate copy
+	m_Uploads.UploadBuffer(m_IndexBuffer, 0, bufferSize, vk::PipelineStageFlagBits2::eVertexInput, vk::AccessFlagBits2::eIndexRead,
+		[this](void* staging) { m_Mesh.WriteIndices(staging); });
+}
 
-	m_LogicDevice.freeCommandBuffers(m_CommandPool, 1, &commandBuffer);
+void Application::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer& buffer, Allocation& allocation, AllocationStrategy strategy)
+{
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = vk::StructureType::eBufferCreateInfo;
+	bufferInfo.setUsage(usage)
+			  .setSize(size)
+			  .setSharingMode(vk::SharingMode::eExclusive);
+	if (m_LogicDevice.createBuffer(&bufferInfo, nullptr, &buffer) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create vertex buffer!");
+	}
+	AllocationCreateInfo allocationInfo{};
+	allocationInfo.Properties = properties;
+	allocationInfo.Strategy = strategy;
+	allocation = m_Allocator.AllocateForBuffer(buffer, allocationInfo);
+	m_LogicDevice.bindBufferMemory(buffer, allocation.Memory, allocation.Offset);
 }
 
 void Application::createDescriptorSetLayout()
@@ -910,7 +1507,7 @@ void Application::createDescriptorSetLayout()
 	vk::DescriptorSetLayoutBinding uniformBinding{};
 	uniformBinding.setBinding(0)
 		   .setDescriptorCount(1)
-		   .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+		   .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 		   .setStageFlags(vk::ShaderStageFlagBits::eVertex)
 		   .setPImmutableSamplers(nullptr);
 	bindings.push_back(uniformBinding);
@@ -937,43 +1534,55 @@ void Application::createDescriptorSetLayout()
 
 void Application::CreateUniformBuffers()
 {
-	vk::DeviceSize bufferSize = sizeof(UniformBufferObject);
-	m_UniformBuffers.resize(MAX_FRAME_IN_FLIGHT);
-	m_UniformBufferMemory.resize(MAX_FRAME_IN_FLIGHT);
-	m_UniformBufferMapped.resize(MAX_FRAME_IN_FLIGHT);
-
-	for (size_t i = 0; i < MAX_FRAME_IN_FLIGHT; i++)
+	vk::DeviceSize alignment = m_PhyiscalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+	m_UniformRing.Init(m_LogicDevice, &m_Allocator, vk::BufferUsageFlagBits::eUniformBuffer, alignment, UNIFORM_RING_FRAME_SIZE, m_Config.FramesInFlight);
+	if (m_UseCpuCulling)
 	{
-		CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, m_UniformBuffers[i], m_UniformBufferMemory[i]);
-		if (m_LogicDevice.mapMemory(m_UniformBufferMemory[i], 0, bufferSize, {}, &m_UniformBufferMapped[i]) != vk::Result::eSuccess)
-		{
-			throw std::runtime_error("failed to map uniformBuffer Memory!");
-		}
+		//room for every object, the worst case of nothing culled
+		m_InstanceRing.Init(m_LogicDevice, &m_Allocator, vk::BufferUsageFlagBits::eVertexBuffer, sizeof(float),
+			sizeof(InstanceData) * m_Scene.GetObjectCount(), m_Config.FramesInFlight);
 	}
 }
 
-void Application::UploadUniformBuffer(uint32_t currentImage)
+uint32_t Application::UploadUniformBuffer()
 {
 	static auto startTime = std::chrono::high_resolution_clock::now();
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.projection = glm::perspective(glm::radians(45.0f), m_SwapChainExtent.width / (float)m_SwapChainExtent.height, 0.1f, 10.0f);
+	float farPlane = 10.0f;
+	if (m_Scene.GetObjectCount() > 1)
+	{
+		//the camera circles inside the grid, so most objects are off screen at any time
+		glm::vec3 center = glm::vec3(m_SceneBounds);
+		float distance = m_SceneBounds.w * 0.5f;
+		float angle = time * glm::radians(20.0f);
+		glm::vec3 eye = center + glm::vec3(std::cos(angle) * distance, std::sin(angle) * distance, m_SceneBounds.w * 0.1f);
+		ubo.model = glm::mat4(1.0f);
+		ubo.view = glm::lookAt(eye, center, glm::vec3(0.0f, 0.0f, 1.0f));
+		farPlane = distance + m_SceneBounds.w;
+	}
+	else
+	{
+		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	}
+	ubo.projection = glm::perspective(glm::radians(45.0f), m_SwapChainExtent.width / (float)m_SwapChainExtent.height, 0.1f, farPlane);
 	ubo.projection[1][1] *= -1;
-	memcpy(m_UniformBufferMapped[currentImage], &ubo, sizeof(ubo));
+	m_FrameUniforms = ubo;
+	m_LodSelector.SetCamera(ubo.view * ubo.model, ubo.projection, static_cast<float>(m_SwapChainExtent.height));
+	return m_UniformRing.Push(ubo);
 }
 
 void Application::CreateDescriptorPool()
 {
 	vk::DescriptorPoolSize poolSize{};
-	poolSize.setType(vk::DescriptorType::eUniformBuffer)
-			.setDescriptorCount(static_cast<uint32_t>(MAX_FRAME_IN_FLIGHT));
+	poolSize.setType(vk::DescriptorType::eUniformBufferDynamic)
+			.setDescriptorCount(static_cast<uint32_t>(m_Config.FramesInFlight));
 
 	vk::DescriptorPoolSize samplerPool{};
 	samplerPool.setType(vk::DescriptorType::eCombinedImageSampler)
-			  .setDescriptorCount(static_cast<uint32_t>(MAX_FRAME_IN_FLIGHT));
+			  .setDescriptorCount(static_cast<uint32_t>(m_Config.FramesInFlight));
 	std::vector<vk::DescriptorPoolSize> pool;
 	pool.push_back(poolSize);
 	pool.push_back(samplerPool);
@@ -982,7 +1591,7 @@ void Application::CreateDescriptorPool()
 	poolInfo.sType = vk::StructureType::eDescriptorPoolCreateInfo;
 	poolInfo.setPoolSizeCount(pool.size())
 			.setPPoolSizes(pool.data())
-			.setMaxSets(static_cast<uint32_t>(MAX_FRAME_IN_FLIGHT));
+			.setMaxSets(static_cast<uint32_t>(m_Config.FramesInFlight));
 	if (m_LogicDevice.createDescriptorPool(&poolInfo, nullptr, &m_DescriptorPool) != vk::Result::eSuccess)
 	{
 		throw std::runtime_error("failed to create descriptor pool!");
@@ -991,25 +1600,26 @@ void Application::CreateDescriptorPool()
 
 void Application::CreateDescriptorSets()
 {
-	std::vector<vk::DescriptorSetLayout> layouts(MAX_FRAME_IN_FLIGHT, m_DescriptorSetLayout);
+	std::vector<vk::DescriptorSetLayout> layouts(m_Config.FramesInFlight, m_DescriptorSetLayout);
 	vk::DescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = vk::StructureType::eDescriptorSetAllocateInfo;
 	allocInfo.setDescriptorPool(m_DescriptorPool)
-			 .setDescriptorSetCount(MAX_FRAME_IN_FLIGHT)
+			 .setDescriptorSetCount(m_Config.FramesInFlight)
 			 .setPSetLayouts(layouts.data());
 
-	m_DescriptorSets.resize(MAX_FRAME_IN_FLIGHT);
+	m_DescriptorSets.resize(m_Config.FramesInFlight);
 	if (m_LogicDevice.allocateDescriptorSets(&allocInfo, m_DescriptorSets.data()) != vk::Result::eSuccess)
 	{
 		throw std::runtime_error("failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < MAX_FRAME_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_Config.FramesInFlight; i++)
 	{
 		std::vector<vk::WriteDescriptorSet> writes;
 
 		vk::DescriptorBufferInfo bufferInfo{};
-		bufferInfo.setBuffer(m_UniformBuffers[i])
+		//the ring is bound once, each draw picks its range with a dynamic offset
+		bufferInfo.setBuffer(m_UniformRing.GetBuffer())
 				  .setOffset(0)
 				  .setRange(sizeof(UniformBufferObject));
 
@@ -1018,7 +1628,7 @@ void Application::CreateDescriptorSets()
 		descriptorWrite.setDstSet(m_DescriptorSets[i])
 					   .setDstBinding(0)
 					   .setDstArrayElement(0)
-					   .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+					   .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
 					   .setDescriptorCount(1)
 					   .setPBufferInfo(&bufferInfo)
 					   .setPImageInfo(nullptr)
@@ -1053,42 +1663,20 @@ void Application::CreateImageTexture()
 		throw std::runtime_error("load image failed!");
 	}
 
-	//localBuffer
+	//GpuImage
 	vk::DeviceSize bufferSize = width * height * 4;
-	vk::Buffer stagingBuffer;
-	vk::DeviceMemory stagingMemory;
-	CreateBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer, stagingMemory);
-	void* data;
-	if (m_LogicDevice.mapMemory(stagingMemory, 0, bufferSize, {}, &data) != vk::Result::eSuccess)
-	{
-		throw std::runtime_error("mapMemory failed!");
-	}
-	memcpy(data, pixels, bufferSize);
-	m_LogicDevice.unmapMemory(stagingMemory);
+	CreateImage(width, height, vk::Format::eR8G8B8A8Srgb, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, m_Image, m_ImageAllocation);
 
+	//staged and copied in the upload batch, ends up shader-readonly
+	m_Uploads.UploadImage(m_Image, width, height, pixels, bufferSize, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead);
 	stbi_image_free(pixels);
 
-	//GpuImage
-	CreateImage(width, height, vk::Format::eR8G8B8A8Srgb);
-
-	//transiation undefined -> transferSrc 
-	TransiationImageLayout(m_Image, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eNone, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer);
-
-	//copyBufferToImage
-	CopyBufferToImage(stagingBuffer, m_Image, vk::ImageLayout::eTransferDstOptimal, width, height);
-
-	//transiation transferSrc -> shder-readonly
-	TransiationImageLayout(m_Image, vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader);
-
-	m_LogicDevice.destroyBuffer(stagingBuffer);
-	m_LogicDevice.freeMemory(stagingMemory);
-
 	//imageView
 	CreateImageView(m_Image, m_View, vk::Format::eR8G8B8A8Srgb, vk::ImageViewType::e2D);
 
 }
 
-void Application::CreateImage(uint32_t width, uint32_t height, vk::Format format)
+void Application::CreateImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::Image& image, Allocation& allocation)
 {
 	vk::Extent3D extentInfo{};
 	extentInfo.setWidth(width)
@@ -1106,108 +1694,16 @@ void Application::CreateImage(uint32_t width, uint32_t height, vk::Format format
 			 .setSamples(vk::SampleCountFlagBits::e1)
 			 .setSharingMode(vk::SharingMode::eExclusive)
 			 .setTiling(vk::ImageTiling::eOptimal)
-			 .setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
-	if (m_LogicDevice.createImage(&imageInfo, nullptr, &m_Image) != vk::Result::eSuccess)
+			 .setUsage(usage);
+	if (m_LogicDevice.createImage(&imageInfo, nullptr, &image) != vk::Result::eSuccess)
 	{
 		throw std::runtime_error("createImage failed!");
 	}
 
-	vk::MemoryRequirements requirments;
-	m_LogicDevice.getImageMemoryRequirements(m_Image, &requirments);
-	vk::MemoryAllocateInfo memoryInfo{};
-	memoryInfo.sType = vk::StructureType::eMemoryAllocateInfo;
-	memoryInfo.setAllocationSize(requirments.size)
-			  .setMemoryTypeIndex(FindMemoryType(requirments.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal));
-	if (m_LogicDevice.allocateMemory(&memoryInfo, nullptr, &m_Memory) != vk::Result::eSuccess)
-	{
-		throw std::runtime_error("allocate memory failed!");
-	}
-	m_LogicDevice.bindImageMemory(m_Image, m_Memory, 0);
-}
-
-vk::CommandBuffer Application::BeginOneTimeCommand()
-{
-	vk::CommandBuffer commandBuffer;
-	vk::CommandBufferAllocateInfo bufferInfo{};
-	bufferInfo.sType = vk::StructureType::eCommandBufferAllocateInfo;
-	bufferInfo.setCommandBufferCount(1)
-			  .setLevel(vk::CommandBufferLevel::ePrimary)
-			  .setCommandPool(m_CommandPool);
-	if (m_LogicDevice.allocateCommandBuffers(&bufferInfo, &commandBuffer) != vk::Result::eSuccess)
-	{
-		throw std::runtime_error("allocate commandBufer failed!");
-	}
-
-	vk::CommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = vk::StructureType::eCommandBufferBeginInfo;
-	beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-	if (commandBuffer.begin(&beginInfo) != vk::Result::eSuccess)
-	{
-		throw std::runtime_error("begin commandBufer failed!");
-	}
-	return commandBuffer;
-}
-
-void Application::EndCommand(vk::CommandBuffer commandBuffer)
-{
-	commandBuffer.end();
-
-	vk::SubmitInfo submitInfo{};
-	submitInfo.sType = vk::StructureType::eCommandBufferSubmitInfo;
-	submitInfo.setCommandBufferCount(1)
-			  .setPCommandBuffers(&commandBuffer);
-	if (m_GraphicQueue.submit(1, &submitInfo, {}) != vk::Result::eSuccess)
-	{
-		throw std::runtime_error("submit commandBuffer failed!");
-	}
-	m_GraphicQueue.waitIdle();
-	m_LogicDevice.freeCommandBuffers(m_CommandPool, 1, &commandBuffer);
-}
-
-void Application::TransiationImageLayout(const vk::Image& image, vk::AccessFlags distFlags, vk::AccessFlags srcFlags, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage)
-{
-	vk::CommandBuffer command = BeginOneTimeCommand();
-
-	vk::ImageSubresourceRange subresourceRange;
-	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor)
-			        .setBaseArrayLayer(0)
-			        .setBaseMipLevel(0)
-			        .setLayerCount(1)
-			        .setLevelCount(1);
-
-	vk::ImageMemoryBarrier barrierInfo{};;
-	barrierInfo.sType = vk::StructureType::eImageMemoryBarrier;
-	
-	barrierInfo.setImage(image)
-			   .setDstAccessMask(distFlags)
-			   .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-			   .setNewLayout(newLayout)
-			   .setSrcAccessMask(srcFlags)
-			   .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
-			   .setOldLayout(oldLayout)
-			   .setSubresourceRange(subresourceRange);
-	command.pipelineBarrier(srcStage, dstStage, vk::DependencyFlagBits::eByRegion, 0, nullptr, 0, nullptr, 1, &barrierInfo);
-
-	EndCommand(command);
-}
-
-void Application::CopyBufferToImage(vk::Buffer buffer, vk::Image image, vk::ImageLayout dstImagelayout, uint32_t width, uint32_t height)
-{
-	vk::CommandBuffer command = BeginOneTimeCommand();
-	vk::ImageSubresourceLayers layer;
-	layer.setAspectMask(vk::ImageAspectFlagBits::eColor)
-	     .setMipLevel(0)
-	     .setBaseArrayLayer(0)
-	     .setLayerCount(1);
-	vk::BufferImageCopy copyInfo{};
-	copyInfo.setBufferImageHeight(0)
-			.setBufferOffset(0)
-			.setBufferRowLength(0)
-			.setImageExtent(vk::Extent3D(width, height, 1))
-			.setImageOffset(vk::Offset3D(0, 0, 0))
-			.setImageSubresource(layer);
-	command.copyBufferToImage(buffer, image, dstImagelayout, 1, &copyInfo);
-	EndCommand(command);
+	AllocationCreateInfo allocationInfo{};
+	allocationInfo.Properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	allocation = m_Allocator.AllocateForImage(image, imageInfo.tiling, allocationInfo);
+	m_LogicDevice.bindImageMemory(image, allocation.Memory, allocation.Offset);
 }
 
 void Application::CreateImageView(vk::Image image, vk::ImageView& view,  vk::Format format, vk::ImageViewType viewType)
@@ -1,18 +1,109 @@
 #pragma once
 
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
 
+#ifdef _WIN32
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
+#endif
+#include <memory>
 #include <optional>
 #include <vector>
+#include <string>
+#include <chrono>
 #include <glm.hpp>
+#include "DeviceCapabilities.h"
+#include "PipelineCache.h"
+#include "PipelineRegistry.h"
+#include "MemoryAllocator.h"
+#include "FrameTimeline.h"
+#include "DeletionQueue.h"
+#include "FrameLimiter.h"
+#include "FrameStats.h"
+#include "FrameRingBuffer.h"
+#include "UploadManager.h"
+#include "CommandRecorder.h"
+#include "RenderGraph.h"
+#include "VertexLayout.h"
+#include "MeshLoader.h"
+#include "MeshOptimizer.h"
+#include "VertexQuantization.h"
+#include "MeshletBuilder.h"
+#include "MeshletCulling.h"
+#include "Scene.h"
+#include "ObjectCulling.h"
+#include "FrustumCuller.h"
+#include "Bvh.h"
+#include "LodSelector.h"
+
+//how frames are paced against the display
+enum class PresentPolicy
+{
+	//mailbox, falling back to immediate: never blocks on vblank, the newest frame wins
+	LowLatency,
+	//fifo: no tearing, the CPU is throttled by the display
+	VSync,
+	//mailbox/immediate throttled by the CPU frame limiter, FrameRateCap or the monitor's refresh rate
+	Capped,
+	//immediate: may tear
+	Immediate
+};
+
+struct ApplicationConfig
+{
+	//render into device-owned images instead of a window swapchain
+	bool Headless = false;
+	uint32_t Width = 1024;
+	uint32_t Height = 768;
+	//0 = run until the window is closed (headless falls back to 1000 frames)
+	uint32_t FrameCount = 0;
+	//how far the CPU may run ahead of the GPU, more hides stalls at the cost of latency
+	uint32_t FramesInFlight = 2;
+	PresentPolicy Present = PresentPolicy::LowLatency;
+	//frames per second for the CPU limiter, 0 = uncapped (Capped uses the monitor's refresh rate then)
+	uint32_t FrameRateCap = 0;
+	//render without VkRenderPass/VkFramebuffer objects when the device supports it
+	bool DynamicRendering = true;
+	//OBJ file drawn instead of the built-in quad, empty keeps the quad
+	std::string MeshPath;
+	//reorder the loaded mesh for the vertex cache, overdraw and vertex fetch before uploading it
+	bool MeshOptimization = true;
+	//how the mesh's vertices are packed at load time, unpacked by the vertex shader
+	VertexEncoding MeshEncoding;
+	//split the mesh into meshlets culled on the GPU every frame, needs multiDrawIndirect. single-object scenes only
+	bool Meshlets = true;
+	//copies of the mesh (or quad) laid out on a grid, more than one switches to a camera orbiting the scene
+	uint32_t ObjectCount = 1;
+	//materials handed out across the objects, objects sharing mesh and material are drawn as one instanced draw
+	uint32_t MaterialCount = 1;
+	//cull objects in a compute pass and draw them with drawIndexedIndirectCount, otherwise one CPU draw per object
+	bool GpuCulling = true;
+	//when not culling on the GPU, frustum cull on the CPU every frame and only upload the visible instances
+	bool CpuCulling = true;
+	//from this many objects on the CPU path walks the scene BVH instead of testing every object, 0 = never
+	uint32_t BvhThreshold = 32768;
+	//simplify the loaded mesh into a chain of levels of detail for scenes of more than one object
+	bool Lods = true;
+	//how many pixels of simplification error a level may show on screen before a finer one is drawn
+	float LodErrorPixels = 1.0f;
+	//cull this many synthetic objects with every CPU path, print objects/ms and exit without rendering
+	uint32_t CullBenchmark = 0;
+	//pick a device by (partial) name or by its deviceUUID instead of by score
+	std::string DeviceOverride;
+	//empty disables the on-disk pipeline cache
+	std::string PipelineCachePath = "pipeline_cache.bin";
+	//pipeline permutations seen by the last run, precompiled on startup; empty disables it
+	std::string PipelineWarmupPath = "pipeline_warmup.txt";
+};
 
 class Application
 {
 public:
+	explicit Application(const ApplicationConfig& config = ApplicationConfig()) : m_Config(config) {}
 	void Run() 
 	{ 
 		InitWindow();
@@ -29,6 +120,8 @@ private:
 	{
 		std::optional<uint32_t> GraphicFamily;
 		std::optional<uint32_t> PresentFamily;
+		//transfer-only family (DMA engine), empty when the device has none
+		std::optional<uint32_t> TransferFamily;
 		bool IsComplete() { return GraphicFamily.has_value() && PresentFamily.has_value(); }
 	};
 
@@ -48,35 +141,59 @@ private:
 		glm::vec2 pos;
 		glm::vec3 color;
 		glm::vec2 coord;
-		static vk::VertexInputBindingDescription GetBindingDescription()
+	};
+
+	//shared by the quad and the mesh pipelines, fetched at gl_InstanceIndex = object index
+	using InstanceStream = VertexStream<InstanceData, 1, vk::VertexInputRate::eInstance,
+		VERTEX_ATTRIBUTE(InstanceData, Row0, 3),
+		VERTEX_ATTRIBUTE(InstanceData, Row1, 4),
+		VERTEX_ATTRIBUTE(InstanceData, Row2, 5),
+		VERTEX_ATTRIBUTE(InstanceData, Material, 6)>;
+
+	using VertexLayoutType = VertexLayout<
+		VertexStream<Vertex, 0, vk::VertexInputRate::eVertex,
+			VERTEX_ATTRIBUTE(Vertex, pos, 0),
+			VERTEX_ATTRIBUTE(Vertex, color, 1),
+			VERTEX_ATTRIBUTE(Vertex, coord, 2)>,
+		InstanceStream>;
+	//shader.vert: aPosition, aColor, aCoord, aModelRow0..2, aMaterial
+	static_assert(VertexLayoutType::MatchesLocations<0, 1, 2, 3, 4, 5, 6>(), "Vertex does not feed shader.vert's inputs");
+
+	static vk::Format ToVertexFormat(VertexAttributeFormat format)
+	{
+		switch (format)
 		{
-			vk::VertexInputBindingDescription desc;
-			return desc.setBinding(0)
-					   .setStride(sizeof(Vertex))
-					   .setInputRate(vk::VertexInputRate::eVertex);
+		case VertexAttributeFormat::Float2: return vk::Format::eR32G32Sfloat;
+		case VertexAttributeFormat::Float3: return vk::Format::eR32G32B32Sfloat;
+		case VertexAttributeFormat::Half2: return vk::Format::eR16G16Sfloat;
+		case VertexAttributeFormat::Half4: return vk::Format::eR16G16B16A16Sfloat;
+		case VertexAttributeFormat::Snorm16x2: return vk::Format::eR16G16Snorm;
+		case VertexAttributeFormat::Snorm16x4: return vk::Format::eR16G16B16A16Snorm;
+		case VertexAttributeFormat::Unorm16x2: return vk::Format::eR16G16Unorm;
 		}
+		throw std::runtime_error("unknown vertex attribute format!");
+	}
+
+	static vk::VertexInputBindingDescription GetMeshBindingDescription(const PackedVertices& vertices)
+	{
+		vk::VertexInputBindingDescription desc;
+		return desc.setBinding(0)
+				   .setStride(vertices.Stride)
+				   .setInputRate(vk::VertexInputRate::eVertex);
+	}
 
-		static std::vector<vk::VertexInputAttributeDescription> GetAttribuDescription()
+	static std::vector<vk::VertexInputAttributeDescription> GetMeshAttributeDescription(const PackedVertices& vertices)
+	{
+		std::vector<vk::VertexInputAttributeDescription> attributes(vertices.Attributes.size());
+		for (size_t i = 0; i < vertices.Attributes.size(); i++)
 		{
-			std::vector<vk::VertexInputAttributeDescription> attributes(3);
-			attributes[0].setBinding(0)
-						 .setFormat(vk::Format::eR32G32Sfloat)
-						 .setLocation(0)
-						 .setOffset(offsetof(Vertex, pos));
-
-			attributes[1].setBinding(0)
-					     .setFormat(vk::Format::eR32G32B32Sfloat)
-					     .setLocation(1)
-					     .setOffset(offsetof(Vertex, color));
-			
-			attributes[2].setBinding(0)
-						 .setFormat(vk::Format::eR32G32Sfloat)
-						 .setLocation(2)
-						 .setOffset(offsetof(Vertex, coord));
-
-			return attributes;
+			attributes[i].setBinding(0)
+						 .setFormat(ToVertexFormat(vertices.Attributes[i].Format))
+						 .setLocation(vertices.Attributes[i].Location)
+						 .setOffset(vertices.Attributes[i].Offset);
 		}
-	};
+		return attributes;
+	}
 
 	struct UniformBufferObject
 	{
@@ -92,74 +209,109 @@ private:
 	void CreateSurface();
 	void PickPhysicalDevice();
 	bool IsDeviceSuitable(const vk::PhysicalDevice& device);
+	DeviceCapabilities QueryDeviceCapabilities(const vk::PhysicalDevice& device);
+	int64_t RateDevice(const DeviceCapabilities& capabilities);
+	bool MatchesDeviceOverride(const vk::PhysicalDevice& device);
 	QueueFamilyIndices FindQueueFamilies(const vk::PhysicalDevice& device);
 	void CreateLogicDevice();
 	bool IsDeviceExtensionSupport(const vk::PhysicalDevice& device);
 	SwapChainSupportDetail QuerySwapChainSupport(const vk::PhysicalDevice& device);
-	void CreateSwapChain();
+	void CreateSwapChain(vk::SwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+	//returns false while the window is minimized, the frame is skipped then
+	bool RecreateSwapChain();
+	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height);
+	//left click picks the object under the cursor
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	void PickObject(double x, double y);
+	void CreateOffscreenTargets();
 	vk::SurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& formats);
 	vk::PresentModeKHR ChooseSwapSurfacePresentMode(const std::vector<vk::PresentModeKHR>& presentModes);
 	vk::Extent2D ChooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities);
 	void CreateImageViews();
 	void CreateGraphicsPipeline();
-	vk::ShaderModule CreateShaderModule(const std::vector<char>& sourceCode);
 	void CreateRenderPass();
 	void CreateFrameBuffer();
 	void CreateCommandPool();
-	void CreateCommandBuffer();
+	void CreateRenderGraph();
 	void RecordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+	void RecordMainPass(vk::CommandBuffer commandBuffer);
+	void RecordMeshletCull(vk::CommandBuffer commandBuffer);
+	void RecordObjectCull(vk::CommandBuffer commandBuffer);
+	void CullObjects();
+	void RecordDraws(vk::CommandBuffer commandBuffer, vk::Pipeline pipeline, uint32_t firstDraw, uint32_t drawCount);
 	void CreateSyncObjects();
 	void DrawFrame();
+	void RecordFrameTiming(FrameTiming& timing);
+	void LoadMesh();
+	void BuildScene();
+	void CreateMeshletCulling();
+	void CreateObjectCulling();
+	void CreateInstanceBuffer();
 	void CreateVertexBuffer();
 	void CreateIndexBuffer();
 	void CreateUniformBuffers();
-	void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer& buffer, vk::DeviceMemory& bufferMemory);
-	uint32_t FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags flags);
-	void CopyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
+	void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer& buffer, Allocation& allocation, AllocationStrategy strategy = AllocationStrategy::General);
 	void createDescriptorSetLayout();
-	void UploadUniformBuffer(uint32_t currentImage);
+	uint32_t UploadUniformBuffer();
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
-	void CreateImage(uint32_t width, uint32_t height, vk::Format format);
+	void CreateImage(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::Image& image, Allocation& allocation);
 	void CreateImageTexture();
-	vk::CommandBuffer BeginOneTimeCommand();
-	void EndCommand(vk::CommandBuffer commandBuffer);
-	void TransiationImageLayout(const vk::Image& image, vk::AccessFlags distFlags, vk::AccessFlags srcFlags, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage);
-	void CopyBufferToImage(vk::Buffer buffer, vk::Image image, vk::ImageLayout dstImagelayout, uint32_t width, uint32_t height);
 	void CreateImageView(vk::Image image, vk::ImageView& view, vk::Format format, vk::ImageViewType viewType);
 	void CreateSampler();
 
 private:
-	GLFWwindow* m_Window;
+	ApplicationConfig m_Config;
+	GLFWwindow* m_Window = nullptr;
 	vk::Instance m_Vkinstance;
 	vk::PhysicalDevice m_PhyiscalDevice = VK_NULL_HANDLE;
+	DeviceCapabilities m_DeviceCaps;
+	MemoryAllocator m_Allocator;
+	UploadManager m_Uploads;
 	vk::Device m_LogicDevice = VK_NULL_HANDLE;
 	vk::SurfaceKHR m_Surface;
 	vk::Queue m_PresentQueue;
 	vk::Queue m_GraphicQueue;
+	vk::Queue m_TransferQueue;
 	vk::SwapchainKHR m_SwapChain;
 	std::vector<vk::Image> m_SwapChainImages;
 	vk::Format m_SwapChainFormat;
 	vk::Extent2D m_SwapChainExtent;
 	std::vector<vk::ImageView> m_ImageViews;
+	std::vector<Allocation> m_OffscreenAllocations;
 	std::vector<const char*> m_DeviceExtesions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 	vk::RenderPass m_Renderpass;
 	vk::DescriptorSetLayout m_DescriptorSetLayout;
 	vk::PipelineLayout m_PipelineLayout;
-	vk::Pipeline m_Pipeline;
+	PipelineCache m_PipelineCache;
+	PipelineRegistry m_PipelineRegistry;
+	GraphicsPipelineDesc m_PipelineDesc;
+	uint64_t m_PipelineKey = 0;
 	std::vector<vk::Framebuffer> m_FrameBuffers;
-	vk::CommandPool m_CommandPool;
-	std::vector<vk::CommandBuffer> m_CommandBuffers;
+	CommandRecorder m_Recorder;
+	RenderGraph m_RenderGraph;
+	ImageHandle m_BackbufferHandle = 0;
+	//swapchain image the frame being recorded renders into
+	uint32_t m_ImageIndex = 0;
 	std::vector<vk::Semaphore> m_ImageAvailableSemaphores;
 	std::vector<vk::Semaphore> m_RenderFinishedSemaphores;
-	std::vector<vk::Fence> m_InFlightFences;
+	//m_Config.DynamicRendering and supported, no render pass or framebuffers exist then
+	bool m_DynamicRendering = false;
+	FrameTimeline m_FrameTimeline;
+	DeletionQueue m_Deletions;
+	//set by resizes and out-of-date/suboptimal results, the swapchain is rebuilt before the next acquire
+	bool m_SwapChainDirty = false;
+	uint32_t m_SwapChainRecreations = 0;
+	FrameLimiter m_FrameLimiter;
+	FrameStats m_FrameStats;
+	std::chrono::steady_clock::time_point m_LastPresentTime;
 	vk::Buffer m_VertexBuffer;
-	vk::DeviceMemory m_VertexBufferMemory;
+	Allocation m_VertexBufferAllocation;
 	vk::Buffer m_IndexBuffer;
-	vk::DeviceMemory m_IndexBufferMemory;
-	std::vector<vk::Buffer> m_UniformBuffers;
-	std::vector<vk::DeviceMemory> m_UniformBufferMemory;
-	std::vector<void*> m_UniformBufferMapped;
+	Allocation m_IndexBufferAllocation;
+	FrameRingBuffer m_UniformRing;
+	//dynamic offset of this frame's object uniforms inside m_UniformRing
+	uint32_t m_UniformOffset = 0;
 
 	std::vector<Vertex> m_Vertices = {
 		{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, { 0.0f, 1.0f }},
@@ -168,12 +320,53 @@ private:
 		{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}, { 0.0f, 0.0f }}
 	};
 	std::vector<uint16_t> m_Indices = { 0, 1, 2, 2, 3, 0 };
+	//loaded from m_Config.MeshPath, released again once it is uploaded
+	MeshData m_Mesh;
+	//m_Mesh's vertices after encoding, the layout and dequantization stay once the data is uploaded
+	PackedVertices m_PackedVertices;
+	bool m_HasMesh = false;
+	//freed with m_Mesh once uploaded
+	MeshletData m_Meshlets;
+	bool m_UseMeshlets = false;
+	MeshletCulling m_MeshletCulling;
+	//range and bounds of the mesh (or quad) in the shared buffers
+	SceneMesh m_SceneMesh;
+	Scene m_Scene;
+	glm::vec4 m_SceneBounds = glm::vec4(0.0f);
+	//objects grouped by mesh and material, one instanced draw each on the CPU path
+	std::vector<InstanceBatch> m_InstanceBatches;
+	//per-instance vertex stream, one InstanceData per object in object order
+	vk::Buffer m_InstanceBuffer;
+	Allocation m_InstanceBufferAllocation;
+	bool m_UseGpuCulling = false;
+	ObjectCulling m_ObjectCulling;
+	bool m_UseCpuCulling = false;
+	//only on the linear CPU path, its worker pool would idle everywhere else
+	std::unique_ptr<FrustumCuller> m_Culler;
+	CullingBounds m_CullingBounds;
+	//boxes of every object, for picking and for culling large scenes
+	Bvh m_Bvh;
+	bool m_UseBvhCulling = false;
+	std::vector<uint64_t> m_VisibleBits;
+	LodSelector m_LodSelector;
+	//visible objects regrouped by level, in the order their instances are written
+	std::vector<uint32_t> m_InstanceOrder;
+	//this frame's visible objects and their batches, FirstInstance counts into the frame's instance ring range
+	std::vector<uint32_t> m_VisibleObjects;
+	std::vector<InstanceBatch> m_VisibleBatches;
+	//visible instances of each frame, bound instead of m_InstanceBuffer when culling on the CPU
+	FrameRingBuffer m_InstanceRing;
+	uint32_t m_InstanceOffset = 0;
+	//this frame's matrices, the culling passes derive the frustum from them
+	UniformBufferObject m_FrameUniforms;
+	vk::IndexType m_IndexType = vk::IndexType::eUint16;
+	uint32_t m_IndexCount = 0;
 	uint32_t m_CurrentFrame = 0;
 	vk::DescriptorPool m_DescriptorPool;
 	std::vector<vk::DescriptorSet> m_DescriptorSets;
 
 	vk::Image m_Image;
-	vk::DeviceMemory  m_Memory;
+	Allocation m_ImageAllocation;
 	vk::ImageView m_View;
 	vk::Sampler m_Sampler;
 };
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "BarrierBatch.h"
+
+namespace
+{
+	//the old bits keep their values in synchronization2, the split-up newer ones fold back into the stage they came from
+	vk::PipelineStageFlags ToLegacyStages(vk::PipelineStageFlags2 stages)
+	{
+		const VkPipelineStageFlags2 transfer = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT;
+		const VkPipelineStageFlags2 vertexInput = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+		const VkPipelineStageFlags2 preRasterization = VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT;
+
+		VkPipelineStageFlags2 mask = static_cast<VkPipelineStageFlags2>(stages);
+		VkPipelineStageFlags legacy = static_cast<VkPipelineStageFlags>(mask & 0xffffffffull);
+		if (mask & transfer)
+		{
+			legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+		}
+		if (mask & vertexInput)
+		{
+			legacy |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		}
+		if (mask & preRasterization)
+		{
+			legacy |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT |
+				VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT;
+		}
+		//anything else has no narrower legacy equivalent
+		if ((mask & ~(transfer | vertexInput | preRasterization)) >> 32)
+		{
+			legacy |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		}
+		return vk::PipelineStageFlags(legacy);
+	}
+
+	vk::AccessFlags ToLegacyAccess(vk::AccessFlags2 access)
+	{
+		VkAccessFlags2 mask = static_cast<VkAccessFlags2>(access);
+		VkAccessFlags legacy = static_cast<VkAccessFlags>(mask & 0xffffffffull);
+		if (mask & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+		{
+			legacy |= VK_ACCESS_SHADER_READ_BIT;
+		}
+		if (mask & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+		{
+			legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+		}
+		return vk::AccessFlags(legacy);
+	}
+}
+
+BarrierBatch& BarrierBatch::Image(vk::Image image, const vk::ImageSubresourceRange& range, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+	vk::PipelineStageFlags2 srcStages, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess,
+	uint32_t srcFamily, uint32_t dstFamily)
+{
+	vk::ImageMemoryBarrier2 barrier{};
+	barrier.sType = vk::StructureType::eImageMemoryBarrier2;
+	barrier.setImage(image)
+		   .setSubresourceRange(range)
+		   .setOldLayout(oldLayout)
+		   .setNewLayout(newLayout)
+		   .setSrcStageMask(srcStages)
+		   .setSrcAccessMask(srcAccess)
+		   .setDstStageMask(dstStages)
+		   .setDstAccessMask(dstAccess)
+		   .setSrcQueueFamilyIndex(srcFamily)
+		   .setDstQueueFamilyIndex(dstFamily);
+	return Add(barrier);
+}
+
+BarrierBatch& BarrierBatch::Buffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size,
+	vk::PipelineStageFlags2 srcStages, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess,
+	uint32_t srcFamily, uint32_t dstFamily)
+{
+	vk::BufferMemoryBarrier2 barrier{};
+	barrier.sType = vk::StructureType::eBufferMemoryBarrier2;
+	barrier.setBuffer(buffer)
+		   .setOffset(offset)
+		   .setSize(size)
+		   .setSrcStageMask(srcStages)
+		   .setSrcAccessMask(srcAccess)
+		   .setDstStageMask(dstStages)
+		   .setDstAccessMask(dstAccess)
+		   .setSrcQueueFamilyIndex(srcFamily)
+		   .setDstQueueFamilyIndex(dstFamily);
+	return Add(barrier);
+}
+
+void BarrierBatch::Record(vk::CommandBuffer commandBuffer, bool synchronization2) const
+{
+	if (Empty())
+	{
+		return;
+	}
+
+	if (synchronization2)
+	{
+		vk::DependencyInfo dependencyInfo{};
+		dependencyInfo.sType = vk::StructureType::eDependencyInfo;
+		dependencyInfo.setMemoryBarrierCount(static_cast<uint32_t>(m_Memory.size()))
+					  .setPMemoryBarriers(m_Memory.data())
+					  .setBufferMemoryBarrierCount(static_cast<uint32_t>(m_Buffers.size()))
+					  .setPBufferMemoryBarriers(m_Buffers.data())
+					  .setImageMemoryBarrierCount(static_cast<uint32_t>(m_Images.size()))
+					  .setPImageMemoryBarriers(m_Images.data());
+		commandBuffer.pipelineBarrier2(dependencyInfo);
+		return;
+	}
+
+	//one legacy barrier call takes a single pair of stage masks for everything in it
+	vk::PipelineStageFlags srcStages;
+	vk::PipelineStageFlags dstStages;
+	std::vector<vk::MemoryBarrier> memory;
+	std::vector<vk::BufferMemoryBarrier> buffers;
+	std::vector<vk::ImageMemoryBarrier> images;
+	for (auto& barrier : m_Memory)
+	{
+		srcStages |= ToLegacyStages(barrier.srcStageMask);
+		dstStages |= ToLegacyStages(barrier.dstStageMask);
+		vk::MemoryBarrier legacy{};
+		legacy.sType = vk::StructureType::eMemoryBarrier;
+		legacy.setSrcAccessMask(ToLegacyAccess(barrier.srcAccessMask))
+			  .setDstAccessMask(ToLegacyAccess(barrier.dstAccessMask));
+		memory.push_back(legacy);
+	}
+	for (auto& barrier : m_Buffers)
+	{
+		srcStages |= ToLegacyStages(barrier.srcStageMask);
+		dstStages |= ToLegacyStages(barrier.dstStageMask);
+		vk::BufferMemoryBarrier legacy{};
+		legacy.sType = vk::StructureType::eBufferMemoryBarrier;
+		legacy.setBuffer(barrier.buffer)
+			  .setOffset(barrier.offset)
+			  .setSize(barrier.size)
+			  .setSrcAccessMask(ToLegacyAccess(barrier.srcAccessMask))
+			  .setDstAccessMask(ToLegacyAccess(barrier.dstAccessMask))
+			  .setSrcQueueFamilyIndex(barrier.srcQueueFamilyIndex)
+			  .setDstQueueFamilyIndex(barrier.dstQueueFamilyIndex);
+		buffers.push_back(legacy);
+	}
+	for (auto& barrier : m_Images)
+	{
+		srcStages |= ToLegacyStages(barrier.srcStageMask);
+		dstStages |= ToLegacyStages(barrier.dstStageMask);
+		vk::ImageMemoryBarrier legacy{};
+		legacy.sType = vk::StructureType::eImageMemoryBarrier;
+		legacy.setImage(barrier.image)
+			  .setSubresourceRange(barrier.subresourceRange)
+			  .setOldLayout(barrier.oldLayout)
+			  .setNewLayout(barrier.newLayout)
+			  .setSrcAccessMask(ToLegacyAccess(barrier.srcAccessMask))
+			  .setDstAccessMask(ToLegacyAccess(barrier.dstAccessMask))
+			  .setSrcQueueFamilyIndex(barrier.srcQueueFamilyIndex)
+			  .setDstQueueFamilyIndex(barrier.dstQueueFamilyIndex);
+		images.push_back(legacy);
+	}
+	//NONE has no legacy spelling, top/bottom of pipe are the no-op equivalents
+	if (!srcStages)
+	{
+		srcStages = vk::PipelineStageFlagBits::eTopOfPipe;
+	}
+	if (!dstStages)
+	{
+		dstStages = vk::PipelineStageFlagBits::eBottomOfPipe;
+	}
+	commandBuffer.pipelineBarrier(srcStages, dstStages, {},
+		static_cast<uint32_t>(memory.size()), memory.data(),
+		static_cast<uint32_t>(buffers.size()), buffers.data(),
+		static_cast<uint32_t>(images.size()), images.data());
+}
+
+void BarrierBatch::Clear()
+{
+	m_Memory.clear();
+	m_Buffers.clear();
+	m_Images.clear();
+}
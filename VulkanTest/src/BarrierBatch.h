@@ -0,0 +1,33 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <vector>
+
+//barriers collected in synchronization2 form and recorded with a single call. without synchronization2 they are
+//folded into one vkCmdPipelineBarrier, which only understands the stage and access bits that existed before it
+class BarrierBatch
+{
+public:
+	BarrierBatch& Add(const vk::MemoryBarrier2& barrier) { m_Memory.push_back(barrier); return *this; }
+	BarrierBatch& Add(const vk::BufferMemoryBarrier2& barrier) { m_Buffers.push_back(barrier); return *this; }
+	BarrierBatch& Add(const vk::ImageMemoryBarrier2& barrier) { m_Images.push_back(barrier); return *this; }
+
+	BarrierBatch& Image(vk::Image image, const vk::ImageSubresourceRange& range, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		vk::PipelineStageFlags2 srcStages, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess,
+		uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED);
+	BarrierBatch& Buffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size,
+		vk::PipelineStageFlags2 srcStages, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess,
+		uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED);
+
+	//barriers are kept, so a batch built once can be recorded every frame
+	void Record(vk::CommandBuffer commandBuffer, bool synchronization2) const;
+	void Clear();
+	bool Empty() const { return m_Memory.empty() && m_Buffers.empty() && m_Images.empty(); }
+
+	std::vector<vk::BufferMemoryBarrier2>& Buffers() { return m_Buffers; }
+	std::vector<vk::ImageMemoryBarrier2>& Images() { return m_Images; }
+
+private:
+	std::vector<vk::MemoryBarrier2> m_Memory;
+	std::vector<vk::BufferMemoryBarrier2> m_Buffers;
+	std::vector<vk::ImageMemoryBarrier2> m_Images;
+};
@@ -0,0 +1,661 @@
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <bit>
+
+#include "Bvh.h"
+
+namespace
+{
+	const uint32_t BIN_COUNT = 16;
+	//refits and rotations keep a moving tree usable, past this SAH cost relative to the last build it is rebuilt
+	const float REBUILD_COST_RATIO = 1.4f;
+	const uint32_t MAX_COLLECT_DEPTH = 64;
+
+	//half the surface area, only ever compared
+	float Area(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 d = max - min;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	float Area(const BvhNode& node)
+	{
+		return Area(node.Min, node.Max);
+	}
+
+	float UnionArea(const BvhNode& node, const glm::vec3& min, const glm::vec3& max)
+	{
+		return Area(glm::min(node.Min, min), glm::max(node.Max, max));
+	}
+}
+
+void Bvh::Build(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs)
+{
+	m_Leaves.assign(mins.size(), NULL_NODE);
+	std::vector<uint32_t> objects(mins.size());
+	std::iota(objects.begin(), objects.end(), 0);
+	BuildFrom(objects, mins, maxs);
+}
+
+void Bvh::Rebuild()
+{
+	std::vector<glm::vec3> mins(m_Leaves.size());
+	std::vector<glm::vec3> maxs(m_Leaves.size());
+	std::vector<uint32_t> objects;
+	objects.reserve(m_ObjectCount);
+	for (uint32_t object = 0; object < m_Leaves.size(); object++)
+	{
+		if (m_Leaves[object] != NULL_NODE)
+		{
+			mins[object] = m_Nodes[m_Leaves[object]].Min;
+			maxs[object] = m_Nodes[m_Leaves[object]].Max;
+			objects.push_back(object);
+			m_Leaves[object] = NULL_NODE;
+		}
+	}
+	BuildFrom(objects, mins, maxs);
+}
+
+void Bvh::BuildFrom(std::vector<uint32_t>& objects, const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs)
+{
+	m_Nodes.assign(2, BvhNode{});
+	m_Nodes[0].Parent = NULL_NODE;
+	m_FreePairs.clear();
+	m_Moved.clear();
+	m_ObjectCount = static_cast<uint32_t>(objects.size());
+	m_BuildCost = 0.0f;
+	if (objects.empty())
+	{
+		return;
+	}
+
+	m_Nodes.reserve(2 * objects.size());
+	std::vector<BuildItem> items(objects.size());
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		items[i] = { mins[objects[i]], objects[i], maxs[objects[i]] };
+	}
+	BuildNode(0, items.data(), static_cast<uint32_t>(items.size()));
+	m_BuildCost = ComputeCost();
+}
+
+void Bvh::BuildNode(uint32_t node, BuildItem* items, uint32_t count)
+{
+	if (count == 1)
+	{
+		SetLeaf(node, items[0].Object, items[0].Min, items[0].Max);
+		return;
+	}
+
+	//centroids are kept doubled, only their relative positions matter
+	glm::vec3 boxMin = items[0].Min;
+	glm::vec3 boxMax = items[0].Max;
+	glm::vec3 centroidMin = items[0].Min + items[0].Max;
+	glm::vec3 centroidMax = centroidMin;
+	for (uint32_t i = 1; i < count; i++)
+	{
+		boxMin = glm::min(boxMin, items[i].Min);
+		boxMax = glm::max(boxMax, items[i].Max);
+		centroidMin = glm::min(centroidMin, items[i].Min + items[i].Max);
+		centroidMax = glm::max(centroidMax, items[i].Min + items[i].Max);
+	}
+	m_Nodes[node].Min = boxMin;
+	m_Nodes[node].Max = boxMax;
+
+	//binned SAH: objects go into bins by centroid along each axis, every boundary between bins is a candidate split.
+	//one pass fills the bins of all three axes
+	struct Bin
+	{
+		glm::vec3 Min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 Max = glm::vec3(-std::numeric_limits<float>::max());
+		uint32_t Count = 0;
+	};
+	glm::vec3 extent = centroidMax - centroidMin;
+	glm::vec3 scale = glm::vec3(0.0f);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		scale[axis] = extent[axis] > 0.0f ? static_cast<float>(BIN_COUNT) / extent[axis] : 0.0f;
+	}
+	auto binOf = [&](const BuildItem& item, int axis)
+	{
+		float offset = (item.Min[axis] + item.Max[axis] - centroidMin[axis]) * scale[axis];
+		return (std::min)(BIN_COUNT - 1, static_cast<uint32_t>(offset));
+	};
+
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	float bestCost = std::numeric_limits<float>::max();
+	//two objects split one way or the other, no need to bin them
+	if (count > 2)
+	{
+		Bin bins[3][BIN_COUNT];
+		for (uint32_t i = 0; i < count; i++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				Bin& bin = bins[axis][binOf(items[i], axis)];
+				bin.Min = glm::min(bin.Min, items[i].Min);
+				bin.Max = glm::max(bin.Max, items[i].Max);
+				bin.Count++;
+			}
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (extent[axis] <= 0.0f)
+			{
+				continue;
+			}
+			//right-hand side of every split from one sweep, the left-hand side while evaluating
+			float rightArea[BIN_COUNT];
+			uint32_t rightCount[BIN_COUNT];
+			Bin right;
+			for (uint32_t b = BIN_COUNT - 1; b > 0; b--)
+			{
+				right.Min = glm::min(right.Min, bins[axis][b].Min);
+				right.Max = glm::max(right.Max, bins[axis][b].Max);
+				right.Count += bins[axis][b].Count;
+				rightArea[b] = right.Count ? Area(right.Min, right.Max) : 0.0f;
+				rightCount[b] = right.Count;
+			}
+			Bin left;
+			for (uint32_t b = 0; b + 1 < BIN_COUNT; b++)
+			{
+				left.Min = glm::min(left.Min, bins[axis][b].Min);
+				left.Max = glm::max(left.Max, bins[axis][b].Max);
+				left.Count += bins[axis][b].Count;
+				if (left.Count == 0 || rightCount[b + 1] == 0)
+				{
+					continue;
+				}
+				float cost = left.Count * Area(left.Min, left.Max) + rightCount[b + 1] * rightArea[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+	}
+
+	uint32_t middle = count / 2;
+	if (bestAxis >= 0)
+	{
+		BuildItem* split = std::partition(items, items + count, [&](const BuildItem& item) { return binOf(item, bestAxis) <= bestSplit; });
+		middle = static_cast<uint32_t>(split - items);
+	}
+	//every centroid in one spot, any halving is as good as another
+	if (middle == 0 || middle == count)
+	{
+		middle = count / 2;
+	}
+
+	uint32_t pair = AllocatePair();
+	m_Nodes[node].Child = pair;
+	m_Nodes[pair].Parent = node;
+	m_Nodes[pair + 1].Parent = node;
+	BuildNode(pair, items, middle);
+	BuildNode(pair + 1, items + middle, count - middle);
+}
+
+uint32_t Bvh::AllocatePair()
+{
+	if (!m_FreePairs.empty())
+	{
+		uint32_t pair = m_FreePairs.back();
+		m_FreePairs.pop_back();
+		return pair;
+	}
+	uint32_t pair = static_cast<uint32_t>(m_Nodes.size());
+	m_Nodes.resize(m_Nodes.size() + 2);
+	return pair;
+}
+
+void Bvh::SetLeaf(uint32_t node, uint32_t object, const glm::vec3& min, const glm::vec3& max)
+{
+	m_Nodes[node].Min = min;
+	m_Nodes[node].Max = max;
+	m_Nodes[node].Child = BvhNode::LEAF_BIT | object;
+	m_Leaves[object] = node;
+}
+
+void Bvh::FixLinks(uint32_t node)
+{
+	if (m_Nodes[node].IsLeaf())
+	{
+		m_Leaves[m_Nodes[node].GetObject()] = node;
+	}
+	else
+	{
+		m_Nodes[m_Nodes[node].Child].Parent = node;
+		m_Nodes[m_Nodes[node].Child + 1].Parent = node;
+	}
+}
+
+void Bvh::SwapNodes(uint32_t a, uint32_t b)
+{
+	//subtrees trade places, the slots keep their parents
+	uint32_t parentA = m_Nodes[a].Parent;
+	uint32_t parentB = m_Nodes[b].Parent;
+	std::swap(m_Nodes[a], m_Nodes[b]);
+	m_Nodes[a].Parent = parentA;
+	m_Nodes[b].Parent = parentB;
+	FixLinks(a);
+	FixLinks(b);
+}
+
+void Bvh::RefitNode(uint32_t node)
+{
+	const BvhNode& left = m_Nodes[m_Nodes[node].Child];
+	const BvhNode& right = m_Nodes[m_Nodes[node].Child + 1];
+	m_Nodes[node].Min = glm::min(left.Min, right.Min);
+	m_Nodes[node].Max = glm::max(left.Max, right.Max);
+}
+
+void Bvh::Rotate(uint32_t node)
+{
+	//Kopta et al.: swap a child with one of its nephews when that shrinks the sibling the nephew leaves. node's own
+	//box stays the same, so ancestors are unaffected
+	uint32_t left = m_Nodes[node].Child;
+	uint32_t right = left + 1;
+	float bestGain = 0.0f;
+	uint32_t bestChild = NULL_NODE;
+	uint32_t bestNephew = NULL_NODE;
+	auto consider = [&](uint32_t child, uint32_t sibling)
+	{
+		if (m_Nodes[sibling].IsLeaf())
+		{
+			return;
+		}
+		float siblingArea = Area(m_Nodes[sibling]);
+		uint32_t nephews = m_Nodes[sibling].Child;
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			//after the swap the sibling holds the child and the nephew that stays
+			const BvhNode& stays = m_Nodes[nephews + (1 - i)];
+			float gain = siblingArea - UnionArea(m_Nodes[child], stays.Min, stays.Max);
+			if (gain > bestGain)
+			{
+				bestGain = gain;
+				bestChild = child;
+				bestNephew = nephews + i;
+			}
+		}
+	};
+	consider(left, right);
+	consider(right, left);
+	if (bestChild == NULL_NODE)
+	{
+		return;
+	}
+	uint32_t sibling = m_Nodes[bestNephew].Parent;
+	SwapNodes(bestChild, bestNephew);
+	RefitNode(sibling);
+}
+
+void Bvh::RefitAncestors(uint32_t node)
+{
+	while (node != NULL_NODE)
+	{
+		RefitNode(node);
+		Rotate(node);
+		node = m_Nodes[node].Parent;
+	}
+}
+
+void Bvh::Insert(uint32_t object, const glm::vec3& min, const glm::vec3& max)
+{
+	if (object >= m_Leaves.size())
+	{
+		m_Leaves.resize(object + 1, NULL_NODE);
+	}
+	if (m_Leaves[object] != NULL_NODE)
+	{
+		Remove(object);
+	}
+	if (m_Nodes.size() < 2)
+	{
+		m_Nodes.assign(2, BvhNode{});
+		m_Nodes[0].Parent = NULL_NODE;
+	}
+	if (m_ObjectCount == 0)
+	{
+		SetLeaf(0, object, min, max);
+		m_ObjectCount = 1;
+		return;
+	}
+
+	//descend towards the sibling whose new parent grows the tree's surface area least (Box2D's heuristic)
+	uint32_t sibling = 0;
+	while (!m_Nodes[sibling].IsLeaf())
+	{
+		const BvhNode& node = m_Nodes[sibling];
+		float combinedArea = UnionArea(node, min, max);
+		float cost = combinedArea;
+		//every ancestor below here grows by at least this much
+		float inheritedCost = combinedArea - Area(node);
+		float childCost[2];
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			const BvhNode& child = m_Nodes[node.Child + i];
+			float area = UnionArea(child, min, max);
+			childCost[i] = (child.IsLeaf() ? area : area - Area(child)) + inheritedCost;
+		}
+		if (cost < childCost[0] && cost < childCost[1])
+		{
+			break;
+		}
+		sibling = node.Child + (childCost[1] < childCost[0] ? 1 : 0);
+	}
+
+	//the sibling's contents move down into a new pair next to the leaf, its slot becomes their parent
+	uint32_t pair = AllocatePair();
+	m_Nodes[pair] = m_Nodes[sibling];
+	m_Nodes[pair].Parent = sibling;
+	FixLinks(pair);
+	m_Nodes[pair + 1].Parent = sibling;
+	SetLeaf(pair + 1, object, min, max);
+	m_Nodes[sibling].Child = pair;
+	m_ObjectCount++;
+	RefitAncestors(sibling);
+}
+
+void Bvh::Remove(uint32_t object)
+{
+	if (object >= m_Leaves.size() || m_Leaves[object] == NULL_NODE)
+	{
+		return;
+	}
+	uint32_t leaf = m_Leaves[object];
+	m_Leaves[object] = NULL_NODE;
+	m_ObjectCount--;
+	if (leaf == 0)
+	{
+		return;
+	}
+
+	//the sibling takes over the parent's slot and the pair is freed
+	uint32_t parent = m_Nodes[leaf].Parent;
+	uint32_t sibling = leaf ^ 1u;
+	uint32_t grandparent = m_Nodes[parent].Parent;
+	m_Nodes[parent] = m_Nodes[sibling];
+	m_Nodes[parent].Parent = grandparent;
+	FixLinks(parent);
+	m_FreePairs.push_back(leaf & ~1u);
+	RefitAncestors(grandparent);
+}
+
+void Bvh::Update(uint32_t object, const glm::vec3& min, const glm::vec3& max)
+{
+	uint32_t leaf = m_Leaves[object];
+	m_Nodes[leaf].Min = min;
+	m_Nodes[leaf].Max = max;
+	m_Moved.push_back(object);
+}
+
+void Bvh::Refit()
+{
+	for (uint32_t object : m_Moved)
+	{
+		if (m_Leaves[object] == NULL_NODE)
+		{
+			continue;
+		}
+		uint32_t node = m_Nodes[m_Leaves[object]].Parent;
+		while (node != NULL_NODE)
+		{
+			glm::vec3 oldMin = m_Nodes[node].Min;
+			glm::vec3 oldMax = m_Nodes[node].Max;
+			RefitNode(node);
+			Rotate(node);
+			//unchanged here means unchanged all the way up
+			if (m_Nodes[node].Min == oldMin && m_Nodes[node].Max == oldMax)
+			{
+				break;
+			}
+			node = m_Nodes[node].Parent;
+		}
+	}
+	bool moved = !m_Moved.empty();
+	m_Moved.clear();
+	if (!moved || m_ObjectCount < 2)
+	{
+		return;
+	}
+	float cost = ComputeCost();
+	//a tree grown by inserts alone has no build to compare against, its first refit sets the baseline
+	if (m_BuildCost <= 0.0f)
+	{
+		m_BuildCost = cost;
+	}
+	else if (cost > m_BuildCost * REBUILD_COST_RATIO)
+	{
+		Rebuild();
+	}
+}
+
+float Bvh::ComputeCost() const
+{
+	if (m_ObjectCount < 2)
+	{
+		return 0.0f;
+	}
+	float rootArea = (std::max)(Area(m_Nodes[0]), std::numeric_limits<float>::min());
+	float sum = 0.0f;
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty())
+	{
+		uint32_t node = stack.back();
+		stack.pop_back();
+		if (m_Nodes[node].IsLeaf())
+		{
+			continue;
+		}
+		sum += Area(m_Nodes[node]);
+		stack.push_back(m_Nodes[node].Child);
+		stack.push_back(m_Nodes[node].Child + 1);
+	}
+	return sum / rootArea;
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& objects) const
+{
+	objects.clear();
+	if (m_ObjectCount == 0)
+	{
+		return;
+	}
+	//planes a node is fully inside of are dropped for its whole subtree, an empty mask takes the subtree as is
+	struct Entry
+	{
+		uint32_t Node;
+		uint32_t PlaneMask;
+	};
+	const uint32_t allPlanes = (1u << Frustum::PlaneCount) - 1;
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	stack.push_back({ 0, allPlanes });
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+		const BvhNode& node = m_Nodes[entry.Node];
+		uint32_t mask = entry.PlaneMask;
+		bool outside = false;
+		for (int plane = 0; plane < Frustum::PlaneCount && !outside; plane++)
+		{
+			if ((mask & (1u << plane)) == 0)
+			{
+				continue;
+			}
+			const glm::vec4& p = frustum.Planes[plane];
+			glm::vec3 furthest(p.x >= 0.0f ? node.Max.x : node.Min.x, p.y >= 0.0f ? node.Max.y : node.Min.y, p.z >= 0.0f ? node.Max.z : node.Min.z);
+			glm::vec3 nearest(p.x >= 0.0f ? node.Min.x : node.Max.x, p.y >= 0.0f ? node.Min.y : node.Max.y, p.z >= 0.0f ? node.Min.z : node.Max.z);
+			outside = glm::dot(glm::vec3(p), furthest) + p.w < 0.0f;
+			if (glm::dot(glm::vec3(p), nearest) + p.w >= 0.0f)
+			{
+				mask &= ~(1u << plane);
+			}
+		}
+		if (outside)
+		{
+			continue;
+		}
+		if (node.IsLeaf())
+		{
+			objects.push_back(node.GetObject());
+		}
+		else if (mask == 0)
+		{
+			CollectLeaves(entry.Node, objects);
+		}
+		else
+		{
+			stack.push_back({ node.Child + 1, mask });
+			stack.push_back({ node.Child, mask });
+		}
+	}
+}
+
+void Bvh::CollectLeaves(uint32_t node, std::vector<uint32_t>& objects) const
+{
+	uint32_t stack[MAX_COLLECT_DEPTH];
+	uint32_t depth = 0;
+	stack[depth++] = node;
+	while (depth > 0)
+	{
+		const BvhNode& current = m_Nodes[stack[--depth]];
+		if (current.IsLeaf())
+		{
+			objects.push_back(current.GetObject());
+		}
+		//deeper than a balanced tree gets: finish this branch the slow way
+		else if (depth + 2 > MAX_COLLECT_DEPTH)
+		{
+			CollectLeaves(current.Child, objects);
+			CollectLeaves(current.Child + 1, objects);
+		}
+		else
+		{
+			stack[depth++] = current.Child + 1;
+			stack[depth++] = current.Child;
+		}
+	}
+}
+
+void Bvh::SortObjects(std::vector<uint32_t>& objects, std::vector<uint64_t>& bits) const
+{
+	bits.assign((m_Leaves.size() + 63) / 64, 0);
+	for (uint32_t object : objects)
+	{
+		bits[object / 64] |= uint64_t(1) << (object % 64);
+	}
+	objects.clear();
+	for (uint32_t word = 0; word < bits.size(); word++)
+	{
+		for (uint64_t mask = bits[word]; mask != 0; mask &= mask - 1)
+		{
+			objects.push_back(word * 64 + static_cast<uint32_t>(std::countr_zero(mask)));
+		}
+	}
+}
+
+void Bvh::QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& objects) const
+{
+	objects.clear();
+	if (m_ObjectCount == 0)
+	{
+		return;
+	}
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& node = m_Nodes[stack.back()];
+		stack.pop_back();
+		if (glm::any(glm::lessThan(node.Max, min)) || glm::any(glm::greaterThan(node.Min, max)))
+		{
+			continue;
+		}
+		if (node.IsLeaf())
+		{
+			objects.push_back(node.GetObject());
+		}
+		else
+		{
+			stack.push_back(node.Child + 1);
+			stack.push_back(node.Child);
+		}
+	}
+}
+
+bool Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& object, float& distance) const
+{
+	if (m_ObjectCount == 0)
+	{
+		return false;
+	}
+	glm::vec3 inverse = 1.0f / direction;
+	float closest = maxDistance;
+	//slab test, the entry distance is clamped to the origin
+	auto enter = [&](const BvhNode& node, float& entry)
+	{
+		glm::vec3 t0 = (node.Min - origin) * inverse;
+		glm::vec3 t1 = (node.Max - origin) * inverse;
+		glm::vec3 entries = glm::min(t0, t1);
+		glm::vec3 exits = glm::max(t0, t1);
+		entry = (std::max)((std::max)(entries.x, entries.y), (std::max)(entries.z, 0.0f));
+		float exit = (std::min)((std::min)(exits.x, exits.y), (std::min)(exits.z, closest));
+		return entry <= exit;
+	};
+
+	struct Entry
+	{
+		uint32_t Node;
+		float Distance;
+	};
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	float rootEntry;
+	if (!enter(m_Nodes[0], rootEntry))
+	{
+		return false;
+	}
+	stack.push_back({ 0, rootEntry });
+	bool hit = false;
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+		//something closer was found since this was pushed
+		if (entry.Distance > closest)
+		{
+			continue;
+		}
+		const BvhNode& node = m_Nodes[entry.Node];
+		if (node.IsLeaf())
+		{
+			closest = entry.Distance;
+			object = node.GetObject();
+			hit = true;
+			continue;
+		}
+		float distances[2];
+		bool hits[2] = { enter(m_Nodes[node.Child], distances[0]), enter(m_Nodes[node.Child + 1], distances[1]) };
+		//the nearer child goes on top so it is visited first
+		uint32_t nearer = distances[1] < distances[0] ? 1 : 0;
+		if (hits[1 - nearer])
+		{
+			stack.push_back({ node.Child + 1 - nearer, distances[1 - nearer] });
+		}
+		if (hits[nearer])
+		{
+			stack.push_back({ node.Child + nearer, distances[nearer] });
+		}
+	}
+	distance = closest;
+	return hit;
+}
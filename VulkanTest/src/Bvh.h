@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "Frustum.h"
+
+//half a cache line. children are always allocated as an adjacent pair starting at an even index, so both boxes a
+//traversal step tests share one 64-byte line
+struct alignas(32) BvhNode
+{
+	static constexpr uint32_t LEAF_BIT = 0x80000000u;
+
+	glm::vec3 Min;
+	//Bvh::NULL_NODE for the root
+	uint32_t Parent;
+	glm::vec3 Max;
+	//internal: index of the left child, the right one follows it. leaf: LEAF_BIT | object
+	uint32_t Child;
+
+	bool IsLeaf() const { return (Child & LEAF_BIT) != 0; }
+	uint32_t GetObject() const { return Child & ~LEAF_BIT; }
+};
+static_assert(sizeof(BvhNode) == 32, "BvhNode is meant to be half a cache line");
+
+//dynamic bounding volume hierarchy over object boxes, one object per leaf. built top-down with binned SAH, objects
+//can be inserted, removed and moved afterwards: moved leaves are refitted bottom-up with tree rotations along the way,
+//and once the tree's SAH cost drifts too far from the last build it is rebuilt from scratch
+class Bvh
+{
+public:
+	static constexpr uint32_t NULL_NODE = ~0u;
+
+	//replaces the tree with one over objects 0..n-1
+	void Build(const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs);
+	void Insert(uint32_t object, const glm::vec3& min, const glm::vec3& max);
+	void Remove(uint32_t object);
+	//moves an object's box, its ancestors catch up in the next Refit
+	void Update(uint32_t object, const glm::vec3& min, const glm::vec3& max);
+	void Refit();
+	void Rebuild();
+
+	//objects whose box intersects the frustum, unordered. subtrees fully inside are taken without testing their leaves
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& objects) const;
+	//puts a query's result in ascending object order through one bit per object instead of a comparison sort,
+	//bits is scratch kept by the caller
+	void SortObjects(std::vector<uint32_t>& objects, std::vector<uint64_t>& bits) const;
+	//objects whose box overlaps [min, max], unordered
+	void QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& objects) const;
+	//nearest object whose box the ray enters within maxDistance, direction need not be normalized (distance is in its units)
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& object, float& distance) const;
+
+	//surface area of the internal nodes relative to the root's, lower traverses faster
+	float ComputeCost() const;
+	uint32_t GetObjectCount() const { return m_ObjectCount; }
+	const std::vector<BvhNode>& GetNodes() const { return m_Nodes; }
+
+private:
+	//the build partitions copies of the boxes rather than indices into them, so every pass streams through memory
+	struct BuildItem
+	{
+		glm::vec3 Min;
+		uint32_t Object;
+		glm::vec3 Max;
+	};
+
+	void BuildNode(uint32_t node, BuildItem* items, uint32_t count);
+	void BuildFrom(std::vector<uint32_t>& objects, const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& maxs);
+	uint32_t AllocatePair();
+	void SetLeaf(uint32_t node, uint32_t object, const glm::vec3& min, const glm::vec3& max);
+	//points the children (or the object's leaf entry) back at node after its contents moved there
+	void FixLinks(uint32_t node);
+	void SwapNodes(uint32_t a, uint32_t b);
+	void RefitNode(uint32_t node);
+	void Rotate(uint32_t node);
+	void RefitAncestors(uint32_t node);
+	//every object below node, for subtrees known to be inside a query
+	void CollectLeaves(uint32_t node, std::vector<uint32_t>& objects) const;
+
+private:
+	//[0] is the root, [1] is unused so pairs start at even indices
+	std::vector<BvhNode> m_Nodes;
+	std::vector<uint32_t> m_FreePairs;
+	//object -> its leaf, NULL_NODE when the object is not in the tree
+	std::vector<uint32_t> m_Leaves;
+	//objects moved since the last Refit
+	std::vector<uint32_t> m_Moved;
+	uint32_t m_ObjectCount = 0;
+	float m_BuildCost = 0.0f;
+};
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <exception>
+#include <future>
+
+#include "CommandRecorder.h"
+
+namespace
+{
+	//below this a chunk costs more in hand-off than it saves in recording
+	const uint32_t MIN_DRAWS_PER_CHUNK = 64;
+}
+
+void CommandRecorder::Init(vk::Device device, uint32_t queueFamily, uint32_t frameCount, uint32_t workerCount)
+{
+	m_Device = device;
+	m_QueueFamily = queueFamily;
+	m_WorkerCount = (std::max)(workerCount, 1u);
+
+	m_Frames.resize(frameCount);
+	for (auto& frame : m_Frames)
+	{
+		frame.PrimaryPool = CreatePool();
+		vk::CommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = vk::StructureType::eCommandBufferAllocateInfo;
+		allocInfo.setCommandPool(frame.PrimaryPool)
+				 .setCommandBufferCount(1)
+				 .setLevel(vk::CommandBufferLevel::ePrimary);
+		if (m_Device.allocateCommandBuffers(&allocInfo, &frame.Primary) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+	}
+}
+
+void CommandRecorder::Destroy()
+{
+	m_Workers.reset();
+	for (auto& frame : m_Frames)
+	{
+		for (auto& worker : frame.Workers)
+		{
+			m_Device.destroyCommandPool(worker.CommandPool);
+		}
+		m_Device.destroyCommandPool(frame.PrimaryPool);
+	}
+	m_Frames.clear();
+}
+
+void CommandRecorder::BeginFrame(uint32_t frameIndex)
+{
+	m_CurrentFrame = frameIndex;
+	Frame& frame = m_Frames[frameIndex];
+	m_Device.resetCommandPool(frame.PrimaryPool);
+	for (auto& worker : frame.Workers)
+	{
+		if (worker.Used > 0)
+		{
+			m_Device.resetCommandPool(worker.CommandPool);
+			worker.Used = 0;
+		}
+	}
+}
+
+std::vector<vk::CommandBuffer> CommandRecorder::RecordSecondaries(const vk::CommandBufferInheritanceInfo& inheritance, uint32_t drawCount, const RecordFunction& record)
+{
+	if (drawCount == 0)
+	{
+		return {};
+	}
+	Frame& frame = m_Frames[m_CurrentFrame];
+	uint32_t chunkCount = (std::min)(m_WorkerCount, (drawCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK);
+	//pools and threads are only created once a frame has enough draws to need them
+	while (frame.Workers.size() < chunkCount)
+	{
+		WorkerPool worker;
+		worker.CommandPool = CreatePool();
+		frame.Workers.push_back(worker);
+	}
+	std::vector<vk::CommandBuffer> secondaries(chunkCount);
+
+	//chunk i always records into worker pool i, so a pool is never touched by two threads at once
+	auto recordChunk = [&](uint32_t chunk)
+	{
+		uint32_t firstDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * chunk / chunkCount);
+		uint32_t endDraw = static_cast<uint32_t>(static_cast<uint64_t>(drawCount) * (chunk + 1) / chunkCount);
+		vk::CommandBuffer commandBuffer = AcquireSecondary(frame.Workers[chunk]);
+
+		vk::CommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = vk::StructureType::eCommandBufferBeginInfo;
+		beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+				 .setPInheritanceInfo(&inheritance);
+		if (commandBuffer.begin(&beginInfo) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		record(commandBuffer, firstDraw, endDraw - firstDraw);
+		commandBuffer.end();
+		secondaries[chunk] = commandBuffer;
+	};
+
+	if (chunkCount == 1)
+	{
+		recordChunk(0);
+		return secondaries;
+	}
+
+	if (!m_Workers)
+	{
+		m_Workers = std::make_unique<ThreadPool>(m_WorkerCount);
+	}
+	std::vector<std::future<void>> pending;
+	pending.reserve(chunkCount);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		pending.push_back(m_Workers->Submit([&recordChunk, chunk] { recordChunk(chunk); }));
+	}
+	//every chunk has to finish before rethrowing, the others still use recordChunk and secondaries
+	std::exception_ptr error;
+	for (auto& future : pending)
+	{
+		try
+		{
+			future.get();
+		}
+		catch (...)
+		{
+			error = error ? error : std::current_exception();
+		}
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	return secondaries;
+}
+
+vk::CommandPool CommandRecorder::CreatePool()
+{
+	vk::CommandPool pool;
+	vk::CommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = vk::StructureType::eCommandPoolCreateInfo;
+	poolInfo.setQueueFamilyIndex(m_QueueFamily)
+			.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+	if (m_Device.createCommandPool(&poolInfo, nullptr, &pool) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create command pool!");
+	}
+	return pool;
+}
+
+vk::CommandBuffer CommandRecorder::AcquireSecondary(WorkerPool& pool)
+{
+	if (pool.Used < pool.Secondaries.size())
+	{
+		return pool.Secondaries[pool.Used++];
+	}
+	vk::CommandBuffer commandBuffer;
+	vk::CommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = vk::StructureType::eCommandBufferAllocateInfo;
+	allocInfo.setCommandPool(pool.CommandPool)
+			 .setCommandBufferCount(1)
+			 .setLevel(vk::CommandBufferLevel::eSecondary);
+	if (m_Device.allocateCommandBuffers(&allocInfo, &commandBuffer) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
+	pool.Secondaries.push_back(commandBuffer);
+	pool.Used++;
+	return commandBuffer;
+}
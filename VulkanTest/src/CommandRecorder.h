@@ -0,0 +1,52 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../utils/ThreadPool.h"
+
+//records a frame's draws on a worker pool. every (frame, worker) pair owns a command pool that is reset
+//wholesale when the frame comes around again, so no command buffer is ever reset or freed on its own.
+//the pools and the worker threads are created on demand, up to workerCount
+class CommandRecorder
+{
+public:
+	//records draws [firstDraw, firstDraw + drawCount) into a secondary that is already begun inside the render pass
+	using RecordFunction = std::function<void(vk::CommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)>;
+
+	void Init(vk::Device device, uint32_t queueFamily, uint32_t frameCount, uint32_t workerCount = ThreadPool::DefaultThreadCount());
+	void Destroy();
+
+	//resets every pool of frameIndex, only call once that frame's fence has signaled
+	void BeginFrame(uint32_t frameIndex);
+	//the primary of the current frame, comes back reset after BeginFrame
+	vk::CommandBuffer GetPrimary() const { return m_Frames[m_CurrentFrame].Primary; }
+	//splits the draws over the workers and returns the secondaries in draw order, ready for executeCommands
+	std::vector<vk::CommandBuffer> RecordSecondaries(const vk::CommandBufferInheritanceInfo& inheritance, uint32_t drawCount, const RecordFunction& record);
+
+private:
+	struct WorkerPool
+	{
+		vk::CommandPool CommandPool;
+		std::vector<vk::CommandBuffer> Secondaries;
+		uint32_t Used = 0;
+	};
+
+	struct Frame
+	{
+		vk::CommandPool PrimaryPool;
+		vk::CommandBuffer Primary;
+		std::vector<WorkerPool> Workers;
+	};
+
+	vk::CommandPool CreatePool();
+	vk::CommandBuffer AcquireSecondary(WorkerPool& pool);
+
+private:
+	vk::Device m_Device;
+	uint32_t m_QueueFamily = 0;
+	std::vector<Frame> m_Frames;
+	uint32_t m_CurrentFrame = 0;
+	uint32_t m_WorkerCount = 1;
+	std::unique_ptr<ThreadPool> m_Workers;
+};
@@ -0,0 +1,138 @@
+#include "ComputeKernel.h"
+#include "../utils/readFile.h"
+
+void ComputeKernel::Init(vk::Device device, vk::PipelineCache pipelineCache, const std::string& shaderPath, uint32_t bufferCount,
+	uint32_t pushConstantSize, uint32_t setCount)
+{
+	m_Device = device;
+	m_BufferCount = bufferCount;
+	m_PushConstantSize = pushConstantSize;
+
+	std::vector<vk::DescriptorSetLayoutBinding> bindings(bufferCount);
+	for (uint32_t i = 0; i < bufferCount; i++)
+	{
+		bindings[i].setBinding(i)
+				   .setDescriptorCount(1)
+				   .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+				   .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+	}
+	vk::DescriptorSetLayoutCreateInfo setLayoutInfo{};
+	setLayoutInfo.sType = vk::StructureType::eDescriptorSetLayoutCreateInfo;
+	setLayoutInfo.setBindingCount(bufferCount)
+				 .setPBindings(bindings.data());
+	if (m_Device.createDescriptorSetLayout(&setLayoutInfo, nullptr, &m_SetLayout) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create compute descriptor set layout!");
+	}
+
+	vk::PushConstantRange pushRange;
+	pushRange.setStageFlags(vk::ShaderStageFlagBits::eCompute)
+			 .setOffset(0)
+			 .setSize(pushConstantSize);
+	vk::PipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = vk::StructureType::ePipelineLayoutCreateInfo;
+	layoutInfo.setSetLayoutCount(1)
+			  .setPSetLayouts(&m_SetLayout)
+			  .setPushConstantRangeCount(pushConstantSize ? 1 : 0)
+			  .setPPushConstantRanges(&pushRange);
+	if (m_Device.createPipelineLayout(&layoutInfo, nullptr, &m_PipelineLayout) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create compute pipeline layout!");
+	}
+
+	std::vector<char> sourceCode = ReadFile(shaderPath);
+	vk::ShaderModuleCreateInfo shaderModuleInfo{};
+	shaderModuleInfo.sType = vk::StructureType::eShaderModuleCreateInfo;
+	shaderModuleInfo.setPCode(reinterpret_cast<const uint32_t*>(sourceCode.data()))
+					.setCodeSize(sourceCode.size());
+	vk::ShaderModule shaderModule;
+	if (m_Device.createShaderModule(&shaderModuleInfo, nullptr, &shaderModule) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create shader module!");
+	}
+
+	vk::PipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType = vk::StructureType::ePipelineShaderStageCreateInfo;
+	stageInfo.setStage(vk::ShaderStageFlagBits::eCompute)
+			 .setModule(shaderModule)
+			 .setPName("main");
+	vk::ComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = vk::StructureType::eComputePipelineCreateInfo;
+	pipelineInfo.setStage(stageInfo)
+				.setLayout(m_PipelineLayout);
+	vk::Result result = m_Device.createComputePipelines(pipelineCache, 1, &pipelineInfo, nullptr, &m_Pipeline);
+	m_Device.destroyShaderModule(shaderModule);
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create compute pipeline!");
+	}
+
+	vk::DescriptorPoolSize poolSize{};
+	poolSize.setType(vk::DescriptorType::eStorageBuffer)
+			.setDescriptorCount(bufferCount * setCount);
+	vk::DescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = vk::StructureType::eDescriptorPoolCreateInfo;
+	poolInfo.setPoolSizeCount(1)
+			.setPPoolSizes(&poolSize)
+			.setMaxSets(setCount);
+	if (m_Device.createDescriptorPool(&poolInfo, nullptr, &m_DescriptorPool) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create compute descriptor pool!");
+	}
+
+	std::vector<vk::DescriptorSetLayout> layouts(setCount, m_SetLayout);
+	vk::DescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = vk::StructureType::eDescriptorSetAllocateInfo;
+	allocInfo.setDescriptorPool(m_DescriptorPool)
+			 .setDescriptorSetCount(setCount)
+			 .setPSetLayouts(layouts.data());
+	m_DescriptorSets.resize(setCount);
+	if (m_Device.allocateDescriptorSets(&allocInfo, m_DescriptorSets.data()) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to allocate compute descriptor sets!");
+	}
+}
+
+void ComputeKernel::Destroy()
+{
+	if (!m_Device)
+	{
+		return;
+	}
+	m_Device.destroyPipeline(m_Pipeline);
+	m_Device.destroyPipelineLayout(m_PipelineLayout);
+	m_Device.destroyDescriptorPool(m_DescriptorPool);
+	m_Device.destroyDescriptorSetLayout(m_SetLayout);
+	m_Device = vk::Device();
+}
+
+void ComputeKernel::SetBuffers(uint32_t set, const std::vector<vk::Buffer>& buffers)
+{
+	std::vector<vk::DescriptorBufferInfo> bufferInfos(m_BufferCount);
+	std::vector<vk::WriteDescriptorSet> writes(m_BufferCount);
+	for (uint32_t binding = 0; binding < m_BufferCount; binding++)
+	{
+		bufferInfos[binding].setBuffer(buffers[binding])
+							.setOffset(0)
+							.setRange(VK_WHOLE_SIZE);
+		writes[binding].sType = vk::StructureType::eWriteDescriptorSet;
+		writes[binding].setDstSet(m_DescriptorSets[set])
+					   .setDstBinding(binding)
+					   .setDstArrayElement(0)
+					   .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+					   .setDescriptorCount(1)
+					   .setPBufferInfo(&bufferInfos[binding]);
+	}
+	m_Device.updateDescriptorSets(m_BufferCount, writes.data(), 0, nullptr);
+}
+
+void ComputeKernel::Dispatch(vk::CommandBuffer commandBuffer, uint32_t set, const void* pushConstants, uint32_t groupCountX)
+{
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, m_Pipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_PipelineLayout, 0, 1, &m_DescriptorSets[set], 0, nullptr);
+	if (m_PushConstantSize)
+	{
+		commandBuffer.pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, m_PushConstantSize, pushConstants);
+	}
+	commandBuffer.dispatch(groupCountX, 1, 1);
+}
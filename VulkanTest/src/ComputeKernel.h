@@ -0,0 +1,28 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <string>
+#include <vector>
+
+//a compute pipeline whose inputs are storage buffers at bindings 0..n-1 plus one push constant block, with a
+//descriptor set per frame in flight so each frame can point at its own output buffers
+class ComputeKernel
+{
+public:
+	void Init(vk::Device device, vk::PipelineCache pipelineCache, const std::string& shaderPath, uint32_t bufferCount,
+		uint32_t pushConstantSize, uint32_t setCount);
+	void Destroy();
+
+	//buffers[i] is bound whole at binding i
+	void SetBuffers(uint32_t set, const std::vector<vk::Buffer>& buffers);
+	void Dispatch(vk::CommandBuffer commandBuffer, uint32_t set, const void* pushConstants, uint32_t groupCountX);
+
+private:
+	vk::Device m_Device;
+	uint32_t m_BufferCount = 0;
+	uint32_t m_PushConstantSize = 0;
+	vk::DescriptorSetLayout m_SetLayout;
+	vk::DescriptorPool m_DescriptorPool;
+	std::vector<vk::DescriptorSet> m_DescriptorSets;
+	vk::PipelineLayout m_PipelineLayout;
+	vk::Pipeline m_Pipeline;
+};
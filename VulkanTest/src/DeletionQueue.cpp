@@ -0,0 +1,22 @@
+#include "DeletionQueue.h"
+
+void DeletionQueue::Push(uint64_t frame, std::function<void()> destroy)
+{
+	m_Pending.push_back({ frame, std::move(destroy) });
+}
+
+void DeletionQueue::Collect(uint64_t completedFrame)
+{
+	while (!m_Pending.empty() && m_Pending.front().Frame <= completedFrame)
+	{
+		//pop first, the callback may push again
+		Entry entry = std::move(m_Pending.front());
+		m_Pending.pop_front();
+		entry.Destroy();
+	}
+}
+
+void DeletionQueue::Flush()
+{
+	Collect(UINT64_MAX);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+//destroys objects once the GPU has retired the last frame that may still use them, instead of idling the device
+class DeletionQueue
+{
+public:
+	//frames must be pushed in increasing order, which holds as long as they come from FrameTimeline::GetFrame()
+	void Push(uint64_t frame, std::function<void()> destroy);
+	//runs everything queued for frames up to completedFrame
+	void Collect(uint64_t completedFrame);
+	//runs everything left, the caller makes sure the device is idle
+	void Flush();
+	size_t GetPendingCount() const { return m_Pending.size(); }
+
+private:
+	struct Entry
+	{
+		uint64_t Frame;
+		std::function<void()> Destroy;
+	};
+	std::deque<Entry> m_Pending;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <string>
+
+//what the picked physical device can do beyond the hard requirements,
+//filled once by Application::PickPhysicalDevice and enabled in CreateLogicDevice
+struct DeviceCapabilities
+{
+	std::string Name;
+	uint32_t ApiVersion = 0;
+	vk::PhysicalDeviceType Type = vk::PhysicalDeviceType::eOther;
+	vk::DeviceSize DeviceLocalBytes = 0;
+
+	//queue topology
+	bool DedicatedTransferQueue = false;
+	bool AsyncComputeQueue = false;
+	bool UnifiedGraphicsPresent = false;
+
+	//optional features, only set when the device reports support
+	bool TimelineSemaphore = false;
+	bool Synchronization2 = false;
+	bool DynamicRendering = false;
+	bool DescriptorIndexing = false;
+	//multi-draw indirect, and its count variant that takes the draw count from a buffer
+	bool MultiDrawIndirect = false;
+	bool DrawIndirectCount = false;
+	//indirect commands may set firstInstance, the GPU-driven object path uses it as the object index
+	bool DrawIndirectFirstInstance = false;
+	//VK_EXT_mesh_shader is exposed. only reported, meshlets are culled by compute + indirect draws on every device
+	bool MeshShader = false;
+
+	bool SupportsApi(uint32_t version) const { return ApiVersion >= version; }
+};
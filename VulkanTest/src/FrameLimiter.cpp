@@ -0,0 +1,45 @@
+#include <thread>
+
+#include "FrameLimiter.h"
+
+namespace
+{
+	//OS sleeps overshoot by up to a scheduler tick, the rest of the wait is spent spinning
+	const std::chrono::microseconds SPIN_MARGIN(2000);
+}
+
+void FrameLimiter::SetTargetRate(double framesPerSecond)
+{
+	m_Interval = framesPerSecond > 0.0 ?
+		std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond)) : Clock::duration::zero();
+	m_Next = Clock::time_point();
+}
+
+void FrameLimiter::Wait()
+{
+	if (m_Interval == Clock::duration::zero())
+	{
+		return;
+	}
+	Clock::time_point now = Clock::now();
+	if (m_Next == Clock::time_point())
+	{
+		m_Next = now;
+	}
+	if (m_Next - now > SPIN_MARGIN)
+	{
+		std::this_thread::sleep_for(m_Next - now - SPIN_MARGIN);
+	}
+	while (Clock::now() < m_Next)
+	{
+		std::this_thread::yield();
+	}
+
+	//a late frame moves the schedule instead of letting the following frames catch up in a burst
+	now = Clock::now();
+	m_Next += m_Interval;
+	if (m_Next < now)
+	{
+		m_Next = now + m_Interval;
+	}
+}
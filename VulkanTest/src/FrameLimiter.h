@@ -0,0 +1,18 @@
+#pragma once
+#include <chrono>
+
+//caps the frame rate on the CPU. Wait() is called before input is sampled, so time spent waiting delays the frame
+//rather than sitting between sampling and presenting it
+class FrameLimiter
+{
+public:
+	//0 turns the limiter off
+	void SetTargetRate(double framesPerSecond);
+	void Wait();
+	double GetTargetRate() const { return m_Interval.count() > 0 ? 1.0 / std::chrono::duration<double>(m_Interval).count() : 0.0; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+	Clock::duration m_Interval = Clock::duration::zero();
+	Clock::time_point m_Next;
+};
@@ -0,0 +1,68 @@
+#include <iostream>
+
+#include "FrameRingBuffer.h"
+
+namespace
+{
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+void FrameRingBuffer::Init(vk::Device device, MemoryAllocator* allocator, vk::BufferUsageFlags usage, vk::DeviceSize alignment, vk::DeviceSize frameSize, uint32_t frameCount)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_Alignment = alignment > 0 ? alignment : 1;
+	//every frame region has to start on an aligned offset as well
+	m_FrameSize = AlignUp(frameSize, m_Alignment);
+	m_FrameCount = frameCount;
+
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = vk::StructureType::eBufferCreateInfo;
+	bufferInfo.setSize(m_FrameSize * m_FrameCount)
+			  .setUsage(usage)
+			  .setSharingMode(vk::SharingMode::eExclusive);
+	if (m_Device.createBuffer(&bufferInfo, nullptr, &m_Buffer) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create ring buffer!");
+	}
+
+	AllocationCreateInfo allocationInfo{};
+	allocationInfo.Properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	m_Allocation = m_Allocator->AllocateForBuffer(m_Buffer, allocationInfo);
+	m_Device.bindBufferMemory(m_Buffer, m_Allocation.Memory, m_Allocation.Offset);
+}
+
+void FrameRingBuffer::Destroy()
+{
+	std::cout << "ring buffer: peak " << m_Peak << " of " << m_FrameSize << " bytes per frame" << std::endl;
+	m_Device.destroyBuffer(m_Buffer);
+	m_Allocator->Free(m_Allocation);
+}
+
+void FrameRingBuffer::BeginFrame(uint32_t frameIndex)
+{
+	m_FrameBegin = m_FrameSize * (frameIndex % m_FrameCount);
+	m_Cursor = m_FrameBegin;
+}
+
+RingAllocation FrameRingBuffer::Allocate(vk::DeviceSize size)
+{
+	vk::DeviceSize offset = AlignUp(m_Cursor, m_Alignment);
+	if (offset + size > m_FrameBegin + m_FrameSize)
+	{
+		throw std::runtime_error("ring buffer frame region exhausted!");
+	}
+	m_Cursor = offset + size;
+	if (m_Cursor - m_FrameBegin > m_Peak)
+	{
+		m_Peak = m_Cursor - m_FrameBegin;
+	}
+
+	RingAllocation allocation;
+	allocation.Offset = static_cast<uint32_t>(offset);
+	allocation.Mapped = static_cast<char*>(m_Allocation.Mapped) + offset;
+	return allocation;
+}
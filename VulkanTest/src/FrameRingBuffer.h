@@ -0,0 +1,46 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstring>
+#include "MemoryAllocator.h"
+
+struct RingAllocation
+{
+	//offset from the start of the buffer, passed as the dynamic offset when binding
+	uint32_t Offset = 0;
+	void* Mapped = nullptr;
+};
+
+//one persistently mapped buffer split into a region per frame in flight, handing out aligned ranges that live until the frame comes around again
+class FrameRingBuffer
+{
+public:
+	void Init(vk::Device device, MemoryAllocator* allocator, vk::BufferUsageFlags usage, vk::DeviceSize alignment, vk::DeviceSize frameSize, uint32_t frameCount);
+	void Destroy();
+
+	//start handing out the region of frameIndex, only call once the frame that last used it has retired
+	void BeginFrame(uint32_t frameIndex);
+	RingAllocation Allocate(vk::DeviceSize size);
+	template<typename T>
+	uint32_t Push(const T& data)
+	{
+		RingAllocation allocation = Allocate(sizeof(T));
+		memcpy(allocation.Mapped, &data, sizeof(T));
+		return allocation.Offset;
+	}
+
+	vk::Buffer GetBuffer() const { return m_Buffer; }
+	vk::DeviceSize GetFrameSize() const { return m_FrameSize; }
+private:
+	vk::Device m_Device;
+	MemoryAllocator* m_Allocator = nullptr;
+	vk::Buffer m_Buffer;
+	Allocation m_Allocation;
+	vk::DeviceSize m_Alignment = 1;
+	vk::DeviceSize m_FrameSize = 0;
+	uint32_t m_FrameCount = 0;
+
+	vk::DeviceSize m_FrameBegin = 0;
+	vk::DeviceSize m_Cursor = 0;
+	//high-water mark of a single frame, printed at shutdown to size the ring
+	vk::DeviceSize m_Peak = 0;
+};
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <algorithm>
+
+#include "FrameStats.h"
+
+void FrameStats::Record(const FrameTiming& timing)
+{
+	if (m_Frames.size() < m_Capacity)
+	{
+		m_Frames.push_back(timing);
+	}
+	else
+	{
+		m_Frames[m_Recorded % m_Capacity] = timing;
+	}
+	m_Recorded++;
+}
+
+void FrameStats::Print() const
+{
+	if (m_Frames.empty())
+	{
+		return;
+	}
+	auto printMetric = [this](const char* name, double FrameTiming::* member)
+	{
+		std::vector<double> values;
+		values.reserve(m_Frames.size());
+		double sum = 0.0;
+		for (auto& frame : m_Frames)
+		{
+			values.push_back(frame.*member * 1000.0);
+			sum += values.back();
+		}
+		std::sort(values.begin(), values.end());
+		std::cout << "  " << name << ": avg " << sum / values.size() << "ms, p50 " << values[values.size() / 2]
+				  << "ms, p99 " << values[(values.size() - 1) * 99 / 100] << "ms, max " << values.back() << "ms" << std::endl;
+	};
+	std::cout << "frame timings over the last " << m_Frames.size() << " of " << m_Recorded << " frames:" << std::endl;
+	printMetric("acquire wait", &FrameTiming::AcquireWait);
+	printMetric("frame wait", &FrameTiming::FrameWait);
+	printMetric("present interval", &FrameTiming::PresentInterval);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//CPU-side timings of one frame, in seconds
+struct FrameTiming
+{
+	//blocked in vkAcquireNextImageKHR
+	double AcquireWait = 0.0;
+	//blocked on the frame timeline until the frame's slot was free
+	double FrameWait = 0.0;
+	//time since the previous present (submit when headless)
+	double PresentInterval = 0.0;
+};
+
+//keeps the last capacity frames and prints percentiles of each timing at shutdown
+class FrameStats
+{
+public:
+	explicit FrameStats(size_t capacity = 16384) : m_Capacity(capacity) {}
+	void Record(const FrameTiming& timing);
+	void Print() const;
+	uint64_t GetFrameCount() const { return m_Recorded; }
+
+private:
+	size_t m_Capacity;
+	std::vector<FrameTiming> m_Frames;
+	uint64_t m_Recorded = 0;
+};
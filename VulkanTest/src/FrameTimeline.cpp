@@ -0,0 +1,68 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+#include "FrameTimeline.h"
+
+void FrameTimeline::Init(vk::Device device, uint32_t framesInFlight)
+{
+	m_Device = device;
+	m_FramesInFlight = (std::max)(framesInFlight, 1u);
+	m_Frame = 0;
+
+	vk::SemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = vk::StructureType::eSemaphoreTypeCreateInfo;
+	typeInfo.setSemaphoreType(vk::SemaphoreType::eTimeline)
+			.setInitialValue(0);
+	vk::SemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = vk::StructureType::eSemaphoreCreateInfo;
+	semaphoreInfo.setPNext(&typeInfo);
+	if (m_Device.createSemaphore(&semaphoreInfo, nullptr, &m_Semaphore) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create frame timeline semaphore!");
+	}
+}
+
+void FrameTimeline::Destroy()
+{
+	std::cout << "frames: " << m_Frame << " with " << m_FramesInFlight << " in flight, " << m_StalledFrames << " waited on the GPU for "
+			  << m_StalledSeconds * 1000.0 << "ms" << std::endl;
+	m_Device.destroySemaphore(m_Semaphore);
+}
+
+uint64_t FrameTimeline::BeginFrame()
+{
+	m_Frame++;
+	m_LastWait = 0.0;
+	if (m_Frame > m_FramesInFlight)
+	{
+		uint64_t previous = m_Frame - m_FramesInFlight;
+		if (!IsComplete(previous))
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			Wait(previous);
+			m_LastWait = std::chrono::duration<double, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - startTime).count();
+			m_StalledSeconds += m_LastWait;
+			m_StalledFrames++;
+		}
+	}
+	return m_Frame;
+}
+
+uint64_t FrameTimeline::GetCompletedFrame() const
+{
+	return m_Device.getSemaphoreCounterValue(m_Semaphore);
+}
+
+void FrameTimeline::Wait(uint64_t frame) const
+{
+	vk::SemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = vk::StructureType::eSemaphoreWaitInfo;
+	waitInfo.setSemaphoreCount(1)
+			.setPSemaphores(&m_Semaphore)
+			.setPValues(&frame);
+	if (m_Device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to wait for frame!");
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+//counts frames on one timeline semaphore: submitting frame n signals the value n. frame n reuses the per-frame
+//resources (slot) of frame n - framesInFlight, so it may only start once that frame has retired
+class FrameTimeline
+{
+public:
+	void Init(vk::Device device, uint32_t framesInFlight);
+	void Destroy();
+
+	//blocks only if the frame that last used the next slot is still running, returns the new frame number (from 1)
+	uint64_t BeginFrame();
+	//hand back the number of a frame abandoned before anything was submitted for it, nothing would ever signal it
+	void CancelFrame() { m_Frame--; }
+	uint64_t GetFrame() const { return m_Frame; }
+	uint32_t GetSlot() const { return static_cast<uint32_t>(m_Frame % m_FramesInFlight); }
+	uint32_t GetFramesInFlight() const { return m_FramesInFlight; }
+	//seconds the last BeginFrame spent blocked
+	double GetLastWait() const { return m_LastWait; }
+
+	//the latest frame the GPU has finished, does not block
+	uint64_t GetCompletedFrame() const;
+	bool IsComplete(uint64_t frame) const { return GetCompletedFrame() >= frame; }
+	void Wait(uint64_t frame) const;
+
+	//signal GetFrame() on this from the frame's last submission
+	vk::Semaphore GetSemaphore() const { return m_Semaphore; }
+
+private:
+	vk::Device m_Device;
+	vk::Semaphore m_Semaphore;
+	uint32_t m_FramesInFlight = 1;
+	uint64_t m_Frame = 0;
+
+	//how often the CPU ran ahead far enough to wait, printed at shutdown to tune the depth
+	uint64_t m_StalledFrames = 0;
+	double m_StalledSeconds = 0.0;
+	double m_LastWait = 0.0;
+};
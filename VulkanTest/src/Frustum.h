@@ -0,0 +1,60 @@
+#pragma once
+#include <glm.hpp>
+
+//six planes (xyz normal pointing inside, w distance) extracted from a clip matrix. with a model-view-projection
+//matrix the planes are in the model's own space, bounds can be tested there without transforming them
+struct Frustum
+{
+	enum Plane { Left, Right, Bottom, Top, Near, Far, PlaneCount };
+	glm::vec4 Planes[PlaneCount];
+
+	static Frustum FromMatrix(const glm::mat4& clip)
+	{
+		//Gribb/Hartmann: rows of the matrix, glm is column-major
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++)
+		{
+			rows[row] = glm::vec4(clip[0][row], clip[1][row], clip[2][row], clip[3][row]);
+		}
+		Frustum frustum;
+		frustum.Planes[Left] = rows[3] + rows[0];
+		frustum.Planes[Right] = rows[3] - rows[0];
+		frustum.Planes[Bottom] = rows[3] + rows[1];
+		frustum.Planes[Top] = rows[3] - rows[1];
+		//z >= -w holds for both depth conventions, for [0, 1] depth it is merely conservative
+		frustum.Planes[Near] = rows[3] + rows[2];
+		frustum.Planes[Far] = rows[3] - rows[2];
+		for (glm::vec4& plane : frustum.Planes)
+		{
+			float length = glm::length(glm::vec3(plane));
+			plane = length > 0.0f ? plane / length : plane;
+		}
+		return frustum;
+	}
+
+	bool IntersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const glm::vec4& plane : Planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool IntersectsBox(const glm::vec3& min, const glm::vec3& max) const
+	{
+		for (const glm::vec4& plane : Planes)
+		{
+			//the corner furthest along the plane normal
+			glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,399 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <future>
+#include <gtc/matrix_transform.hpp>
+
+#include "FrustumCuller.h"
+#include "Bvh.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define CULLING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define CULLING_X86 0
+#endif
+
+//MSVC emits AVX intrinsics in any function, gcc/clang only where the target allows it
+#if CULLING_X86 && (defined(__GNUC__) || defined(__clang__))
+#define CULLING_TARGET_AVX __attribute__((target("avx")))
+#else
+#define CULLING_TARGET_AVX
+#endif
+
+namespace
+{
+	//below this a chunk costs more to hand to a worker than to cull
+	const uint32_t MIN_CHUNK_OBJECTS = 16 * 1024;
+	const uint32_t SIMD_WIDTH = 8;
+
+	struct CullInput
+	{
+		const CullingBounds* Bounds;
+		glm::vec4 Planes[Frustum::PlaneCount];
+		//per plane, the box corner furthest along its normal: max where the normal is positive, min otherwise
+		const float* CornerX[Frustum::PlaneCount];
+		const float* CornerY[Frustum::PlaneCount];
+		const float* CornerZ[Frustum::PlaneCount];
+	};
+
+	//writes the visible indices in [begin, end) to visible, which has room for end - begin, returns how many
+	using CullKernel = uint32_t(*)(const CullInput& input, uint32_t begin, uint32_t end, uint32_t* visible);
+
+	uint32_t CullScalar(const CullInput& input, uint32_t begin, uint32_t end, uint32_t* visible)
+	{
+		const CullingBounds& bounds = *input.Bounds;
+		end = (std::min)(end, bounds.Count);
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			bool inside = true;
+			for (int plane = 0; plane < Frustum::PlaneCount && inside; plane++)
+			{
+				const glm::vec4& p = input.Planes[plane];
+				float sphere = bounds.CenterX[i] * p.x + bounds.CenterY[i] * p.y + bounds.CenterZ[i] * p.z + p.w + bounds.Radius[i];
+				float box = input.CornerX[plane][i] * p.x + input.CornerY[plane][i] * p.y + input.CornerZ[plane][i] * p.z + p.w;
+				inside = sphere >= 0.0f && box >= 0.0f;
+			}
+			visible[count] = i;
+			count += inside ? 1 : 0;
+		}
+		return count;
+	}
+
+#if CULLING_X86
+	uint32_t CullSSE(const CullInput& input, uint32_t begin, uint32_t end, uint32_t* visible)
+	{
+		const CullingBounds& bounds = *input.Bounds;
+		__m128 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount], planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+		for (int plane = 0; plane < Frustum::PlaneCount; plane++)
+		{
+			planeX[plane] = _mm_set1_ps(input.Planes[plane].x);
+			planeY[plane] = _mm_set1_ps(input.Planes[plane].y);
+			planeZ[plane] = _mm_set1_ps(input.Planes[plane].z);
+			planeW[plane] = _mm_set1_ps(input.Planes[plane].w);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i += 4)
+		{
+			__m128 centerX = _mm_loadu_ps(&bounds.CenterX[i]);
+			__m128 centerY = _mm_loadu_ps(&bounds.CenterY[i]);
+			__m128 centerZ = _mm_loadu_ps(&bounds.CenterZ[i]);
+			__m128 radius = _mm_loadu_ps(&bounds.Radius[i]);
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int plane = 0; plane < Frustum::PlaneCount; plane++)
+			{
+				__m128 sphere = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, planeX[plane]), _mm_mul_ps(centerY, planeY[plane])),
+					_mm_add_ps(_mm_mul_ps(centerZ, planeZ[plane]), _mm_add_ps(planeW[plane], radius)));
+				__m128 box = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(input.CornerX[plane] + i), planeX[plane]), _mm_mul_ps(_mm_loadu_ps(input.CornerY[plane] + i), planeY[plane])),
+					_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(input.CornerZ[plane] + i), planeZ[plane]), planeW[plane]));
+				inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(sphere, zero), _mm_cmpge_ps(box, zero)));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					break;
+				}
+			}
+			//branchless compaction, every lane is written and only the visible ones advance the cursor
+			int mask = _mm_movemask_ps(inside);
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				visible[count] = i + lane;
+				count += (mask >> lane) & 1;
+			}
+		}
+		return count;
+	}
+
+	CULLING_TARGET_AVX uint32_t CullAVX(const CullInput& input, uint32_t begin, uint32_t end, uint32_t* visible)
+	{
+		const CullingBounds& bounds = *input.Bounds;
+		__m256 planeX[Frustum::PlaneCount], planeY[Frustum::PlaneCount], planeZ[Frustum::PlaneCount], planeW[Frustum::PlaneCount];
+		for (int plane = 0; plane < Frustum::PlaneCount; plane++)
+		{
+			planeX[plane] = _mm256_set1_ps(input.Planes[plane].x);
+			planeY[plane] = _mm256_set1_ps(input.Planes[plane].y);
+			planeZ[plane] = _mm256_set1_ps(input.Planes[plane].z);
+			planeW[plane] = _mm256_set1_ps(input.Planes[plane].w);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		uint32_t count = 0;
+		for (uint32_t i = begin; i < end; i += 8)
+		{
+			__m256 centerX = _mm256_loadu_ps(&bounds.CenterX[i]);
+			__m256 centerY = _mm256_loadu_ps(&bounds.CenterY[i]);
+			__m256 centerZ = _mm256_loadu_ps(&bounds.CenterZ[i]);
+			__m256 radius = _mm256_loadu_ps(&bounds.Radius[i]);
+			__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+			for (int plane = 0; plane < Frustum::PlaneCount; plane++)
+			{
+				__m256 sphere = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX, planeX[plane]), _mm256_mul_ps(centerY, planeY[plane])),
+					_mm256_add_ps(_mm256_mul_ps(centerZ, planeZ[plane]), _mm256_add_ps(planeW[plane], radius)));
+				__m256 box = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(input.CornerX[plane] + i), planeX[plane]), _mm256_mul_ps(_mm256_loadu_ps(input.CornerY[plane] + i), planeY[plane])),
+					_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(input.CornerZ[plane] + i), planeZ[plane]), planeW[plane]));
+				inside = _mm256_and_ps(inside, _mm256_and_ps(_mm256_cmp_ps(sphere, zero, _CMP_GE_OQ), _mm256_cmp_ps(box, zero, _CMP_GE_OQ)));
+				if (_mm256_movemask_ps(inside) == 0)
+				{
+					break;
+				}
+			}
+			int mask = _mm256_movemask_ps(inside);
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				visible[count] = i + lane;
+				count += (mask >> lane) & 1;
+			}
+		}
+		return count;
+	}
+#endif
+
+	CullKernel GetKernel(CullingPath path)
+	{
+#if CULLING_X86
+		switch (path)
+		{
+		case CullingPath::SSE: return CullSSE;
+		case CullingPath::AVX: return CullAVX;
+		default: break;
+		}
+#endif
+		return CullScalar;
+	}
+}
+
+void CullingBounds::Build(const Scene& scene)
+{
+	Count = scene.GetObjectCount();
+	size_t padded = (Count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	for (std::vector<float>* field : { &CenterX, &CenterY, &CenterZ, &MinX, &MinY, &MinZ, &MaxX, &MaxY, &MaxZ })
+	{
+		field->assign(padded, 0.0f);
+	}
+	//a padding sphere fails every plane
+	Radius.assign(padded, -INFINITY);
+	for (uint32_t object = 0; object < Count; object++)
+	{
+		Update(scene, object);
+	}
+}
+
+void CullingBounds::Update(const Scene& scene, uint32_t object)
+{
+	const glm::vec4& sphere = scene.Spheres[object];
+	CenterX[object] = sphere.x;
+	CenterY[object] = sphere.y;
+	CenterZ[object] = sphere.z;
+	Radius[object] = sphere.w;
+	MinX[object] = scene.BoxMins[object].x;
+	MinY[object] = scene.BoxMins[object].y;
+	MinZ[object] = scene.BoxMins[object].z;
+	MaxX[object] = scene.BoxMaxs[object].x;
+	MaxY[object] = scene.BoxMaxs[object].y;
+	MaxZ[object] = scene.BoxMaxs[object].z;
+}
+
+FrustumCuller::FrustumCuller(uint32_t threadCount)
+{
+	m_Workers = std::make_unique<ThreadPool>(threadCount);
+	m_Path = DetectPath();
+}
+
+CullingPath FrustumCuller::DetectPath()
+{
+#if CULLING_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	//the OS has to save the upper halves of the ymm registers too
+	if (osxsave && avx && (_xgetbv(0) & 6) == 6)
+	{
+		return CullingPath::AVX;
+	}
+#else
+	if (__builtin_cpu_supports("avx"))
+	{
+		return CullingPath::AVX;
+	}
+#endif
+	return CullingPath::SSE;
+#else
+	return CullingPath::Scalar;
+#endif
+}
+
+const char* FrustumCuller::GetPathName(CullingPath path)
+{
+	switch (path)
+	{
+	case CullingPath::SSE: return "SSE";
+	case CullingPath::AVX: return "AVX";
+	default: return "scalar";
+	}
+}
+
+void FrustumCuller::SetPath(CullingPath path)
+{
+	m_Path = (std::min)(path, DetectPath());
+}
+
+void FrustumCuller::Cull(const CullingBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible)
+{
+	visible.clear();
+	if (bounds.Count == 0)
+	{
+		return;
+	}
+
+	CullInput input;
+	input.Bounds = &bounds;
+	for (int plane = 0; plane < Frustum::PlaneCount; plane++)
+	{
+		const glm::vec4& p = frustum.Planes[plane];
+		input.Planes[plane] = p;
+		input.CornerX[plane] = p.x >= 0.0f ? bounds.MaxX.data() : bounds.MinX.data();
+		input.CornerY[plane] = p.y >= 0.0f ? bounds.MaxY.data() : bounds.MinY.data();
+		input.CornerZ[plane] = p.z >= 0.0f ? bounds.MaxZ.data() : bounds.MinZ.data();
+	}
+	CullKernel kernel = GetKernel(m_Path);
+
+	//a few chunks per worker so an uneven split evens out, each a multiple of the SIMD width
+	uint32_t padded = static_cast<uint32_t>(bounds.Radius.size());
+	uint32_t chunkSize = padded;
+	if (m_Parallel)
+	{
+		uint32_t target = (padded + m_Workers->Size() * 4 - 1) / (m_Workers->Size() * 4);
+		chunkSize = (std::max)(MIN_CHUNK_OBJECTS, (target + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH);
+	}
+	uint32_t chunkCount = (padded + chunkSize - 1) / chunkSize;
+	if (m_ChunkVisible.size() < chunkCount)
+	{
+		m_ChunkVisible.resize(chunkCount);
+	}
+
+	auto cullChunk = [&](uint32_t chunk)
+	{
+		uint32_t begin = chunk * chunkSize;
+		uint32_t end = (std::min)(begin + chunkSize, padded);
+		std::vector<uint32_t>& chunkVisible = m_ChunkVisible[chunk];
+		chunkVisible.resize(end - begin);
+		chunkVisible.resize(kernel(input, begin, end, chunkVisible.data()));
+	};
+
+	if (chunkCount == 1)
+	{
+		cullChunk(0);
+		visible.swap(m_ChunkVisible[0]);
+		return;
+	}
+
+	std::vector<std::future<void>> pending;
+	pending.reserve(chunkCount);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		pending.push_back(m_Workers->Submit([&cullChunk, chunk] { cullChunk(chunk); }));
+	}
+	size_t total = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		pending[chunk].get();
+		total += m_ChunkVisible[chunk].size();
+	}
+	//chunk order keeps the list ascending
+	visible.reserve(total);
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		visible.insert(visible.end(), m_ChunkVisible[chunk].begin(), m_ChunkVisible[chunk].end());
+	}
+}
+
+void BenchmarkFrustumCulling(uint32_t objectCount, uint32_t iterations)
+{
+	//unit cubes on the same grid and with the same orbiting camera the renderer uses for --objects
+	Scene scene;
+	SceneMesh cube;
+	cube.BoxMin = glm::vec3(-0.5f);
+	cube.BoxMax = glm::vec3(0.5f);
+	cube.Bounds = glm::vec4(0.0f, 0.0f, 0.0f, std::sqrt(0.75f));
+	scene.AddMesh(cube);
+	scene.PopulateGrid(0, objectCount);
+	CullingBounds bounds;
+	bounds.Build(scene);
+
+	glm::vec4 sceneBounds = scene.ComputeBounds();
+	glm::vec3 center = glm::vec3(sceneBounds);
+	float distance = sceneBounds.w * 0.5f;
+	glm::vec3 eye = center + glm::vec3(distance, 0.0f, sceneBounds.w * 0.1f);
+	glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, distance + sceneBounds.w);
+	Frustum frustum = Frustum::FromMatrix(projection * view);
+
+	FrustumCuller culler;
+	std::vector<uint32_t> reference;
+	culler.SetPath(CullingPath::Scalar);
+	culler.SetParallel(false);
+	culler.Cull(bounds, frustum, reference);
+	std::cout << "cull benchmark: " << objectCount << " objects, " << reference.size() << " visible, "
+			  << iterations << " iterations" << std::endl;
+
+	std::vector<uint32_t> visible;
+	for (CullingPath path : { CullingPath::Scalar, CullingPath::SSE, CullingPath::AVX })
+	{
+		if (path > FrustumCuller::DetectPath())
+		{
+			continue;
+		}
+		for (bool parallel : { false, true })
+		{
+			culler.SetPath(path);
+			culler.SetParallel(parallel);
+			//warm-up, sizes the chunk lists
+			culler.Cull(bounds, frustum, visible);
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				culler.Cull(bounds, frustum, visible);
+			}
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			double throughput = static_cast<double>(objectCount) * iterations / (std::max)(milliseconds, 1e-6);
+			std::cout << "  " << FrustumCuller::GetPathName(path) << ", " << (parallel ? culler.GetThreadCount() : 1) << " thread(s): "
+					  << static_cast<uint64_t>(throughput) << " objects/ms" << (visible != reference ? " (result differs from scalar!)" : "") << std::endl;
+		}
+	}
+
+	//the same frustum through the hierarchy. it tests boxes only, so it may keep a few objects the sphere test drops
+	Bvh bvh;
+	std::vector<uint64_t> bits;
+	auto start = std::chrono::steady_clock::now();
+	bvh.Build(scene.BoxMins, scene.BoxMaxs);
+	double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		bvh.QueryFrustum(frustum, visible);
+		bvh.SortObjects(visible, bits);
+	}
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	double throughput = static_cast<double>(objectCount) * iterations / (std::max)(milliseconds, 1e-6);
+	std::cout << "  bvh, 1 thread(s): " << static_cast<uint64_t>(throughput) << " objects/ms, " << visible.size() << " visible, built in "
+			  << buildMilliseconds << " ms, SAH cost " << bvh.ComputeCost() << std::endl;
+
+	//nudge 1% of the objects and let the tree catch up
+	uint32_t movedCount = (std::max)(1u, objectCount / 100);
+	for (uint32_t i = 0; i < movedCount; i++)
+	{
+		uint32_t object = i * (objectCount / movedCount);
+		scene.SetTransform(object, glm::translate(scene.Transforms[object], glm::vec3(0.5f, -0.25f, 0.75f)));
+		bvh.Update(object, scene.BoxMins[object], scene.BoxMaxs[object]);
+	}
+	start = std::chrono::steady_clock::now();
+	bvh.Refit();
+	milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "  bvh refit after moving " << movedCount << " objects: " << milliseconds << " ms, SAH cost " << bvh.ComputeCost() << std::endl;
+}
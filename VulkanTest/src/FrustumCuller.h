@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm.hpp>
+#include "Frustum.h"
+#include "Scene.h"
+#include "../utils/ThreadPool.h"
+
+enum class CullingPath
+{
+	Scalar,
+	//4 objects per iteration
+	SSE,
+	//8 objects per iteration
+	AVX
+};
+
+//world-space bounds of every object, one float array per component so a SIMD register loads the same component of
+//consecutive objects. the arrays are padded to a multiple of 8 with volumes that never pass
+struct CullingBounds
+{
+	std::vector<float> CenterX, CenterY, CenterZ, Radius;
+	std::vector<float> MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+	uint32_t Count = 0;
+
+	void Build(const Scene& scene);
+	//after Scene::SetTransform, for objects that move
+	void Update(const Scene& scene, uint32_t object);
+};
+
+//CPU frustum culling: an object is visible when both its sphere and its box intersect the frustum. the sphere test
+//rejects most objects cheaply, the box keeps long thin ones from passing everywhere. large inputs are split into
+//chunks culled in parallel
+class FrustumCuller
+{
+public:
+	explicit FrustumCuller(uint32_t threadCount = ThreadPool::DefaultThreadCount());
+
+	//widest path the CPU and OS support, SSE is always there on x86-64
+	static CullingPath DetectPath();
+	static const char* GetPathName(CullingPath path);
+
+	//clamped to what DetectPath returns
+	void SetPath(CullingPath path);
+	CullingPath GetPath() const { return m_Path; }
+	void SetParallel(bool parallel) { m_Parallel = parallel; }
+	uint32_t GetThreadCount() const { return m_Workers->Size(); }
+
+	//indices of the visible objects, ascending
+	void Cull(const CullingBounds& bounds, const Frustum& frustum, std::vector<uint32_t>& visible);
+
+private:
+	std::unique_ptr<ThreadPool> m_Workers;
+	CullingPath m_Path = CullingPath::Scalar;
+	bool m_Parallel = true;
+	//per chunk output, kept between calls so culling every frame does not allocate
+	std::vector<std::vector<uint32_t>> m_ChunkVisible;
+};
+
+//culls a synthetic grid with every path, single-threaded and in parallel, and through a BVH, printing the throughput in
+//objects/ms and the BVH build and refit times
+void BenchmarkFrustumCulling(uint32_t objectCount, uint32_t iterations = 50);
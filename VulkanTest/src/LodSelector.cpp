@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cmath>
+
+#include "LodSelector.h"
+
+void LodSelector::Init(uint32_t objectCount, float errorThreshold, float hysteresis)
+{
+	m_Threshold = errorThreshold;
+	m_Hysteresis = (std::max)(hysteresis, 1.0f);
+	m_Levels.assign(objectCount, 0);
+}
+
+void LodSelector::SetCamera(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight)
+{
+	glm::vec3 eye = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	//projection[1][1] is 1 / tan(fovY / 2), negative once flipped for Vulkan
+	m_Camera = glm::vec4(eye, 0.5f * viewportHeight * std::abs(projection[1][1]));
+}
+
+uint32_t LodSelector::Select(const Scene& scene, uint32_t object)
+{
+	const SceneMesh& mesh = scene.Meshes[scene.MeshIds[object]];
+	if (mesh.Lods.empty())
+	{
+		return 0;
+	}
+	//errors are in mesh units, the world sphere's radius against the mesh's gives the object's scale. the distance
+	//is to the nearest point of the sphere, inside it everything is full detail
+	const glm::vec4& sphere = scene.Spheres[object];
+	float distance = glm::length(glm::vec3(m_Camera) - glm::vec3(sphere)) - sphere.w;
+	float pixelsPerError = sphere.w / (std::max)(mesh.Bounds.w, 1e-6f) * m_Camera.w / (std::max)(distance, 1e-6f);
+	auto projected = [&](uint32_t level) { return level == 0 ? 0.0f : mesh.Lods[level - 1].Error * pixelsPerError; };
+
+	uint32_t level = (std::min)(static_cast<uint32_t>(m_Levels[object]), mesh.GetLodCount() - 1);
+	while (level + 1 < mesh.GetLodCount() && projected(level + 1) <= m_Threshold / m_Hysteresis)
+	{
+		level++;
+	}
+	while (level > 0 && projected(level) > m_Threshold * m_Hysteresis)
+	{
+		level--;
+	}
+	m_Levels[object] = static_cast<uint8_t>(level);
+	return level;
+}
+
+void LodSelector::GatherBatches(const Scene& scene, const std::vector<uint32_t>& objects, std::vector<uint32_t>& order, std::vector<InstanceBatch>& batches)
+{
+	//a stable bucket per level keeps each bucket ascending, so Scene::GatherBatches still finds its runs in it
+	for (std::vector<uint32_t>& levelObjects : m_LevelObjects)
+	{
+		levelObjects.clear();
+	}
+	for (uint32_t object : objects)
+	{
+		uint32_t level = Select(scene, object);
+		if (level >= m_LevelObjects.size())
+		{
+			m_LevelObjects.resize(level + 1);
+		}
+		m_LevelObjects[level].push_back(object);
+	}
+
+	order.clear();
+	batches.clear();
+	for (uint32_t level = 0; level < m_LevelObjects.size(); level++)
+	{
+		scene.GatherBatches(m_LevelObjects[level], m_LevelBatches);
+		for (InstanceBatch batch : m_LevelBatches)
+		{
+			batch.FirstInstance += static_cast<uint32_t>(order.size());
+			batch.Lod = level;
+			batches.push_back(batch);
+		}
+		order.insert(order.end(), m_LevelObjects[level].begin(), m_LevelObjects[level].end());
+	}
+}
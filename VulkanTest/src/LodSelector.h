@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "Scene.h"
+
+//picks a level of detail per object from the screen-space size of its simplification error. every object remembers
+//its level between frames and only changes it once the projected error is clearly on the other side of the
+//threshold, so objects sitting at the threshold distance do not pop back and forth
+class LodSelector
+{
+public:
+	//errorThreshold in pixels. a coarser level is taken once its error projects below threshold / hysteresis, a finer
+	//one once the current level's error passes threshold * hysteresis
+	void Init(uint32_t objectCount, float errorThreshold, float hysteresis = 1.5f);
+	//matrices the frame renders with, the eye ends up in the space the scene's transforms map into
+	void SetCamera(const glm::mat4& modelView, const glm::mat4& projection, float viewportHeight);
+
+	uint32_t Select(const Scene& scene, uint32_t object);
+	//selects every object of an ascending list and regroups them so each (mesh, material, level) run is consecutive.
+	//order receives the objects in instance order, batches the runs with FirstInstance counting entries of order
+	void GatherBatches(const Scene& scene, const std::vector<uint32_t>& objects, std::vector<uint32_t>& order, std::vector<InstanceBatch>& batches);
+
+	//xyz eye, w pixels covered by one unit at distance one
+	const glm::vec4& GetCamera() const { return m_Camera; }
+	float GetThreshold() const { return m_Threshold; }
+	float GetHysteresis() const { return m_Hysteresis; }
+
+private:
+	glm::vec4 m_Camera = glm::vec4(0.0f);
+	float m_Threshold = 1.0f;
+	float m_Hysteresis = 1.5f;
+	std::vector<uint8_t> m_Levels;
+	//per level, kept between calls so selecting every frame does not allocate
+	std::vector<std::vector<uint32_t>> m_LevelObjects;
+	std::vector<InstanceBatch> m_LevelBatches;
+};
@@ -0,0 +1,286 @@
+#include <iostream>
+#include <algorithm>
+
+#include "MemoryAllocator.h"
+
+struct MemoryBlock
+{
+	vk::DeviceMemory Memory;
+	void* Mapped = nullptr;
+	//null for dedicated allocations, which own the whole VkDeviceMemory
+	std::unique_ptr<BlockMetadata> Metadata;
+	MemoryAllocator::Pool* Pool = nullptr;
+};
+
+void MemoryAllocator::Init(vk::PhysicalDevice physicalDevice, vk::Device device)
+{
+	m_PhysicalDevice = physicalDevice;
+	m_Device = device;
+	m_PhysicalDevice.getMemoryProperties(&m_MemoryProperties);
+	vk::PhysicalDeviceLimits limits = m_PhysicalDevice.getProperties().limits;
+	m_BufferImageGranularity = limits.bufferImageGranularity;
+	m_MaxAllocationCount = limits.maxMemoryAllocationCount;
+}
+
+void MemoryAllocator::Destroy()
+{
+	PrintStatistics();
+	for (auto& pool : m_Pools)
+	{
+		for (auto& block : pool->Blocks)
+		{
+			if (!block->Metadata->IsEmpty())
+			{
+				std::cout << "allocator: block of memory type " << pool->MemoryType << " still has " << block->Metadata->UsedBytes() << " bytes allocated" << std::endl;
+			}
+			m_Device.freeMemory(block->Memory);
+		}
+	}
+	m_Pools.clear();
+	for (auto& block : m_DedicatedBlocks)
+	{
+		m_Device.freeMemory(block->Memory);
+	}
+	m_DedicatedBlocks.clear();
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags flags) const
+{
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+		{
+			return i;
+		}
+	}
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+Allocation MemoryAllocator::AllocateForBuffer(vk::Buffer buffer, const AllocationCreateInfo& createInfo)
+{
+	vk::BufferMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = vk::StructureType::eBufferMemoryRequirementsInfo2;
+	requirementsInfo.setBuffer(buffer);
+	vk::MemoryDedicatedRequirements dedicatedRequirements{};
+	vk::MemoryRequirements2 requirements{};
+	requirements.setPNext(&dedicatedRequirements);
+	m_Device.getBufferMemoryRequirements2(&requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	return Allocate(requirements.memoryRequirements, dedicated, false, buffer, nullptr, createInfo);
+}
+
+Allocation MemoryAllocator::AllocateForImage(vk::Image image, vk::ImageTiling tiling, const AllocationCreateInfo& createInfo)
+{
+	vk::ImageMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = vk::StructureType::eImageMemoryRequirementsInfo2;
+	requirementsInfo.setImage(image);
+	vk::MemoryDedicatedRequirements dedicatedRequirements{};
+	vk::MemoryRequirements2 requirements{};
+	requirements.setPNext(&dedicatedRequirements);
+	m_Device.getImageMemoryRequirements2(&requirementsInfo, &requirements);
+
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	bool optimalImage = tiling == vk::ImageTiling::eOptimal && m_BufferImageGranularity > 1;
+	return Allocate(requirements.memoryRequirements, dedicated, optimalImage, nullptr, image, createInfo);
+}
+
+Allocation MemoryAllocator::AllocateForRequirements(const vk::MemoryRequirements& requirements, bool optimalImages, const AllocationCreateInfo& createInfo)
+{
+	return Allocate(requirements, false, optimalImages && m_BufferImageGranularity > 1, nullptr, nullptr, createInfo);
+}
+
+Allocation MemoryAllocator::Allocate(const vk::MemoryRequirements& requirements, bool dedicated, bool optimalImage, vk::Buffer buffer, vk::Image image, const AllocationCreateInfo& createInfo)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, createInfo.Properties);
+	Pool& pool = GetPool(memoryType, createInfo.Strategy, optimalImage);
+
+	//big resources would strand most of a block, give them their own memory like the driver asked for
+	if (dedicated || requirements.size > pool.BlockSize / 2)
+	{
+		return AllocateDedicated(requirements, memoryType, buffer, image);
+	}
+
+	Allocation allocation;
+	for (auto it = pool.Blocks.rbegin(); it != pool.Blocks.rend(); ++it)
+	{
+		MemoryBlock* block = it->get();
+		if (block->Metadata->Allocate(requirements.size, requirements.alignment, allocation.Offset, allocation.Handle))
+		{
+			allocation.Block = block;
+			break;
+		}
+	}
+	if (!allocation.Block)
+	{
+		allocation.Block = CreateBlock(pool);
+		if (!allocation.Block->Metadata->Allocate(requirements.size, requirements.alignment, allocation.Offset, allocation.Handle))
+		{
+			throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+		}
+	}
+	allocation.Memory = allocation.Block->Memory;
+	allocation.Size = requirements.size;
+	allocation.Mapped = allocation.Block->Mapped ? static_cast<char*>(allocation.Block->Mapped) + allocation.Offset : nullptr;
+	m_SubAllocationCount++;
+	return allocation;
+}
+
+Allocation MemoryAllocator::AllocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryType, vk::Buffer buffer, vk::Image image)
+{
+	if (m_DeviceAllocationCount >= m_MaxAllocationCount)
+	{
+		throw std::runtime_error("maxMemoryAllocationCount exceeded!");
+	}
+	vk::MemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = vk::StructureType::eMemoryDedicatedAllocateInfo;
+	dedicatedInfo.setBuffer(buffer)
+				 .setImage(image);
+
+	vk::MemoryAllocateInfo allocateInfo{};
+	allocateInfo.sType = vk::StructureType::eMemoryAllocateInfo;
+	allocateInfo.setPNext(&dedicatedInfo)
+				.setAllocationSize(requirements.size)
+				.setMemoryTypeIndex(memoryType);
+
+	auto block = std::make_unique<MemoryBlock>();
+	if (m_Device.allocateMemory(&allocateInfo, nullptr, &block->Memory) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to allocate dedicated memory!");
+	}
+	block->Mapped = MapIfHostVisible(block->Memory, memoryType);
+	m_DeviceAllocationCount++;
+	m_DedicatedAllocationCount++;
+
+	Allocation allocation;
+	allocation.Memory = block->Memory;
+	allocation.Offset = 0;
+	allocation.Size = requirements.size;
+	allocation.Mapped = block->Mapped;
+	allocation.Block = block.get();
+	m_DedicatedBlocks.push_back(std::move(block));
+	return allocation;
+}
+
+void MemoryAllocator::Free(Allocation& allocation)
+{
+	if (!allocation.Block)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	MemoryBlock* block = allocation.Block;
+	if (!block->Metadata)
+	{
+		m_Device.freeMemory(block->Memory);
+		m_DeviceAllocationCount--;
+		m_DedicatedAllocationCount--;
+		m_DedicatedBlocks.erase(std::find_if(m_DedicatedBlocks.begin(), m_DedicatedBlocks.end(), [block](const std::unique_ptr<MemoryBlock>& entry) { return entry.get() == block; }));
+	}
+	else
+	{
+		block->Metadata->Free(allocation.Handle);
+		m_SubAllocationCount--;
+
+		//keep one empty block around per pool so alloc/free churn does not hit vkAllocateMemory
+		Pool& pool = *block->Pool;
+		if (block->Metadata->IsEmpty() && pool.Blocks.size() > 1)
+		{
+			m_Device.freeMemory(block->Memory);
+			m_DeviceAllocationCount--;
+			pool.Blocks.erase(std::find_if(pool.Blocks.begin(), pool.Blocks.end(), [block](const std::unique_ptr<MemoryBlock>& entry) { return entry.get() == block; }));
+		}
+	}
+	allocation = Allocation();
+}
+
+MemoryAllocator::Pool& MemoryAllocator::GetPool(uint32_t memoryType, AllocationStrategy strategy, bool optimalImage)
+{
+	for (auto& pool : m_Pools)
+	{
+		if (pool->MemoryType == memoryType && pool->Strategy == strategy && pool->OptimalImages == optimalImage)
+		{
+			return *pool;
+		}
+	}
+
+	//small heaps (integrated/BAR) get proportionally smaller blocks
+	const vk::DeviceSize defaultBlockSize = 64ull * 1024 * 1024;
+	vk::DeviceSize heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[memoryType].heapIndex].size;
+	auto pool = std::make_unique<Pool>();
+	pool->MemoryType = memoryType;
+	pool->Strategy = strategy;
+	pool->OptimalImages = optimalImage;
+	pool->BlockSize = heapSize <= 1024ull * 1024 * 1024 ? heapSize / 8 : defaultBlockSize;
+	m_Pools.push_back(std::move(pool));
+	return *m_Pools.back();
+}
+
+MemoryBlock* MemoryAllocator::CreateBlock(Pool& pool)
+{
+	if (m_DeviceAllocationCount >= m_MaxAllocationCount)
+	{
+		throw std::runtime_error("maxMemoryAllocationCount exceeded!");
+	}
+	vk::MemoryAllocateInfo allocateInfo{};
+	allocateInfo.sType = vk::StructureType::eMemoryAllocateInfo;
+	allocateInfo.setAllocationSize(pool.BlockSize)
+				.setMemoryTypeIndex(pool.MemoryType);
+
+	auto block = std::make_unique<MemoryBlock>();
+	if (m_Device.allocateMemory(&allocateInfo, nullptr, &block->Memory) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to allocate memory block!");
+	}
+	block->Mapped = MapIfHostVisible(block->Memory, pool.MemoryType);
+	block->Pool = &pool;
+	if (pool.Strategy == AllocationStrategy::Linear)
+	{
+		block->Metadata = std::make_unique<LinearBlockMetadata>(pool.BlockSize);
+	}
+	else
+	{
+		block->Metadata = std::make_unique<TlsfBlockMetadata>(pool.BlockSize);
+	}
+	m_DeviceAllocationCount++;
+	pool.Blocks.push_back(std::move(block));
+	return pool.Blocks.back().get();
+}
+
+void* MemoryAllocator::MapIfHostVisible(vk::DeviceMemory memory, uint32_t memoryType)
+{
+	if (!(m_MemoryProperties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible))
+	{
+		return nullptr;
+	}
+	void* data = nullptr;
+	if (m_Device.mapMemory(memory, 0, VK_WHOLE_SIZE, {}, &data) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to map memory block!");
+	}
+	return data;
+}
+
+void MemoryAllocator::PrintStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	std::cout << "allocator: " << m_DeviceAllocationCount << " device allocations (" << m_DedicatedAllocationCount << " dedicated, limit "
+			  << m_MaxAllocationCount << "), " << m_SubAllocationCount << " live sub-allocations" << std::endl;
+	for (auto& pool : m_Pools)
+	{
+		vk::DeviceSize used = 0, capacity = 0, largestFree = 0;
+		for (auto& block : pool->Blocks)
+		{
+			used += block->Metadata->UsedBytes();
+			capacity += block->Metadata->Size();
+			largestFree = (std::max)(largestFree, block->Metadata->LargestFreeRange());
+		}
+		vk::DeviceSize free = capacity - used;
+		//0 = all free space in one range, close to 1 = free space scattered in small holes
+		double fragmentation = free > 0 ? 1.0 - static_cast<double>(largestFree) / static_cast<double>(free) : 0.0;
+		std::cout << "  type " << pool->MemoryType << (pool->Strategy == AllocationStrategy::Linear ? " linear" : " tlsf")
+				  << (pool->OptimalImages ? " images" : "") << ": " << pool->Blocks.size() << " blocks, "
+				  << used << "/" << capacity << " bytes used, fragmentation " << fragmentation << std::endl;
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "MemoryBlockMetadata.h"
+
+enum class AllocationStrategy
+{
+	//TLSF sub-allocation, ranges are recycled one by one
+	General,
+	//bump allocation for staging and other short-lived data, a block resets once all its ranges are freed
+	Linear
+};
+
+struct AllocationCreateInfo
+{
+	vk::MemoryPropertyFlags Properties;
+	AllocationStrategy Strategy = AllocationStrategy::General;
+};
+
+struct MemoryBlock;
+
+struct Allocation
+{
+	vk::DeviceMemory Memory;
+	vk::DeviceSize Offset = 0;
+	vk::DeviceSize Size = 0;
+	//host-visible blocks stay mapped for their whole life, this already points at Offset
+	void* Mapped = nullptr;
+
+	MemoryBlock* Block = nullptr;
+	uint32_t Handle = 0;
+};
+
+//hands out ranges of a few large VkDeviceMemory blocks per memory type instead of one allocation per resource
+class MemoryAllocator
+{
+public:
+	void Init(vk::PhysicalDevice physicalDevice, vk::Device device);
+	void Destroy();
+
+	Allocation AllocateForBuffer(vk::Buffer buffer, const AllocationCreateInfo& createInfo);
+	Allocation AllocateForImage(vk::Image image, vk::ImageTiling tiling, const AllocationCreateInfo& createInfo);
+	//memory not tied to one resource, e.g. a heap several aliased images get bound into
+	Allocation AllocateForRequirements(const vk::MemoryRequirements& requirements, bool optimalImages, const AllocationCreateInfo& createInfo);
+	void Free(Allocation& allocation);
+	uint32_t FindMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags flags) const;
+	void PrintStatistics();
+
+private:
+	friend struct MemoryBlock;
+	struct Pool
+	{
+		uint32_t MemoryType;
+		AllocationStrategy Strategy;
+		//optimal-tiling images get their own blocks so bufferImageGranularity never splits a page between them and buffers
+		bool OptimalImages;
+		vk::DeviceSize BlockSize;
+		std::vector<std::unique_ptr<MemoryBlock>> Blocks;
+	};
+
+	Allocation Allocate(const vk::MemoryRequirements& requirements, bool dedicated, bool optimalImage, vk::Buffer buffer, vk::Image image, const AllocationCreateInfo& createInfo);
+	Allocation AllocateDedicated(const vk::MemoryRequirements& requirements, uint32_t memoryType, vk::Buffer buffer, vk::Image image);
+	MemoryBlock* CreateBlock(Pool& pool);
+	Pool& GetPool(uint32_t memoryType, AllocationStrategy strategy, bool optimalImage);
+	void* MapIfHostVisible(vk::DeviceMemory memory, uint32_t memoryType);
+
+private:
+	vk::PhysicalDevice m_PhysicalDevice;
+	vk::Device m_Device;
+	vk::PhysicalDeviceMemoryProperties m_MemoryProperties;
+	vk::DeviceSize m_BufferImageGranularity = 1;
+	uint32_t m_MaxAllocationCount = 0;
+
+	std::mutex m_Mutex;
+	std::vector<std::unique_ptr<Pool>> m_Pools;
+	std::vector<std::unique_ptr<MemoryBlock>> m_DedicatedBlocks;
+	uint32_t m_DeviceAllocationCount = 0;
+	uint32_t m_DedicatedAllocationCount = 0;
+	uint32_t m_SubAllocationCount = 0;
+};
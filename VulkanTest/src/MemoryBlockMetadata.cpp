@@ -0,0 +1,306 @@
+#include "MemoryBlockMetadata.h"
+
+namespace
+{
+	//ranges smaller than this stay glued to the allocation instead of becoming a free node
+	const uint64_t MIN_SPLIT_SIZE = 64;
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	uint32_t FloorLog2(uint64_t value)
+	{
+		uint32_t log = 0;
+		while (value >>= 1)
+		{
+			log++;
+		}
+		return log;
+	}
+
+	uint32_t LowestBit(uint64_t value)
+	{
+		uint32_t bit = 0;
+		while (!(value & 1))
+		{
+			value >>= 1;
+			bit++;
+		}
+		return bit;
+	}
+
+	uint32_t HighestBit(uint64_t value)
+	{
+		return FloorLog2(value);
+	}
+}
+
+TlsfBlockMetadata::TlsfBlockMetadata(uint64_t size)
+	: BlockMetadata(size)
+{
+	for (auto& heads : m_FreeHeads)
+	{
+		for (auto& head : heads)
+		{
+			head = INVALID;
+		}
+	}
+	uint32_t node = NewNode();
+	m_Nodes[node].Offset = 0;
+	m_Nodes[node].Size = size;
+	InsertFree(node);
+}
+
+void TlsfBlockMetadata::Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+	if (size < (1ull << SMALL_BLOCK_LOG2))
+	{
+		firstLevel = 0;
+		secondLevel = static_cast<uint32_t>(size / ((1ull << SMALL_BLOCK_LOG2) / SECOND_LEVEL_COUNT));
+		return;
+	}
+	uint32_t log = FloorLog2(size);
+	firstLevel = log - SMALL_BLOCK_LOG2 + 1;
+	secondLevel = static_cast<uint32_t>(size >> (log - SECOND_LEVEL_LOG2)) ^ SECOND_LEVEL_COUNT;
+}
+
+uint32_t TlsfBlockMetadata::FindFree(uint64_t size) const
+{
+	//round up to the next size class so every node in the class found is big enough
+	if (size >= (1ull << SMALL_BLOCK_LOG2))
+	{
+		size += (1ull << (FloorLog2(size) - SECOND_LEVEL_LOG2)) - 1;
+	}
+	else
+	{
+		size += (1ull << SMALL_BLOCK_LOG2) / SECOND_LEVEL_COUNT - 1;
+	}
+	uint32_t firstLevel, secondLevel;
+	Mapping(size, firstLevel, secondLevel);
+	if (firstLevel >= FIRST_LEVEL_COUNT)
+	{
+		return INVALID;
+	}
+
+	uint32_t secondLevelMap = m_SecondLevelBitmap[firstLevel] & (~0u << secondLevel);
+	if (!secondLevelMap)
+	{
+		uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_FirstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+		if (!firstLevelMap)
+		{
+			return INVALID;
+		}
+		firstLevel = LowestBit(firstLevelMap);
+		secondLevelMap = m_SecondLevelBitmap[firstLevel];
+	}
+	secondLevel = LowestBit(secondLevelMap);
+	return m_FreeHeads[firstLevel][secondLevel];
+}
+
+void TlsfBlockMetadata::InsertFree(uint32_t node)
+{
+	uint32_t firstLevel, secondLevel;
+	Mapping(m_Nodes[node].Size, firstLevel, secondLevel);
+	uint32_t head = m_FreeHeads[firstLevel][secondLevel];
+	m_Nodes[node].Free = true;
+	m_Nodes[node].PrevFree = INVALID;
+	m_Nodes[node].NextFree = head;
+	if (head != INVALID)
+	{
+		m_Nodes[head].PrevFree = node;
+	}
+	m_FreeHeads[firstLevel][secondLevel] = node;
+	m_FirstLevelBitmap |= 1ull << firstLevel;
+	m_SecondLevelBitmap[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfBlockMetadata::RemoveFree(uint32_t node)
+{
+	uint32_t firstLevel, secondLevel;
+	Mapping(m_Nodes[node].Size, firstLevel, secondLevel);
+	Node& entry = m_Nodes[node];
+	if (entry.PrevFree != INVALID)
+	{
+		m_Nodes[entry.PrevFree].NextFree = entry.NextFree;
+	}
+	else
+	{
+		m_FreeHeads[firstLevel][secondLevel] = entry.NextFree;
+		if (entry.NextFree == INVALID)
+		{
+			m_SecondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+			if (!m_SecondLevelBitmap[firstLevel])
+			{
+				m_FirstLevelBitmap &= ~(1ull << firstLevel);
+			}
+		}
+	}
+	if (entry.NextFree != INVALID)
+	{
+		m_Nodes[entry.NextFree].PrevFree = entry.PrevFree;
+	}
+	entry.PrevFree = INVALID;
+	entry.NextFree = INVALID;
+	entry.Free = false;
+}
+
+uint32_t TlsfBlockMetadata::NewNode()
+{
+	if (!m_UnusedNodes.empty())
+	{
+		uint32_t node = m_UnusedNodes.back();
+		m_UnusedNodes.pop_back();
+		m_Nodes[node] = Node();
+		return node;
+	}
+	m_Nodes.emplace_back();
+	return static_cast<uint32_t>(m_Nodes.size() - 1);
+}
+
+void TlsfBlockMetadata::ReleaseNode(uint32_t node)
+{
+	m_UnusedNodes.push_back(node);
+}
+
+uint32_t TlsfBlockMetadata::SplitFront(uint32_t node, uint64_t size)
+{
+	uint32_t front = NewNode();
+	Node& back = m_Nodes[node];
+	Node& entry = m_Nodes[front];
+	entry.Offset = back.Offset;
+	entry.Size = size;
+	entry.PrevPhysical = back.PrevPhysical;
+	entry.NextPhysical = node;
+	if (back.PrevPhysical != INVALID)
+	{
+		m_Nodes[back.PrevPhysical].NextPhysical = front;
+	}
+	back.Offset += size;
+	back.Size -= size;
+	back.PrevPhysical = front;
+	return front;
+}
+
+bool TlsfBlockMetadata::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle)
+{
+	if (size == 0 || size > m_Size)
+	{
+		return false;
+	}
+
+	//the head of the size class usually satisfies the alignment already, only pay for the padding when it does not
+	uint32_t node = FindFree(size);
+	if (node != INVALID && AlignUp(m_Nodes[node].Offset, alignment) + size > m_Nodes[node].Offset + m_Nodes[node].Size)
+	{
+		node = INVALID;
+	}
+	if (node == INVALID && alignment > 1)
+	{
+		node = FindFree(size + alignment - 1);
+	}
+	if (node == INVALID)
+	{
+		return false;
+	}
+	RemoveFree(node);
+
+	uint64_t padding = AlignUp(m_Nodes[node].Offset, alignment) - m_Nodes[node].Offset;
+	if (padding > 0)
+	{
+		InsertFree(SplitFront(node, padding));
+	}
+	if (m_Nodes[node].Size - size >= MIN_SPLIT_SIZE)
+	{
+		uint32_t rest = node;
+		node = SplitFront(rest, size);
+		InsertFree(rest);
+	}
+
+	m_Nodes[node].Free = false;
+	m_Used += m_Nodes[node].Size;
+	offset = m_Nodes[node].Offset;
+	handle = node;
+	return true;
+}
+
+void TlsfBlockMetadata::Free(uint32_t handle)
+{
+	uint32_t node = handle;
+	m_Used -= m_Nodes[node].Size;
+
+	uint32_t next = m_Nodes[node].NextPhysical;
+	if (next != INVALID && m_Nodes[next].Free)
+	{
+		RemoveFree(next);
+		m_Nodes[node].Size += m_Nodes[next].Size;
+		m_Nodes[node].NextPhysical = m_Nodes[next].NextPhysical;
+		if (m_Nodes[next].NextPhysical != INVALID)
+		{
+			m_Nodes[m_Nodes[next].NextPhysical].PrevPhysical = node;
+		}
+		ReleaseNode(next);
+	}
+
+	uint32_t prev = m_Nodes[node].PrevPhysical;
+	if (prev != INVALID && m_Nodes[prev].Free)
+	{
+		RemoveFree(prev);
+		m_Nodes[prev].Size += m_Nodes[node].Size;
+		m_Nodes[prev].NextPhysical = m_Nodes[node].NextPhysical;
+		if (m_Nodes[node].NextPhysical != INVALID)
+		{
+			m_Nodes[m_Nodes[node].NextPhysical].PrevPhysical = prev;
+		}
+		ReleaseNode(node);
+		node = prev;
+	}
+	InsertFree(node);
+}
+
+uint64_t TlsfBlockMetadata::LargestFreeRange() const
+{
+	if (!m_FirstLevelBitmap)
+	{
+		return 0;
+	}
+	uint32_t firstLevel = HighestBit(m_FirstLevelBitmap);
+	uint32_t secondLevel = HighestBit(m_SecondLevelBitmap[firstLevel]);
+	uint64_t largest = 0;
+	for (uint32_t node = m_FreeHeads[firstLevel][secondLevel]; node != INVALID; node = m_Nodes[node].NextFree)
+	{
+		if (m_Nodes[node].Size > largest)
+		{
+			largest = m_Nodes[node].Size;
+		}
+	}
+	return largest;
+}
+
+bool LinearBlockMetadata::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle)
+{
+	uint64_t aligned = AlignUp(m_Cursor, alignment);
+	if (size == 0 || aligned + size > m_Size)
+	{
+		return false;
+	}
+	offset = aligned;
+	handle = static_cast<uint32_t>(m_Sizes.size());
+	m_Sizes.push_back(size);
+	m_Cursor = aligned + size;
+	m_Used += size;
+	m_LiveCount++;
+	return true;
+}
+
+void LinearBlockMetadata::Free(uint32_t handle)
+{
+	m_Used -= m_Sizes[handle];
+	m_LiveCount--;
+	if (m_LiveCount == 0)
+	{
+		m_Cursor = 0;
+		m_Sizes.clear();
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//bookkeeping of the byte ranges handed out from one VkDeviceMemory block, no Vulkan calls in here
+class BlockMetadata
+{
+public:
+	explicit BlockMetadata(uint64_t size) : m_Size(size) {}
+	virtual ~BlockMetadata() = default;
+
+	//offset receives the aligned start, handle whatever Free needs to give the range back
+	virtual bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle) = 0;
+	virtual void Free(uint32_t handle) = 0;
+	virtual bool IsEmpty() const = 0;
+	//size of the largest range a single Allocate could still return, used for fragmentation stats
+	virtual uint64_t LargestFreeRange() const = 0;
+
+	uint64_t Size() const { return m_Size; }
+	uint64_t UsedBytes() const { return m_Used; }
+protected:
+	uint64_t m_Size;
+	uint64_t m_Used = 0;
+};
+
+//two-level segregated fit: O(1) allocate and free with immediate coalescing, for long-lived resources
+class TlsfBlockMetadata : public BlockMetadata
+{
+public:
+	explicit TlsfBlockMetadata(uint64_t size);
+
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle) override;
+	void Free(uint32_t handle) override;
+	bool IsEmpty() const override { return m_Used == 0; }
+	uint64_t LargestFreeRange() const override;
+
+private:
+	static const uint32_t SECOND_LEVEL_LOG2 = 3;
+	static const uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_LOG2;
+	static const uint32_t SMALL_BLOCK_LOG2 = 8;
+	static const uint32_t FIRST_LEVEL_COUNT = 64 - SMALL_BLOCK_LOG2 + 1;
+	static const uint32_t INVALID = ~0u;
+
+	struct Node
+	{
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+		uint32_t PrevPhysical = INVALID;
+		uint32_t NextPhysical = INVALID;
+		uint32_t PrevFree = INVALID;
+		uint32_t NextFree = INVALID;
+		bool Free = false;
+	};
+
+	static void Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+	uint32_t FindFree(uint64_t size) const;
+	void InsertFree(uint32_t node);
+	void RemoveFree(uint32_t node);
+	uint32_t NewNode();
+	void ReleaseNode(uint32_t node);
+	//carve [offset, offset + size) off the front of node and return the new node holding the front part
+	uint32_t SplitFront(uint32_t node, uint64_t size);
+
+private:
+	std::vector<Node> m_Nodes;
+	std::vector<uint32_t> m_UnusedNodes;
+	uint64_t m_FirstLevelBitmap = 0;
+	uint32_t m_SecondLevelBitmap[FIRST_LEVEL_COUNT] = {};
+	uint32_t m_FreeHeads[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+};
+
+//bump allocator for transient data: ranges are only reclaimed once every one of them has been freed
+class LinearBlockMetadata : public BlockMetadata
+{
+public:
+	explicit LinearBlockMetadata(uint64_t size) : BlockMetadata(size) {}
+
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& handle) override;
+	void Free(uint32_t handle) override;
+	bool IsEmpty() const override { return m_LiveCount == 0; }
+	uint64_t LargestFreeRange() const override { return m_Size - m_Cursor; }
+
+private:
+	uint64_t m_Cursor = 0;
+	uint32_t m_LiveCount = 0;
+	std::vector<uint64_t> m_Sizes;
+};
@@ -0,0 +1,530 @@
+#include <iostream>
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "MeshLoader.h"
+#include "../utils/readFile.h"
+
+namespace
+{
+	//below this a chunk costs more in merging than it saves in parsing
+	const size_t MIN_CHUNK_BYTES = 1 << 20;
+	const uint32_t NO_INDEX = ~0u;
+	const int POSITION = 0;
+	const int TEXCOORD = 1;
+	const int NORMAL = 2;
+
+	//a face corner as written in the file: 0-based, relative ones still counted from the chunk's own attributes
+	struct RawCorner
+	{
+		int64_t Index[3];
+		uint8_t Present = 0;
+		uint8_t Relative = 0;
+	};
+
+	//a resolved corner, one unique key becomes one vertex
+	struct CornerKey
+	{
+		uint32_t Index[3];
+		bool operator==(const CornerKey& other) const
+		{
+			return Index[0] == other.Index[0] && Index[1] == other.Index[1] && Index[2] == other.Index[2];
+		}
+	};
+
+	uint64_t HashCorner(const CornerKey& key)
+	{
+		uint64_t hash = key.Index[0] * 0x9E3779B97F4A7C15ull;
+		hash ^= (key.Index[1] + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+		hash ^= (key.Index[2] + 0x165667B19E3779F9ull) * 0x94D049BB133111EBull;
+		return hash ^ (hash >> 31);
+	}
+
+	//open addressing with linear probing, keys are only ever inserted. the value of a key is its insertion order
+	class CornerTable
+	{
+	public:
+		explicit CornerTable(size_t expected)
+		{
+			size_t capacity = 16;
+			while (capacity < expected * 2)
+			{
+				capacity *= 2;
+			}
+			m_Slots.assign(capacity, NO_INDEX);
+			m_Keys.reserve(expected);
+		}
+
+		uint32_t Insert(const CornerKey& key)
+		{
+			if ((m_Keys.size() + 1) * 2 > m_Slots.size())
+			{
+				Grow();
+			}
+			size_t mask = m_Slots.size() - 1;
+			for (size_t slot = HashCorner(key) & mask;; slot = (slot + 1) & mask)
+			{
+				if (m_Slots[slot] == NO_INDEX)
+				{
+					m_Slots[slot] = static_cast<uint32_t>(m_Keys.size());
+					m_Keys.push_back(key);
+					return m_Slots[slot];
+				}
+				if (m_Keys[m_Slots[slot]] == key)
+				{
+					return m_Slots[slot];
+				}
+			}
+		}
+
+		std::vector<CornerKey>& GetKeys() { return m_Keys; }
+
+	private:
+		void Grow()
+		{
+			std::vector<uint32_t> slots(m_Slots.size() * 2, NO_INDEX);
+			size_t mask = slots.size() - 1;
+			for (uint32_t value = 0; value < m_Keys.size(); value++)
+			{
+				size_t slot = HashCorner(m_Keys[value]) & mask;
+				while (slots[slot] != NO_INDEX)
+				{
+					slot = (slot + 1) & mask;
+				}
+				slots[slot] = value;
+			}
+			m_Slots.swap(slots);
+		}
+
+		std::vector<uint32_t> m_Slots;
+		std::vector<CornerKey> m_Keys;
+	};
+
+	struct Chunk
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+		std::vector<glm::vec3> Positions;
+		std::vector<glm::vec2> TexCoords;
+		std::vector<glm::vec3> Normals;
+		//three per triangle, polygons are fanned while parsing
+		std::vector<RawCorner> Corners;
+
+		size_t AttributeOffset[3] = {};
+		size_t CornerOffset = 0;
+		//chunk-local deduplication: corner -> local vertex, local vertex -> global vertex
+		std::vector<CornerKey> Unique;
+		std::vector<uint32_t> LocalIndices;
+		std::vector<uint32_t> Remap;
+	};
+
+	template<typename Function>
+	void RunParallel(ThreadPool& pool, size_t count, const Function& function)
+	{
+		std::vector<std::future<void>> pending;
+		pending.reserve(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			pending.push_back(pool.Submit([&function, i] { function(i); }));
+		}
+		//every task has to finish before rethrowing, the others still use function and what it captured
+		std::exception_ptr error;
+		for (auto& future : pending)
+		{
+			try
+			{
+				future.get();
+			}
+			catch (...)
+			{
+				error = error ? error : std::current_exception();
+			}
+		}
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		p = SkipSpaces(p, end);
+		if (p < end && *p == '+')
+		{
+			p++;
+		}
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+		{
+			throw std::runtime_error("obj: malformed number!");
+		}
+		return result.ptr;
+	}
+
+	//leaves value alone when the line ends before it
+	const char* ParseOptionalFloat(const char* p, const char* end, float& value)
+	{
+		p = SkipSpaces(p, end);
+		if (p >= end || *p == '\r' || *p == '#')
+		{
+			return p;
+		}
+		return ParseFloat(p, end, value);
+	}
+
+	//p, p/t, p//n or p/t/n
+	const char* ParseCorner(const char* p, const char* end, const size_t counts[3], RawCorner& corner)
+	{
+		for (int attribute = 0; attribute < 3; attribute++)
+		{
+			if (attribute > 0)
+			{
+				if (p >= end || *p != '/')
+				{
+					break;
+				}
+				p++;
+			}
+			if (p >= end || !(*p == '-' || (*p >= '0' && *p <= '9')))
+			{
+				continue;
+			}
+			int64_t value = 0;
+			auto result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || value == 0)
+			{
+				throw std::runtime_error("obj: malformed face index!");
+			}
+			p = result.ptr;
+			corner.Present |= 1 << attribute;
+			if (value > 0)
+			{
+				corner.Index[attribute] = value - 1;
+			}
+			else
+			{
+				corner.Index[attribute] = static_cast<int64_t>(counts[attribute]) + value;
+				corner.Relative |= 1 << attribute;
+			}
+		}
+		return p;
+	}
+
+	void ParseChunk(Chunk& chunk)
+	{
+		std::vector<RawCorner> polygon;
+		const char* p = chunk.Begin;
+		while (p < chunk.End)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.End - p));
+			lineEnd = lineEnd ? lineEnd : chunk.End;
+			p = SkipSpaces(p, lineEnd);
+			size_t length = lineEnd - p;
+
+			if (length >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				glm::vec3 position;
+				p = ParseFloat(p + 1, lineEnd, position.x);
+				p = ParseFloat(p, lineEnd, position.y);
+				ParseFloat(p, lineEnd, position.z);
+				chunk.Positions.push_back(position);
+			}
+			else if (length >= 3 && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+			{
+				//v is optional and defaults to 0
+				glm::vec2 coord(0.0f);
+				p = ParseFloat(p + 2, lineEnd, coord.x);
+				ParseOptionalFloat(p, lineEnd, coord.y);
+				//obj puts v = 0 at the bottom, vulkan samples with v = 0 at the top
+				coord.y = 1.0f - coord.y;
+				chunk.TexCoords.push_back(coord);
+			}
+			else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+			{
+				glm::vec3 normal;
+				p = ParseFloat(p + 2, lineEnd, normal.x);
+				p = ParseFloat(p, lineEnd, normal.y);
+				ParseFloat(p, lineEnd, normal.z);
+				chunk.Normals.push_back(normal);
+			}
+			else if (length >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				size_t counts[3] = { chunk.Positions.size(), chunk.TexCoords.size(), chunk.Normals.size() };
+				polygon.clear();
+				p++;
+				while (true)
+				{
+					p = SkipSpaces(p, lineEnd);
+					if (p >= lineEnd || *p == '\r' || *p == '#')
+					{
+						break;
+					}
+					RawCorner corner;
+					const char* next = ParseCorner(p, lineEnd, counts, corner);
+					if (next == p || !(corner.Present & (1 << POSITION)))
+					{
+						throw std::runtime_error("obj: malformed face!");
+					}
+					polygon.push_back(corner);
+					p = next;
+				}
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					chunk.Corners.push_back(polygon[0]);
+					chunk.Corners.push_back(polygon[i - 1]);
+					chunk.Corners.push_back(polygon[i]);
+				}
+			}
+			//groups, objects, materials and smoothing groups all end up in the one mesh
+			p = lineEnd + 1;
+		}
+	}
+
+	//area-weighted, only for vertices the file gave no normal
+	void GenerateNormals(MeshData& mesh, const std::vector<bool>& missing)
+	{
+		for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+		{
+			MeshVertex& a = mesh.Vertices[mesh.Indices[i]];
+			MeshVertex& b = mesh.Vertices[mesh.Indices[i + 1]];
+			MeshVertex& c = mesh.Vertices[mesh.Indices[i + 2]];
+			glm::vec3 normal = glm::cross(b.Position - a.Position, c.Position - a.Position);
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				if (missing[mesh.Indices[i + corner]])
+				{
+					mesh.Vertices[mesh.Indices[i + corner]].Normal += normal;
+				}
+			}
+		}
+		for (size_t i = 0; i < mesh.Vertices.size(); i++)
+		{
+			float length = glm::length(mesh.Vertices[i].Normal);
+			if (missing[i] && length > 0.0f)
+			{
+				mesh.Vertices[i].Normal /= length;
+			}
+		}
+	}
+}
+
+void MeshData::WriteIndices(void* destination) const
+{
+	if (IndexType == MeshIndexType::UInt32)
+	{
+		memcpy(destination, Indices.data(), Indices.size() * sizeof(uint32_t));
+		return;
+	}
+	uint16_t* narrow = static_cast<uint16_t*>(destination);
+	for (size_t i = 0; i < Indices.size(); i++)
+	{
+		narrow[i] = static_cast<uint16_t>(Indices[i]);
+	}
+}
+
+glm::vec4 MeshData::ComputeBounds(glm::vec3& boxMin, glm::vec3& boxMax) const
+{
+	if (Vertices.empty())
+	{
+		boxMin = boxMax = glm::vec3(0.0f);
+		return glm::vec4(0.0f);
+	}
+	boxMin = Vertices[0].Position;
+	boxMax = boxMin;
+	for (const MeshVertex& vertex : Vertices)
+	{
+		boxMin = glm::min(boxMin, vertex.Position);
+		boxMax = glm::max(boxMax, vertex.Position);
+	}
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	float radius = 0.0f;
+	for (const MeshVertex& vertex : Vertices)
+	{
+		radius = (std::max)(radius, glm::length(vertex.Position - center));
+	}
+	return glm::vec4(center, radius);
+}
+
+MeshLoader::MeshLoader(uint32_t threadCount)
+{
+	m_Workers = std::make_unique<ThreadPool>(threadCount);
+}
+
+MeshIndexType MeshLoader::ChooseIndexType(size_t vertexCount)
+{
+	//0xffff stays free for primitive restart
+	return vertexCount <= 0xffff ? MeshIndexType::UInt16 : MeshIndexType::UInt32;
+}
+
+MeshData MeshLoader::LoadObj(const std::string& path)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::vector<char> file = ReadFile(path);
+	MeshData mesh = ParseObj(file.data(), file.data() + file.size());
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "mesh: " << path << ", " << mesh.Vertices.size() << " vertices, " << mesh.Indices.size() / 3 << " triangles, "
+			  << mesh.GetIndexSize() * 8 << "-bit indices, " << file.size() << " bytes in " << milliseconds << "ms" << std::endl;
+	return mesh;
+}
+
+MeshData MeshLoader::ParseObj(const char* begin, const char* end)
+{
+	size_t size = end - begin;
+	size_t chunkCount = std::clamp<size_t>(size / MIN_CHUNK_BYTES, 1, m_Workers->Size() * 4);
+	std::vector<Chunk> chunks(chunkCount);
+	const char* cursor = begin;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].Begin = cursor;
+		if (i + 1 == chunkCount)
+		{
+			chunks[i].End = end;
+		}
+		else
+		{
+			//every chunk ends right after a newline so no line is split
+			const char* target = (std::max)(cursor, begin + size * (i + 1) / chunkCount);
+			const char* newline = static_cast<const char*>(memchr(target, '\n', end - target));
+			chunks[i].End = newline ? newline + 1 : end;
+		}
+		cursor = chunks[i].End;
+	}
+	RunParallel(*m_Workers, chunkCount, [&chunks](size_t i) { ParseChunk(chunks[i]); });
+
+	//prefix sums turn chunk-local counts into global offsets
+	size_t totals[3] = {};
+	size_t cornerCount = 0;
+	for (auto& chunk : chunks)
+	{
+		std::copy(totals, totals + 3, chunk.AttributeOffset);
+		totals[POSITION] += chunk.Positions.size();
+		totals[TEXCOORD] += chunk.TexCoords.size();
+		totals[NORMAL] += chunk.Normals.size();
+		chunk.CornerOffset = cornerCount;
+		cornerCount += chunk.Corners.size();
+	}
+	if (cornerCount > NO_INDEX)
+	{
+		throw std::runtime_error("obj: too many triangles!");
+	}
+
+	RunParallel(*m_Workers, chunkCount, [&chunks, &totals](size_t i)
+	{
+		Chunk& chunk = chunks[i];
+		CornerTable table(chunk.Corners.size() / 4);
+		chunk.LocalIndices.resize(chunk.Corners.size());
+		for (size_t corner = 0; corner < chunk.Corners.size(); corner++)
+		{
+			const RawCorner& raw = chunk.Corners[corner];
+			CornerKey key;
+			for (int attribute = 0; attribute < 3; attribute++)
+			{
+				key.Index[attribute] = NO_INDEX;
+				if (!(raw.Present & (1 << attribute)))
+				{
+					continue;
+				}
+				int64_t index = raw.Index[attribute] + ((raw.Relative & (1 << attribute)) ? static_cast<int64_t>(chunk.AttributeOffset[attribute]) : 0);
+				if (index < 0 || index >= static_cast<int64_t>(totals[attribute]))
+				{
+					throw std::runtime_error("obj: face index out of range!");
+				}
+				key.Index[attribute] = static_cast<uint32_t>(index);
+			}
+			chunk.LocalIndices[corner] = table.Insert(key);
+		}
+		chunk.Unique.swap(table.GetKeys());
+		std::vector<RawCorner>().swap(chunk.Corners);
+	});
+
+	//merging only touches each chunk's unique corners, a small fraction of all corners
+	size_t localVertexCount = 0;
+	for (auto& chunk : chunks)
+	{
+		localVertexCount += chunk.Unique.size();
+	}
+	CornerTable vertices(localVertexCount);
+	for (auto& chunk : chunks)
+	{
+		chunk.Remap.resize(chunk.Unique.size());
+		for (size_t i = 0; i < chunk.Unique.size(); i++)
+		{
+			chunk.Remap[i] = vertices.Insert(chunk.Unique[i]);
+		}
+		std::vector<CornerKey>().swap(chunk.Unique);
+	}
+	const std::vector<CornerKey>& keys = vertices.GetKeys();
+
+	//attributes stay in the chunks they were parsed into, a vertex finds its chunk by offset
+	auto findChunk = [&chunks](int attribute, uint32_t index) -> const Chunk&
+	{
+		auto it = std::upper_bound(chunks.begin(), chunks.end(), index,
+			[attribute](uint32_t value, const Chunk& chunk) { return value < chunk.AttributeOffset[attribute]; });
+		return *(it - 1);
+	};
+
+	MeshData mesh;
+	mesh.Vertices.resize(keys.size());
+	mesh.Indices.resize(cornerCount);
+	std::vector<bool> missingNormals(keys.size(), false);
+	bool anyMissingNormal = false;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		if (keys[i].Index[NORMAL] == NO_INDEX)
+		{
+			missingNormals[i] = true;
+			anyMissingNormal = true;
+		}
+	}
+
+	RunParallel(*m_Workers, chunkCount, [&](size_t range)
+	{
+		size_t first = keys.size() * range / chunkCount;
+		size_t last = keys.size() * (range + 1) / chunkCount;
+		for (size_t i = first; i < last; i++)
+		{
+			const CornerKey& key = keys[i];
+			MeshVertex& vertex = mesh.Vertices[i];
+			const Chunk& positions = findChunk(POSITION, key.Index[POSITION]);
+			vertex.Position = positions.Positions[key.Index[POSITION] - positions.AttributeOffset[POSITION]];
+			vertex.TexCoord = glm::vec2(0.0f);
+			vertex.Normal = glm::vec3(0.0f);
+			if (key.Index[TEXCOORD] != NO_INDEX)
+			{
+				const Chunk& coords = findChunk(TEXCOORD, key.Index[TEXCOORD]);
+				vertex.TexCoord = coords.TexCoords[key.Index[TEXCOORD] - coords.AttributeOffset[TEXCOORD]];
+			}
+			if (key.Index[NORMAL] != NO_INDEX)
+			{
+				const Chunk& normals = findChunk(NORMAL, key.Index[NORMAL]);
+				vertex.Normal = normals.Normals[key.Index[NORMAL] - normals.AttributeOffset[NORMAL]];
+			}
+		}
+
+		const Chunk& chunk = chunks[range];
+		for (size_t corner = 0; corner < chunk.LocalIndices.size(); corner++)
+		{
+			mesh.Indices[chunk.CornerOffset + corner] = chunk.Remap[chunk.LocalIndices[corner]];
+		}
+	});
+
+	if (anyMissingNormal)
+	{
+		GenerateNormals(mesh, missingNormals);
+	}
+	mesh.IndexType = ChooseIndexType(mesh.Vertices.size());
+	return mesh;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include "../utils/ThreadPool.h"
+
+struct MeshVertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec2 TexCoord;
+};
+
+enum class MeshIndexType
+{
+	UInt16,
+	UInt32
+};
+
+struct MeshData
+{
+	std::vector<MeshVertex> Vertices;
+	//kept 32-bit on the CPU, IndexType is the width they go to the GPU with
+	std::vector<uint32_t> Indices;
+	MeshIndexType IndexType = MeshIndexType::UInt32;
+
+	uint32_t GetIndexSize() const { return IndexType == MeshIndexType::UInt16 ? 2 : 4; }
+	//narrows to IndexType while writing, meant to fill mapped staging memory directly
+	void WriteIndices(void* destination) const;
+	//returns the bounding sphere (xyz centre, w radius) around the box centre, not minimal but never far off
+	glm::vec4 ComputeBounds(glm::vec3& boxMin, glm::vec3& boxMax) const;
+};
+
+//OBJ import. the file is split into line-aligned chunks parsed on a thread pool, face corners are deduplicated into
+//unique vertices by their (position, texcoord, normal) triple and 16-bit indices are used whenever the vertex count allows
+class MeshLoader
+{
+public:
+	explicit MeshLoader(uint32_t threadCount = ThreadPool::DefaultThreadCount());
+
+	MeshData LoadObj(const std::string& path);
+	MeshData ParseObj(const char* begin, const char* end);
+
+	static MeshIndexType ChooseIndexType(size_t vertexCount);
+
+private:
+	std::unique_ptr<ThreadPool> m_Workers;
+};
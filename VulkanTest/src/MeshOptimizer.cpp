@@ -0,0 +1,326 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+
+#include "MeshOptimizer.h"
+
+namespace
+{
+	//for every vertex the triangles using it, as offsets into one flat array
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Counts;
+		std::vector<uint32_t> Triangles;
+
+		TriangleAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			Offsets.assign(vertexCount + 1, 0);
+			Counts.assign(vertexCount, 0);
+			for (uint32_t index : indices)
+			{
+				Counts[index]++;
+			}
+			for (size_t vertex = 0; vertex < vertexCount; vertex++)
+			{
+				Offsets[vertex + 1] = Offsets[vertex] + Counts[vertex];
+			}
+			Triangles.resize(indices.size());
+			std::vector<uint32_t> cursor(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				Triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+	};
+
+	//FIFO cache simulation by timestamps: a vertex is cached while it was inserted less than cacheSize misses ago
+	class CacheSimulator
+	{
+	public:
+		CacheSimulator(size_t vertexCount, uint32_t cacheSize) : m_Timestamps(vertexCount, 0), m_CacheSize(cacheSize), m_Time(cacheSize + 1) {}
+
+		bool Access(uint32_t vertex)
+		{
+			if (m_Time - m_Timestamps[vertex] > m_CacheSize)
+			{
+				m_Timestamps[vertex] = m_Time++;
+				return true;
+			}
+			return false;
+		}
+
+		void Flush() { m_Time += m_CacheSize + 1; }
+
+	private:
+		std::vector<uint32_t> m_Timestamps;
+		uint32_t m_CacheSize;
+		uint32_t m_Time;
+	};
+
+	uint32_t SimulateMisses(const std::vector<uint32_t>& indices, size_t first, size_t last, CacheSimulator& cache)
+	{
+		uint32_t misses = 0;
+		for (size_t i = first; i < last; i++)
+		{
+			misses += cache.Access(indices[i]) ? 1 : 0;
+		}
+		return misses;
+	}
+
+	void PrintStatistics(const char* stage, const VertexCacheStatistics& statistics)
+	{
+		std::cout << "  " << stage << ": ACMR " << statistics.ACMR << ", ATVR " << statistics.ATVR << std::endl;
+	}
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics statistics;
+	std::vector<bool> referenced(vertexCount, false);
+	size_t referencedCount = 0;
+	for (uint32_t index : indices)
+	{
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			referencedCount++;
+		}
+	}
+
+	CacheSimulator cache(vertexCount, cacheSize);
+	statistics.Misses = SimulateMisses(indices, 0, indices.size(), cache);
+	if (!indices.empty())
+	{
+		statistics.ACMR = static_cast<float>(statistics.Misses) / static_cast<float>(indices.size() / 3);
+		statistics.ATVR = static_cast<float>(statistics.Misses) / static_cast<float>(referencedCount);
+	}
+	return statistics;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+	TriangleAdjacency adjacency(indices, vertexCount);
+	//triangles not emitted yet per vertex
+	std::vector<uint32_t> liveCount = adjacency.Counts;
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+	int64_t fanning = 0;
+	while (fanning >= 0)
+	{
+		uint32_t vertex = static_cast<uint32_t>(fanning);
+		candidates.clear();
+		for (uint32_t i = adjacency.Offsets[vertex]; i < adjacency.Offsets[vertex + 1]; i++)
+		{
+			uint32_t triangle = adjacency.Triangles[i];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+			emitted[triangle] = true;
+			for (size_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t index = indices[triangle * 3 + corner];
+				result.push_back(index);
+				deadEnd.push_back(index);
+				candidates.push_back(index);
+				liveCount[index]--;
+				if (time - timestamps[index] > cacheSize)
+				{
+					timestamps[index] = time++;
+				}
+			}
+		}
+
+		//next fanning vertex: the one-ring vertex that will still be cached after its remaining triangles, oldest first
+		fanning = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t candidate : candidates)
+		{
+			if (liveCount[candidate] == 0)
+			{
+				continue;
+			}
+			int64_t priority = 0;
+			if (time - timestamps[candidate] + 2 * liveCount[candidate] <= cacheSize)
+			{
+				priority = time - timestamps[candidate];
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanning = candidate;
+			}
+		}
+		if (fanning >= 0)
+		{
+			continue;
+		}
+
+		//dead end: back to recently touched vertices, then on through the input order
+		while (!deadEnd.empty() && fanning < 0)
+		{
+			uint32_t candidate = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveCount[candidate] > 0)
+			{
+				fanning = candidate;
+			}
+		}
+		while (cursor < vertexCount && fanning < 0)
+		{
+			if (liveCount[cursor] > 0)
+			{
+				fanning = static_cast<int64_t>(cursor);
+			}
+			cursor++;
+		}
+	}
+	indices.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, uint32_t cacheSize, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	//hard boundaries: triangles where the cache order already restarts, cutting there costs nothing
+	std::vector<size_t> hard;
+	{
+		CacheSimulator cache(vertices.size(), cacheSize);
+		for (size_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			if (SimulateMisses(indices, triangle * 3, triangle * 3 + 3, cache) == 3 || triangle == 0)
+			{
+				hard.push_back(triangle);
+			}
+		}
+		hard.push_back(triangleCount);
+	}
+
+	//soft boundaries: cut a hard cluster further wherever the part so far is no worse than threshold times the whole
+	std::vector<size_t> clusters;
+	CacheSimulator cache(vertices.size(), cacheSize);
+	for (size_t cluster = 0; cluster + 1 < hard.size(); cluster++)
+	{
+		size_t first = hard[cluster];
+		size_t last = hard[cluster + 1];
+		cache.Flush();
+		float clusterACMR = static_cast<float>(SimulateMisses(indices, first * 3, last * 3, cache)) / static_cast<float>(last - first);
+
+		cache.Flush();
+		size_t start = first;
+		uint32_t misses = 0;
+		clusters.push_back(first);
+		for (size_t triangle = first; triangle < last; triangle++)
+		{
+			misses += SimulateMisses(indices, triangle * 3, triangle * 3 + 3, cache);
+			if (triangle + 1 < last && static_cast<float>(misses) / static_cast<float>(triangle - start + 1) <= threshold * clusterACMR)
+			{
+				start = triangle + 1;
+				misses = 0;
+				cache.Flush();
+				clusters.push_back(start);
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	//sort key: how far a cluster faces away from the mesh centre, the ones facing out occlude the rest
+	glm::vec3 meshCentroid(0.0f);
+	for (uint32_t index : indices)
+	{
+		meshCentroid += vertices[index].Position;
+	}
+	meshCentroid /= static_cast<float>(indices.size());
+
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t cluster = 0; cluster < clusterCount; cluster++)
+	{
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (size_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+		{
+			const glm::vec3& a = vertices[indices[triangle * 3]].Position;
+			const glm::vec3& b = vertices[indices[triangle * 3 + 1]].Position;
+			const glm::vec3& c = vertices[indices[triangle * 3 + 2]].Position;
+			glm::vec3 cross = glm::cross(b - a, c - a);
+			float triangleArea = glm::length(cross);
+			centroid += (a + b + c) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		centroid = area > 0.0f ? centroid / area : centroid;
+		float normalLength = glm::length(normal);
+		normal = normalLength > 0.0f ? normal / normalLength : normal;
+		sortKeys[cluster] = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::vector<size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (size_t cluster : order)
+	{
+		result.insert(result.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+	}
+	indices.swap(result);
+}
+
+void OptimizeVertexFetch(MeshData& mesh)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.Vertices.size(), unused);
+	std::vector<MeshVertex> vertices;
+	vertices.reserve(mesh.Vertices.size());
+	for (uint32_t& index : mesh.Indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.Vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.Vertices.swap(vertices);
+}
+
+void OptimizeMesh(MeshData& mesh, uint32_t cacheSize)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::cout << "mesh optimizer, " << cacheSize << "-entry cache:" << std::endl;
+	PrintStatistics("imported", AnalyzeVertexCache(mesh.Indices, mesh.Vertices.size(), cacheSize));
+
+	OptimizeVertexCache(mesh.Indices, mesh.Vertices.size(), cacheSize);
+	PrintStatistics("vertex cache", AnalyzeVertexCache(mesh.Indices, mesh.Vertices.size(), cacheSize));
+
+	OptimizeOverdraw(mesh.Indices, mesh.Vertices, cacheSize);
+	PrintStatistics("overdraw", AnalyzeVertexCache(mesh.Indices, mesh.Vertices.size(), cacheSize));
+
+	//only renames vertices, the cache statistics stay the same
+	OptimizeVertexFetch(mesh);
+	mesh.IndexType = MeshLoader::ChooseIndexType(mesh.Vertices.size());
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "  " << mesh.Vertices.size() << " vertices after fetch reordering, " << milliseconds << "ms" << std::endl;
+}
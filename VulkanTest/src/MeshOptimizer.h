@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MeshLoader.h"
+
+//what the post-transform cache does with an index stream, simulated as a FIFO of cacheSize vertices
+struct VertexCacheStatistics
+{
+	uint32_t Misses = 0;
+	//misses per triangle: 3 is the worst case, 0.5 about the best a closed mesh can do
+	float ACMR = 0.0f;
+	//misses per referenced vertex: 1 means every vertex is shaded exactly once
+	float ATVR = 0.0f;
+};
+
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+//Tipsify (Sander et al. 2007): reorders triangles so vertices are reused while still in the post-transform cache
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+//splits cache-optimized triangles into clusters and draws the outward-facing ones first, so fewer fragments are
+//shaded only to be hidden later. a cluster is only cut where that costs at most threshold times its ACMR
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices, uint32_t cacheSize = 16, float threshold = 1.05f);
+//renumbers vertices in order of first use so the vertex fetch reads memory front to back, drops unreferenced vertices
+void OptimizeVertexFetch(MeshData& mesh);
+
+//all three passes in order, prints the cache statistics before and after
+void OptimizeMesh(MeshData& mesh, uint32_t cacheSize = 16);
@@ -0,0 +1,701 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	//position, normal, texcoord
+	const int QUADRIC_SIZE = 8;
+	//attributes against positions normalized to the mesh's radius
+	const float NORMAL_WEIGHT = 0.5f;
+	const float TEXCOORD_WEIGHT = 0.5f;
+	//open borders are held by planes through them perpendicular to their triangle, weighted this much more
+	const float BORDER_WEIGHT = 10.0f;
+	//a pass only tries the cheapest part of its candidates, so collapses happen in roughly ascending error
+	const float PASS_FRACTION = 0.35f;
+	//a collapse may not turn a remaining triangle by more than about 75 degrees
+	const float MIN_NORMAL_DOT = 0.25f;
+
+	const uint32_t NO_WEDGE = ~0u;
+
+	//sum of area weighted squared distances to hyperplanes, evaluated as p'Ap + 2b'p + c and divided by the weight.
+	//double: c and the other terms nearly cancel for points close to the planes, floats lose errors below ~1e-3.
+	//only the first SIZE components of a point are used, so Quadric<3> over the same points only sees positions
+	template<int SIZE>
+	struct Quadric
+	{
+		//upper triangle of the symmetric A, row by row
+		double A[SIZE * (SIZE + 1) / 2] = {};
+		double B[SIZE] = {};
+		double C = 0.0;
+		double Weight = 0.0;
+
+		void Add(const Quadric& other)
+		{
+			for (int i = 0; i < SIZE * (SIZE + 1) / 2; i++)
+			{
+				A[i] += other.A[i];
+			}
+			for (int i = 0; i < SIZE; i++)
+			{
+				B[i] += other.B[i];
+			}
+			C += other.C;
+			Weight += other.Weight;
+		}
+
+		double Evaluate(const float* p) const
+		{
+			double sum = C;
+			int k = 0;
+			for (int i = 0; i < SIZE; i++)
+			{
+				sum += A[k++] * p[i] * p[i];
+				for (int j = i + 1; j < SIZE; j++)
+				{
+					sum += 2.0 * A[k++] * p[i] * p[j];
+				}
+				sum += 2.0 * B[i] * p[i];
+			}
+			return sum;
+		}
+
+		//the plane of a triangle in the full attribute space: an orthonormal basis e1, e2 of the plane gives
+		//A = I - e1e1' - e2e2', b = (p1.e1)e1 + (p1.e2)e2 - p1, c = p1.p1 - (p1.e1)^2 - (p1.e2)^2
+		static Quadric FromTriangle(const float* p1, const float* p2, const float* p3, float weight)
+		{
+			Quadric quadric;
+			double e1[SIZE];
+			double e2[SIZE];
+			double length1 = 0.0;
+			for (int i = 0; i < SIZE; i++)
+			{
+				e1[i] = p2[i] - p1[i];
+				length1 += e1[i] * e1[i];
+			}
+			if (length1 <= 1e-12)
+			{
+				return quadric;
+			}
+			length1 = std::sqrt(length1);
+			double along = 0.0;
+			for (int i = 0; i < SIZE; i++)
+			{
+				e1[i] /= length1;
+				along += e1[i] * (p3[i] - p1[i]);
+			}
+			double length2 = 0.0;
+			for (int i = 0; i < SIZE; i++)
+			{
+				e2[i] = p3[i] - p1[i] - along * e1[i];
+				length2 += e2[i] * e2[i];
+			}
+			if (length2 <= 1e-12)
+			{
+				return quadric;
+			}
+			length2 = std::sqrt(length2);
+			double p1e1 = 0.0;
+			double p1e2 = 0.0;
+			double p1p1 = 0.0;
+			for (int i = 0; i < SIZE; i++)
+			{
+				e2[i] /= length2;
+				p1e1 += p1[i] * e1[i];
+				p1e2 += p1[i] * e2[i];
+				p1p1 += p1[i] * p1[i];
+			}
+			int k = 0;
+			for (int i = 0; i < SIZE; i++)
+			{
+				for (int j = i; j < SIZE; j++)
+				{
+					quadric.A[k++] = weight * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+				}
+				quadric.B[i] = weight * (p1e1 * e1[i] + p1e2 * e2[i] - p1[i]);
+			}
+			quadric.C = weight * (p1p1 - p1e1 * p1e1 - p1e2 * p1e2);
+			quadric.Weight = weight;
+			return quadric;
+		}
+
+		//a plane through the position part only, attributes are free
+		static Quadric FromPlane(const glm::vec3& normal, float distance, float weight)
+		{
+			Quadric quadric;
+			int k = 0;
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = i; j < SIZE; j++)
+				{
+					quadric.A[k++] = j < 3 ? weight * normal[i] * normal[j] : 0.0;
+				}
+				quadric.B[i] = weight * distance * normal[i];
+			}
+			quadric.C = weight * distance * distance;
+			quadric.Weight = weight;
+			return quadric;
+		}
+	};
+
+	//ranks collapses, attributes included
+	using AttributeQuadric = Quadric<QUADRIC_SIZE>;
+	//measures them, a distance in the mesh's units once scaled back
+	using PositionQuadric = Quadric<3>;
+
+	//exact positions, with -0 and 0 hashed alike
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& position) const
+		{
+			uint32_t bits[3];
+			glm::vec3 canonical = position + glm::vec3(0.0f);
+			std::memcpy(bits, &canonical, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t From;
+		uint32_t To;
+		//triangles sharing the edge, they disappear with it
+		uint32_t EdgeTriangles;
+		float Error;
+	};
+
+	//vertices sharing a position but not attributes (wedges) move together, so seams never crack open. a wedge of the
+	//collapsing position moves to the wedge of the target it shares a triangle with, or failing that the one with the
+	//closest attributes
+	class Simplifier
+	{
+	public:
+		explicit Simplifier(const MeshData& mesh) : m_Indices(mesh.Indices)
+		{
+			size_t vertexCount = mesh.Vertices.size();
+			glm::vec3 boxMin, boxMax;
+			glm::vec4 bounds = mesh.ComputeBounds(boxMin, boxMax);
+			m_Scale = (std::max)(bounds.w, 1e-6f);
+
+			m_Points.resize(vertexCount * QUADRIC_SIZE);
+			m_Position.resize(vertexCount);
+			m_NextWedge.resize(vertexCount);
+			std::unordered_map<glm::vec3, uint32_t, PositionHash> firstByPosition;
+			firstByPosition.reserve(vertexCount);
+			for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+			{
+				const MeshVertex& source = mesh.Vertices[vertex];
+				glm::vec3 position = (source.Position - glm::vec3(bounds)) / m_Scale;
+				float* point = &m_Points[vertex * QUADRIC_SIZE];
+				point[0] = position.x;
+				point[1] = position.y;
+				point[2] = position.z;
+				point[3] = source.Normal.x * NORMAL_WEIGHT;
+				point[4] = source.Normal.y * NORMAL_WEIGHT;
+				point[5] = source.Normal.z * NORMAL_WEIGHT;
+				point[6] = source.TexCoord.x * TEXCOORD_WEIGHT;
+				point[7] = source.TexCoord.y * TEXCOORD_WEIGHT;
+
+				//wedges of one position form a ring through m_NextWedge, the first one names the position
+				auto found = firstByPosition.find(source.Position);
+				if (found == firstByPosition.end())
+				{
+					firstByPosition.emplace(source.Position, vertex);
+					m_Position[vertex] = vertex;
+					m_NextWedge[vertex] = vertex;
+				}
+				else
+				{
+					uint32_t first = found->second;
+					m_Position[vertex] = first;
+					m_NextWedge[vertex] = m_NextWedge[first];
+					m_NextWedge[first] = vertex;
+				}
+			}
+
+			m_Quadrics.resize(vertexCount);
+			m_PositionQuadrics.resize(vertexCount);
+			for (size_t i = 0; i < m_Indices.size(); i += 3)
+			{
+				const float* p1 = GetPoint(m_Indices[i]);
+				const float* p2 = GetPoint(m_Indices[i + 1]);
+				const float* p3 = GetPoint(m_Indices[i + 2]);
+				float area = 0.5f * glm::length(glm::cross(GetPosition(m_Indices[i + 1]) - GetPosition(m_Indices[i]), GetPosition(m_Indices[i + 2]) - GetPosition(m_Indices[i])));
+				AttributeQuadric quadric = AttributeQuadric::FromTriangle(p1, p2, p3, area);
+				PositionQuadric positionQuadric = PositionQuadric::FromTriangle(p1, p2, p3, area);
+				for (int corner = 0; corner < 3; corner++)
+				{
+					m_Quadrics[m_Indices[i + corner]].Add(quadric);
+					m_PositionQuadrics[m_Indices[i + corner]].Add(positionQuadric);
+				}
+			}
+			m_Locked.resize(vertexCount);
+			m_Marks.resize(vertexCount);
+			m_WedgeTargets.resize(vertexCount);
+			m_WedgeStamps.resize(vertexCount);
+			BuildAdjacency();
+			AddBorderQuadrics();
+		}
+
+		//collapses until at most targetIndexCount indices are left, false once no valid collapse remains
+		bool Simplify(size_t targetIndexCount)
+		{
+			while (m_Indices.size() > targetIndexCount)
+			{
+				if (!Pass(targetIndexCount))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		const std::vector<uint32_t>& GetIndices() const { return m_Indices; }
+		float GetError() const { return std::sqrt(m_Error) * m_Scale; }
+
+	private:
+		const float* GetPoint(uint32_t vertex) const { return &m_Points[vertex * QUADRIC_SIZE]; }
+		glm::vec3 GetPosition(uint32_t vertex) const { return glm::vec3(m_Points[vertex * QUADRIC_SIZE], m_Points[vertex * QUADRIC_SIZE + 1], m_Points[vertex * QUADRIC_SIZE + 2]); }
+
+		//triangles around every position and the position edges with the number of triangles sharing them
+		void BuildAdjacency()
+		{
+			size_t vertexCount = m_Position.size();
+			m_Offsets.assign(vertexCount + 1, 0);
+			for (uint32_t index : m_Indices)
+			{
+				m_Offsets[m_Position[index] + 1]++;
+			}
+			for (size_t position = 0; position < vertexCount; position++)
+			{
+				m_Offsets[position + 1] += m_Offsets[position];
+			}
+			m_Triangles.resize(m_Indices.size());
+			std::vector<uint32_t> cursor(m_Offsets.begin(), m_Offsets.end() - 1);
+			for (size_t i = 0; i < m_Indices.size(); i++)
+			{
+				m_Triangles[cursor[m_Position[m_Indices[i]]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			m_Edges.clear();
+			for (size_t i = 0; i < m_Indices.size(); i += 3)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t a = m_Position[m_Indices[i + corner]];
+					uint32_t b = m_Position[m_Indices[i + (corner + 1) % 3]];
+					m_Edges.push_back((static_cast<uint64_t>((std::min)(a, b)) << 32) | (std::max)(a, b));
+				}
+			}
+			std::sort(m_Edges.begin(), m_Edges.end());
+			m_Border.assign(vertexCount, 0);
+			m_UniqueEdges.clear();
+			for (size_t i = 0; i < m_Edges.size();)
+			{
+				size_t end = i;
+				while (end < m_Edges.size() && m_Edges[end] == m_Edges[i])
+				{
+					end++;
+				}
+				uint32_t count = static_cast<uint32_t>(end - i);
+				if (count == 1)
+				{
+					m_Border[m_Edges[i] >> 32] = 1;
+					m_Border[m_Edges[i] & 0xffffffffu] = 1;
+				}
+				m_UniqueEdges.push_back({ m_Edges[i], count });
+				i = end;
+			}
+		}
+
+		void AddBorderQuadrics()
+		{
+			for (size_t i = 0; i < m_Indices.size(); i += 3)
+			{
+				glm::vec3 corners[3] = { GetPosition(m_Indices[i]), GetPosition(m_Indices[i + 1]), GetPosition(m_Indices[i + 2]) };
+				glm::vec3 normal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				if (glm::dot(normal, normal) <= 1e-20f)
+				{
+					continue;
+				}
+				normal = glm::normalize(normal);
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t a = m_Indices[i + corner];
+					uint32_t b = m_Indices[i + (corner + 1) % 3];
+					if (CountEdgeTriangles(m_Position[a], m_Position[b]) != 1)
+					{
+						continue;
+					}
+					glm::vec3 edge = corners[(corner + 1) % 3] - corners[corner];
+					glm::vec3 planeNormal = glm::cross(edge, normal);
+					float length = glm::length(planeNormal);
+					if (length <= 1e-10f)
+					{
+						continue;
+					}
+					planeNormal /= length;
+					float distance = -glm::dot(planeNormal, corners[corner]);
+					float weight = BORDER_WEIGHT * glm::dot(edge, edge);
+					AttributeQuadric quadric = AttributeQuadric::FromPlane(planeNormal, distance, weight);
+					PositionQuadric positionQuadric = PositionQuadric::FromPlane(planeNormal, distance, weight);
+					m_Quadrics[a].Add(quadric);
+					m_Quadrics[b].Add(quadric);
+					m_PositionQuadrics[a].Add(positionQuadric);
+					m_PositionQuadrics[b].Add(positionQuadric);
+				}
+			}
+		}
+
+		uint32_t CountEdgeTriangles(uint32_t a, uint32_t b) const
+		{
+			uint64_t key = (static_cast<uint64_t>((std::min)(a, b)) << 32) | (std::max)(a, b);
+			auto range = std::equal_range(m_Edges.begin(), m_Edges.end(), key);
+			return static_cast<uint32_t>(range.second - range.first);
+		}
+
+		//where every wedge of from goes when it collapses onto to, into m_WedgeTargets
+		void MapWedges(uint32_t from, uint32_t to)
+		{
+			m_Stamp++;
+			for (uint32_t t = m_Offsets[from]; t < m_Offsets[from + 1]; t++)
+			{
+				const uint32_t* triangle = &m_Indices[m_Triangles[t] * 3];
+				uint32_t wedge = 0;
+				uint32_t target = NO_WEDGE;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t position = m_Position[triangle[corner]];
+					wedge = position == from ? triangle[corner] : wedge;
+					target = position == to ? triangle[corner] : target;
+				}
+				if (target != NO_WEDGE && m_WedgeStamps[wedge] != m_Stamp)
+				{
+					m_WedgeStamps[wedge] = m_Stamp;
+					m_WedgeTargets[wedge] = target;
+				}
+			}
+			uint32_t wedge = from;
+			do
+			{
+				if (m_WedgeStamps[wedge] != m_Stamp)
+				{
+					m_WedgeStamps[wedge] = m_Stamp;
+					m_WedgeTargets[wedge] = FindClosestWedge(wedge, to);
+				}
+				wedge = m_NextWedge[wedge];
+			} while (wedge != from);
+		}
+
+		//the wedge of position whose attributes are nearest to wedge's
+		uint32_t FindClosestWedge(uint32_t wedge, uint32_t position) const
+		{
+			const float* point = GetPoint(wedge);
+			uint32_t best = position;
+			float bestDistance = std::numeric_limits<float>::max();
+			uint32_t candidate = position;
+			do
+			{
+				const float* other = GetPoint(candidate);
+				float distance = 0.0f;
+				for (int i = 3; i < QUADRIC_SIZE; i++)
+				{
+					distance += (point[i] - other[i]) * (point[i] - other[i]);
+				}
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = candidate;
+				}
+				candidate = m_NextWedge[candidate];
+			} while (candidate != position);
+			return best;
+		}
+
+		//mean squared distance of the merged quadrics from where the collapse leaves every wedge
+		template<typename QuadricType>
+		float EvaluateCollapse(const std::vector<QuadricType>& quadrics, uint32_t from, uint32_t to)
+		{
+			MapWedges(from, to);
+			double error = 0.0;
+			double weight = 0.0;
+			uint32_t wedge = from;
+			do
+			{
+				error += quadrics[wedge].Evaluate(GetPoint(m_WedgeTargets[wedge]));
+				weight += quadrics[wedge].Weight;
+				wedge = m_NextWedge[wedge];
+			} while (wedge != from);
+			wedge = to;
+			do
+			{
+				error += quadrics[wedge].Evaluate(GetPoint(wedge));
+				weight += quadrics[wedge].Weight;
+				wedge = m_NextWedge[wedge];
+			} while (wedge != to);
+			return weight > 0.0 ? static_cast<float>((std::max)(error, 0.0) / weight) : 0.0f;
+		}
+
+		bool IsValid(const Collapse& collapse)
+		{
+			//link condition: the two positions may only share the neighbours of the triangles on their edge, otherwise
+			//the collapse pinches the surface
+			m_Stamp++;
+			for (uint32_t t = m_Offsets[collapse.From]; t < m_Offsets[collapse.From + 1]; t++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					m_Marks[m_Position[m_Indices[m_Triangles[t] * 3 + corner]]] = m_Stamp;
+				}
+			}
+			uint32_t stamp = m_Stamp;
+			m_Stamp++;
+			uint32_t shared = 0;
+			for (uint32_t t = m_Offsets[collapse.To]; t < m_Offsets[collapse.To + 1]; t++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t position = m_Position[m_Indices[m_Triangles[t] * 3 + corner]];
+					if (m_Marks[position] == stamp && position != collapse.From && position != collapse.To)
+					{
+						m_Marks[position] = m_Stamp;
+						shared++;
+					}
+				}
+			}
+			if (shared > collapse.EdgeTriangles)
+			{
+				return false;
+			}
+
+			//no remaining triangle may flip or fold over
+			glm::vec3 target = GetPosition(collapse.To);
+			for (uint32_t t = m_Offsets[collapse.From]; t < m_Offsets[collapse.From + 1]; t++)
+			{
+				const uint32_t* triangle = &m_Indices[m_Triangles[t] * 3];
+				glm::vec3 before[3];
+				glm::vec3 after[3];
+				bool onEdge = false;
+				for (int corner = 0; corner < 3; corner++)
+				{
+					uint32_t position = m_Position[triangle[corner]];
+					onEdge = onEdge || position == collapse.To;
+					before[corner] = GetPosition(triangle[corner]);
+					after[corner] = position == collapse.From ? target : before[corner];
+				}
+				if (onEdge)
+				{
+					continue;
+				}
+				glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+				if (lengths <= 1e-20f || glm::dot(normalBefore, normalAfter) < MIN_NORMAL_DOT * lengths)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void Apply(const Collapse& collapse)
+		{
+			//the reported error is geometric only, attribute terms just decide which collapses go first
+			m_Error = (std::max)(m_Error, EvaluateCollapse(m_PositionQuadrics, collapse.From, collapse.To));
+			uint32_t wedge = collapse.From;
+			do
+			{
+				uint32_t target = m_WedgeTargets[wedge];
+				m_Remap[wedge] = target;
+				m_Quadrics[target].Add(m_Quadrics[wedge]);
+				m_PositionQuadrics[target].Add(m_PositionQuadrics[wedge]);
+				wedge = m_NextWedge[wedge];
+			} while (wedge != collapse.From);
+
+			//the moved triangles now belong to these positions, everything later in the pass has to stay clear of them
+			for (uint32_t t = m_Offsets[collapse.From]; t < m_Offsets[collapse.From + 1]; t++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					m_Locked[m_Position[m_Indices[m_Triangles[t] * 3 + corner]]] = 1;
+				}
+			}
+			m_Locked[collapse.To] = 1;
+		}
+
+		//collapses independent edges in order of error, then rewrites the index list
+		bool Pass(size_t targetIndexCount)
+		{
+			std::vector<Collapse> collapses;
+			collapses.reserve(m_UniqueEdges.size());
+			for (const auto& edge : m_UniqueEdges)
+			{
+				//edges of more than two triangles are left alone
+				if (edge.second > 2)
+				{
+					continue;
+				}
+				uint32_t a = static_cast<uint32_t>(edge.first >> 32);
+				uint32_t b = static_cast<uint32_t>(edge.first & 0xffffffffu);
+				bool borderEdge = edge.second == 1;
+				Collapse best{ 0, 0, edge.second, std::numeric_limits<float>::max() };
+				for (int direction = 0; direction < 2; direction++)
+				{
+					uint32_t from = direction == 0 ? a : b;
+					uint32_t to = direction == 0 ? b : a;
+					//a border position may only slide along the border
+					if (m_Border[from] && !borderEdge)
+					{
+						continue;
+					}
+					float error = EvaluateCollapse(m_Quadrics, from, to);
+					if (error < best.Error)
+					{
+						best = { from, to, edge.second, error };
+					}
+				}
+				if (best.Error < std::numeric_limits<float>::max())
+				{
+					collapses.push_back(best);
+				}
+			}
+			if (collapses.empty())
+			{
+				return false;
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Error < b.Error; });
+
+			m_Remap.resize(m_Position.size());
+			for (uint32_t vertex = 0; vertex < m_Remap.size(); vertex++)
+			{
+				m_Remap[vertex] = vertex;
+			}
+			std::fill(m_Locked.begin(), m_Locked.end(), 0);
+			size_t triangleCount = m_Indices.size() / 3;
+			size_t targetTriangles = targetIndexCount / 3;
+			size_t limit = (std::max)(static_cast<size_t>(1), static_cast<size_t>(collapses.size() * PASS_FRACTION));
+			uint32_t applied = 0;
+			for (size_t i = 0; i < limit && triangleCount > targetTriangles; i++)
+			{
+				const Collapse& collapse = collapses[i];
+				if (m_Locked[collapse.From] || m_Locked[collapse.To] || !IsValid(collapse))
+				{
+					continue;
+				}
+				Apply(collapse);
+				triangleCount -= (std::min)(triangleCount, static_cast<size_t>(collapse.EdgeTriangles));
+				applied++;
+			}
+			if (applied == 0)
+			{
+				return false;
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i < m_Indices.size(); i += 3)
+			{
+				uint32_t a = m_Remap[m_Indices[i]];
+				uint32_t b = m_Remap[m_Indices[i + 1]];
+				uint32_t c = m_Remap[m_Indices[i + 2]];
+				if (m_Position[a] == m_Position[b] || m_Position[b] == m_Position[c] || m_Position[c] == m_Position[a])
+				{
+					continue;
+				}
+				m_Indices[write++] = a;
+				m_Indices[write++] = b;
+				m_Indices[write++] = c;
+			}
+			m_Indices.resize(write);
+			BuildAdjacency();
+			return true;
+		}
+
+	private:
+		std::vector<uint32_t> m_Indices;
+		//QUADRIC_SIZE floats per vertex, positions relative to the bounding sphere and divided by m_Scale
+		std::vector<float> m_Points;
+		float m_Scale = 1.0f;
+		std::vector<AttributeQuadric> m_Quadrics;
+		std::vector<PositionQuadric> m_PositionQuadrics;
+		//first wedge of every vertex's position, and the ring of wedges sharing it
+		std::vector<uint32_t> m_Position;
+		std::vector<uint32_t> m_NextWedge;
+
+		//rebuilt after every pass, indexed by position
+		std::vector<uint32_t> m_Offsets;
+		std::vector<uint32_t> m_Triangles;
+		std::vector<uint64_t> m_Edges;
+		std::vector<std::pair<uint64_t, uint32_t>> m_UniqueEdges;
+		std::vector<uint8_t> m_Border;
+
+		//per pass
+		std::vector<uint32_t> m_Remap;
+		std::vector<uint8_t> m_Locked;
+		std::vector<uint32_t> m_Marks;
+		std::vector<uint32_t> m_WedgeTargets;
+		std::vector<uint32_t> m_WedgeStamps;
+		uint32_t m_Stamp = 0;
+		//largest mean squared distance of any applied collapse, from m_PositionQuadrics
+		float m_Error = 0.0f;
+	};
+}
+
+std::vector<uint32_t> SimplifyMesh(const MeshData& mesh, size_t targetIndexCount, float& error)
+{
+	Simplifier simplifier(mesh);
+	simplifier.Simplify(targetIndexCount);
+	error = simplifier.GetError();
+	return simplifier.GetIndices();
+}
+
+std::vector<MeshLod> GenerateLods(MeshData& mesh, uint32_t maxLevels, float reduction, uint32_t minTriangles)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::vector<MeshLod> lods;
+	//later levels continue from the previous one, so their quadrics remember every earlier collapse
+	Simplifier simplifier(mesh);
+	size_t previousCount = mesh.Indices.size();
+	while (lods.size() < maxLevels)
+	{
+		size_t target = static_cast<size_t>(previousCount / 3 * reduction) * 3;
+		if (target / 3 < minTriangles)
+		{
+			break;
+		}
+		bool reached = simplifier.Simplify(target);
+		std::vector<uint32_t> indices = simplifier.GetIndices();
+		//stuck well short of the target, a level this close to the last one is not worth its indices
+		if (!reached && indices.size() > previousCount * (1.0f + reduction) * 0.5f)
+		{
+			break;
+		}
+		OptimizeVertexCache(indices, mesh.Vertices.size());
+
+		MeshLod lod;
+		lod.FirstIndex = static_cast<uint32_t>(mesh.Indices.size());
+		lod.IndexCount = static_cast<uint32_t>(indices.size());
+		lod.Error = simplifier.GetError();
+		lods.push_back(lod);
+		mesh.Indices.insert(mesh.Indices.end(), indices.begin(), indices.end());
+		previousCount = indices.size();
+		if (!reached)
+		{
+			break;
+		}
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "mesh lods: " << lods.size() << " levels below the full mesh, " << milliseconds << "ms" << std::endl;
+	for (size_t level = 0; level < lods.size(); level++)
+	{
+		std::cout << "  lod " << level + 1 << ": " << lods[level].IndexCount / 3 << " triangles, error " << lods[level].Error << std::endl;
+	}
+	return lods;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MeshLoader.h"
+
+//one simplified level of a mesh: a range of its index buffer over the full-detail vertices
+struct MeshLod
+{
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	//deviation the collapses that produced it introduced, in the mesh's units
+	float Error = 0.0f;
+};
+
+//quadric error edge collapse (Garland & Heckbert 1998). every vertex carries a quadric over position, normal and
+//texcoord, so a collapse that smears attributes costs like one that bends the surface. vertices only ever collapse
+//onto a neighbour, so a simplified index list still indexes the original vertices. error receives the result's
+//geometric error from a second, position only quadric per vertex, so attributes rank collapses but never count as distance
+std::vector<uint32_t> SimplifyMesh(const MeshData& mesh, size_t targetIndexCount, float& error);
+
+//a chain of levels, each with about reduction times the triangles of the one before, until maxLevels, minTriangles or
+//the simplifier runs out of valid collapses. levels are vertex cache optimized and appended to mesh.Indices behind
+//the full-detail triangles, coarsest last
+std::vector<MeshLod> GenerateLods(MeshData& mesh, uint32_t maxLevels = 6, float reduction = 0.5f, uint32_t minTriangles = 64);
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "MeshletBuilder.h"
+
+namespace
+{
+	void FinishMeshlet(const MeshData& mesh, MeshletData& meshlets, uint32_t firstIndex, uint32_t indexCount, uint32_t firstVertex)
+	{
+		uint32_t vertexCount = static_cast<uint32_t>(meshlets.Vertices.size()) - firstVertex;
+		meshlets.DrawRanges.push_back(glm::uvec2(firstIndex, indexCount));
+		meshlets.VertexRanges.push_back(glm::uvec2(firstVertex, vertexCount));
+
+		//sphere around the box centre, not minimal but cheap and never far off for compact clusters
+		glm::vec3 min = mesh.Vertices[meshlets.Vertices[firstVertex]].Position;
+		glm::vec3 max = min;
+		for (uint32_t i = firstVertex; i < firstVertex + vertexCount; i++)
+		{
+			min = glm::min(min, mesh.Vertices[meshlets.Vertices[i]].Position);
+			max = glm::max(max, mesh.Vertices[meshlets.Vertices[i]].Position);
+		}
+		glm::vec3 center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = firstVertex; i < firstVertex + vertexCount; i++)
+		{
+			radius = (std::max)(radius, glm::length(mesh.Vertices[meshlets.Vertices[i]].Position - center));
+		}
+		meshlets.Spheres.push_back(glm::vec4(center, radius));
+
+		glm::vec3 normals[128];
+		uint32_t normalCount = 0;
+		glm::vec3 axis(0.0f);
+		for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3)
+		{
+			const glm::vec3& a = mesh.Vertices[mesh.Indices[i]].Position;
+			const glm::vec3& b = mesh.Vertices[mesh.Indices[i + 1]].Position;
+			const glm::vec3& c = mesh.Vertices[mesh.Indices[i + 2]].Position;
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			//degenerate triangles face nowhere and say nothing about the cone
+			if (length > 0.0f)
+			{
+				normals[normalCount++] = normal / length;
+				axis += normal / length;
+			}
+		}
+		float axisLength = glm::length(axis);
+		if (normalCount == 0 || axisLength == 0.0f)
+		{
+			meshlets.Cones.push_back(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+			return;
+		}
+		axis /= axisLength;
+		float minDot = 1.0f;
+		for (uint32_t i = 0; i < normalCount; i++)
+		{
+			minDot = (std::min)(minDot, glm::dot(axis, normals[i]));
+		}
+		//a cone wider than a hemisphere always has some triangle facing the camera
+		float cutoff = minDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		meshlets.Cones.push_back(glm::vec4(axis, cutoff));
+	}
+}
+
+MeshletData BuildMeshlets(const MeshData& mesh, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	//local indices are bytes, the normal scratch in FinishMeshlet holds 128 triangles
+	maxVertices = std::clamp(maxVertices, 3u, 256u);
+	maxTriangles = std::clamp(maxTriangles, 1u, 128u);
+
+	MeshletData meshlets;
+	meshlets.Triangles.resize(mesh.Indices.size());
+	const uint32_t notInMeshlet = ~0u;
+	//meshlet-local index of every global vertex in the meshlet being built
+	std::vector<uint32_t> localIndex(mesh.Vertices.size(), notInMeshlet);
+
+	uint32_t firstIndex = 0;
+	uint32_t firstVertex = 0;
+	for (uint32_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+	{
+		uint32_t newVertices = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			newVertices += localIndex[mesh.Indices[i + corner]] == notInMeshlet ? 1 : 0;
+		}
+		uint32_t vertexCount = static_cast<uint32_t>(meshlets.Vertices.size()) - firstVertex;
+		uint32_t triangleCount = (i - firstIndex) / 3;
+		if (vertexCount + newVertices > maxVertices || triangleCount + 1 > maxTriangles)
+		{
+			FinishMeshlet(mesh, meshlets, firstIndex, i - firstIndex, firstVertex);
+			for (uint32_t v = firstVertex; v < meshlets.Vertices.size(); v++)
+			{
+				localIndex[meshlets.Vertices[v]] = notInMeshlet;
+			}
+			firstIndex = i;
+			firstVertex = static_cast<uint32_t>(meshlets.Vertices.size());
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = mesh.Indices[i + corner];
+			if (localIndex[vertex] == notInMeshlet)
+			{
+				localIndex[vertex] = static_cast<uint32_t>(meshlets.Vertices.size()) - firstVertex;
+				meshlets.Vertices.push_back(vertex);
+			}
+			meshlets.Triangles[i + corner] = static_cast<uint8_t>(localIndex[vertex]);
+		}
+	}
+	if (firstIndex < mesh.Indices.size())
+	{
+		FinishMeshlet(mesh, meshlets, firstIndex, static_cast<uint32_t>(mesh.Indices.size()) - firstIndex, firstVertex);
+	}
+
+	size_t coneCount = 0;
+	for (const glm::vec4& cone : meshlets.Cones)
+	{
+		coneCount += cone.w < 1.0f ? 1 : 0;
+	}
+	std::cout << "meshlets: " << meshlets.GetCount() << " (max " << maxVertices << " vertices/" << maxTriangles << " triangles), "
+			  << static_cast<float>(mesh.Indices.size() / 3) / static_cast<float>((std::max)(meshlets.GetCount(), size_t(1))) << " triangles and "
+			  << static_cast<float>(meshlets.Vertices.size()) / static_cast<float>((std::max)(meshlets.GetCount(), size_t(1))) << " vertices on average, "
+			  << coneCount << " with a usable normal cone" << std::endl;
+	return meshlets;
+}
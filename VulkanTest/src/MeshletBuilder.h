@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "MeshLoader.h"
+
+//a mesh cut into small clusters of triangles that are culled as one. meshlets take consecutive triangles of the
+//index buffer, so each one is also a plain (firstIndex, indexCount) range of it. per-meshlet data is kept as
+//structure of arrays, the culling pass only streams what it tests
+struct MeshletData
+{
+	//xyz centre, w radius
+	std::vector<glm::vec4> Spheres;
+	//xyz average normal, w sin of the normal cone's half angle. the whole meshlet faces away from the camera when
+	//dot(centre - camera, axis) >= w * length(centre - camera) + radius; w = 1 never passes
+	std::vector<glm::vec4> Cones;
+	//first index and index count in the mesh's index buffer
+	std::vector<glm::uvec2> DrawRanges;
+
+	//meshlet-local form a mesh shader would consume: offset and count into Vertices (global vertex ids), and one
+	//byte per index into the meshlet's vertices, laid out like the index buffer
+	std::vector<glm::uvec2> VertexRanges;
+	std::vector<uint32_t> Vertices;
+	std::vector<uint8_t> Triangles;
+
+	size_t GetCount() const { return DrawRanges.size(); }
+};
+
+//greedy in index order, which the mesh optimizer already made local. a meshlet closes once the next triangle
+//would take it past maxVertices unique vertices or maxTriangles triangles (64/124 fit NVIDIA's and AMD's
+//preferred mesh shader output sizes)
+MeshletData BuildMeshlets(const MeshData& mesh, uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
@@ -0,0 +1,125 @@
+#include <iostream>
+
+#include "MeshletCulling.h"
+#include "BarrierBatch.h"
+
+void MeshletCulling::Init(vk::Device device, MemoryAllocator* allocator, UploadManager* uploads, vk::PipelineCache pipelineCache,
+	const MeshletData& meshlets, uint32_t framesInFlight, bool synchronization2, bool drawIndirectCount)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_Synchronization2 = synchronization2;
+	m_DrawIndirectCount = drawIndirectCount;
+	m_MeshletCount = static_cast<uint32_t>(meshlets.GetCount());
+
+	vk::BufferUsageFlags boundsUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+	vk::DeviceSize sphereSize = sizeof(glm::vec4) * m_MeshletCount;
+	vk::DeviceSize coneSize = sizeof(glm::vec4) * m_MeshletCount;
+	vk::DeviceSize rangeSize = sizeof(glm::uvec2) * m_MeshletCount;
+	CreateBuffer(sphereSize, boundsUsage, m_SphereBuffer, m_SphereAllocation);
+	CreateBuffer(coneSize, boundsUsage, m_ConeBuffer, m_ConeAllocation);
+	CreateBuffer(rangeSize, boundsUsage, m_RangeBuffer, m_RangeAllocation);
+	uploads->UploadBuffer(m_SphereBuffer, 0, meshlets.Spheres.data(), sphereSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead);
+	uploads->UploadBuffer(m_ConeBuffer, 0, meshlets.Cones.data(), coneSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead);
+	uploads->UploadBuffer(m_RangeBuffer, 0, meshlets.DrawRanges.data(), rangeSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead);
+
+	//written by the culling pass of the frame that owns it, so consecutive frames never share one
+	vk::DeviceSize drawSize = COMMANDS_OFFSET + sizeof(vk::DrawIndexedIndirectCommand) * m_MeshletCount;
+	m_DrawBuffers.resize(framesInFlight);
+	m_DrawAllocations.resize(framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; i++)
+	{
+		CreateBuffer(drawSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			m_DrawBuffers[i], m_DrawAllocations[i]);
+	}
+
+	//spheres, cones, draw ranges, count + commands
+	m_Kernel.Init(m_Device, pipelineCache, "resource/shaders/meshlet_cull.spv", 4, sizeof(CullParameters), framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; i++)
+	{
+		m_Kernel.SetBuffers(i, { m_SphereBuffer, m_ConeBuffer, m_RangeBuffer, m_DrawBuffers[i] });
+	}
+	std::cout << "meshlet culling: " << m_MeshletCount << " meshlets, " << (m_DrawIndirectCount ? "compacted with drawIndirectCount" : "one indirect command per meshlet") << std::endl;
+}
+
+void MeshletCulling::Destroy()
+{
+	if (!m_Device)
+	{
+		return;
+	}
+	m_Kernel.Destroy();
+	for (size_t i = 0; i < m_DrawBuffers.size(); i++)
+	{
+		m_Device.destroyBuffer(m_DrawBuffers[i]);
+		m_Allocator->Free(m_DrawAllocations[i]);
+	}
+	m_Device.destroyBuffer(m_RangeBuffer);
+	m_Allocator->Free(m_RangeAllocation);
+	m_Device.destroyBuffer(m_ConeBuffer);
+	m_Allocator->Free(m_ConeAllocation);
+	m_Device.destroyBuffer(m_SphereBuffer);
+	m_Allocator->Free(m_SphereAllocation);
+	m_Device = vk::Device();
+}
+
+void MeshletCulling::RecordCull(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const Frustum& frustum, const glm::vec3& camera)
+{
+	vk::Buffer drawBuffer = m_DrawBuffers[frameIndex];
+	vk::DeviceSize drawSize = COMMANDS_OFFSET + sizeof(vk::DrawIndexedIndirectCommand) * m_MeshletCount;
+	if (m_DrawIndirectCount)
+	{
+		commandBuffer.fillBuffer(drawBuffer, 0, sizeof(uint32_t), 0);
+		BarrierBatch reset;
+		reset.Buffer(drawBuffer, 0, sizeof(uint32_t), vk::PipelineStageFlagBits2::eClear, vk::AccessFlagBits2::eTransferWrite,
+			vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+		reset.Record(commandBuffer, m_Synchronization2);
+	}
+
+	CullParameters parameters{};
+	for (int plane = 0; plane < Frustum::PlaneCount; plane++)
+	{
+		parameters.Planes[plane] = frustum.Planes[plane];
+	}
+	parameters.Camera = glm::vec4(camera, 1.0f);
+	parameters.MeshletCount = m_MeshletCount;
+	parameters.Compact = m_DrawIndirectCount ? 1 : 0;
+
+	//64 matches local_size_x in meshlet_cull.comp
+	m_Kernel.Dispatch(commandBuffer, frameIndex, &parameters, (m_MeshletCount + 63) / 64);
+
+	BarrierBatch ready;
+	ready.Buffer(drawBuffer, 0, drawSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eDrawIndirect, vk::AccessFlagBits2::eIndirectCommandRead);
+	ready.Record(commandBuffer, m_Synchronization2);
+}
+
+void MeshletCulling::RecordDraws(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+	if (m_DrawIndirectCount)
+	{
+		commandBuffer.drawIndexedIndirectCount(m_DrawBuffers[frameIndex], COMMANDS_OFFSET, m_DrawBuffers[frameIndex], 0, m_MeshletCount, stride);
+	}
+	else
+	{
+		commandBuffer.drawIndexedIndirect(m_DrawBuffers[frameIndex], COMMANDS_OFFSET, m_MeshletCount, stride);
+	}
+}
+
+void MeshletCulling::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, Allocation& allocation)
+{
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = vk::StructureType::eBufferCreateInfo;
+	bufferInfo.setUsage(usage)
+			  .setSize(size)
+			  .setSharingMode(vk::SharingMode::eExclusive);
+	if (m_Device.createBuffer(&bufferInfo, nullptr, &buffer) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create meshlet buffer!");
+	}
+	AllocationCreateInfo allocationInfo{};
+	allocationInfo.Properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	allocation = m_Allocator->AllocateForBuffer(buffer, allocationInfo);
+	m_Device.bindBufferMemory(buffer, allocation.Memory, allocation.Offset);
+}
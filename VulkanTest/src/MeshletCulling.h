@@ -0,0 +1,61 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <glm.hpp>
+#include "MemoryAllocator.h"
+#include "UploadManager.h"
+#include "MeshletBuilder.h"
+#include "Frustum.h"
+#include "ComputeKernel.h"
+
+//GPU meshlet culling: a compute pass tests every meshlet's sphere against the frustum and its normal cone against
+//the camera, and writes one VkDrawIndexedIndirectCommand per surviving meshlet. the draws are then issued with a
+//single indirect call, compacted with a GPU-side count when drawIndirectCount is available, otherwise as one
+//command per meshlet with instanceCount 0 for the culled ones
+class MeshletCulling
+{
+public:
+	void Init(vk::Device device, MemoryAllocator* allocator, UploadManager* uploads, vk::PipelineCache pipelineCache,
+		const MeshletData& meshlets, uint32_t framesInFlight, bool synchronization2, bool drawIndirectCount);
+	void Destroy();
+
+	//outside of rendering. frustum and camera are in the mesh's model space, the bounds are tested there
+	void RecordCull(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const Frustum& frustum, const glm::vec3& camera);
+	//inside rendering, with the mesh's vertex and index buffers bound
+	void RecordDraws(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+
+	uint32_t GetMeshletCount() const { return m_MeshletCount; }
+
+private:
+	struct CullParameters
+	{
+		glm::vec4 Planes[Frustum::PlaneCount];
+		glm::vec4 Camera;
+		uint32_t MeshletCount;
+		uint32_t Compact;
+	};
+	//the draw count sits in front of the commands, padded so they start 16-byte aligned
+	static constexpr vk::DeviceSize COMMANDS_OFFSET = 16;
+
+	void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, Allocation& allocation);
+
+private:
+	vk::Device m_Device;
+	MemoryAllocator* m_Allocator = nullptr;
+	bool m_Synchronization2 = false;
+	bool m_DrawIndirectCount = false;
+	uint32_t m_MeshletCount = 0;
+
+	//structure of arrays, one buffer per field
+	vk::Buffer m_SphereBuffer;
+	Allocation m_SphereAllocation;
+	vk::Buffer m_ConeBuffer;
+	Allocation m_ConeAllocation;
+	vk::Buffer m_RangeBuffer;
+	Allocation m_RangeAllocation;
+	//count + commands, one per frame in flight
+	std::vector<vk::Buffer> m_DrawBuffers;
+	std::vector<Allocation> m_DrawAllocations;
+
+	ComputeKernel m_Kernel;
+};
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "ObjectCulling.h"
+#include "BarrierBatch.h"
+
+void ObjectCulling::Init(vk::Device device, MemoryAllocator* allocator, UploadManager* uploads, vk::PipelineCache pipelineCache,
+	const Scene& scene, uint32_t framesInFlight, bool synchronization2)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_Synchronization2 = synchronization2;
+	m_ObjectCount = scene.GetObjectCount();
+
+	//MAX_LODS entries per mesh, the error relative to the mesh's radius so the shader scales it by the object's sphere.
+	//missing levels repeat the coarsest one with an infinite error, which never gets selected
+	std::vector<glm::uvec4> meshes(scene.Meshes.size() * MAX_LODS);
+	for (size_t i = 0; i < scene.Meshes.size(); i++)
+	{
+		const SceneMesh& mesh = scene.Meshes[i];
+		for (uint32_t level = 0; level < MAX_LODS; level++)
+		{
+			uint32_t available = (std::min)(level, mesh.GetLodCount() - 1);
+			MeshLod lod = mesh.GetLod(available);
+			float error = available == level ? lod.Error / (std::max)(mesh.Bounds.w, 1e-6f) : std::numeric_limits<float>::infinity();
+			uint32_t errorBits;
+			std::memcpy(&errorBits, &error, sizeof(errorBits));
+			meshes[i * MAX_LODS + level] = glm::uvec4(lod.FirstIndex, lod.IndexCount, static_cast<uint32_t>(mesh.VertexOffset), errorBits);
+		}
+	}
+
+	vk::BufferUsageFlags inputUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+	vk::DeviceSize sphereSize = sizeof(glm::vec4) * m_ObjectCount;
+	vk::DeviceSize meshIdSize = sizeof(uint32_t) * m_ObjectCount;
+	vk::DeviceSize meshSize = sizeof(glm::uvec4) * meshes.size();
+	vk::DeviceSize levelSize = sizeof(uint32_t) * m_ObjectCount;
+	CreateBuffer(sphereSize, inputUsage, m_SphereBuffer, m_SphereAllocation);
+	CreateBuffer(meshIdSize, inputUsage, m_MeshIdBuffer, m_MeshIdAllocation);
+	CreateBuffer(meshSize, inputUsage, m_MeshBuffer, m_MeshAllocation);
+	CreateBuffer(levelSize, inputUsage, m_LevelBuffer, m_LevelAllocation);
+	std::vector<uint32_t> levels(m_ObjectCount, 0);
+	uploads->UploadBuffer(m_SphereBuffer, 0, scene.Spheres.data(), sphereSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead);
+	uploads->UploadBuffer(m_MeshIdBuffer, 0, scene.MeshIds.data(), meshIdSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead);
+	uploads->UploadBuffer(m_MeshBuffer, 0, meshes.data(), meshSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead);
+	uploads->UploadBuffer(m_LevelBuffer, 0, levels.data(), levelSize, vk::PipelineStageFlagBits2::eComputeShader,
+		vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+	//written by the culling pass of the frame that owns it, so consecutive frames never share one
+	vk::DeviceSize drawSize = COMMANDS_OFFSET + sizeof(vk::DrawIndexedIndirectCommand) * m_ObjectCount;
+	m_DrawBuffers.resize(framesInFlight);
+	m_DrawAllocations.resize(framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; i++)
+	{
+		CreateBuffer(drawSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			m_DrawBuffers[i], m_DrawAllocations[i]);
+	}
+
+	//spheres, mesh ids, meshes, count + commands, levels
+	m_Kernel.Init(m_Device, pipelineCache, "resource/shaders/object_cull.spv", 5, sizeof(CullParameters), framesInFlight);
+	for (uint32_t i = 0; i < framesInFlight; i++)
+	{
+		m_Kernel.SetBuffers(i, { m_SphereBuffer, m_MeshIdBuffer, m_MeshBuffer, m_DrawBuffers[i], m_LevelBuffer });
+	}
+	std::cout << "object culling: " << m_ObjectCount << " objects, " << scene.Meshes.size() << " meshes, "
+			  << (drawSize >> 10) << " KiB of indirect commands per frame" << std::endl;
+}
+
+void ObjectCulling::Destroy()
+{
+	if (!m_Device)
+	{
+		return;
+	}
+	m_Kernel.Destroy();
+	for (size_t i = 0; i < m_DrawBuffers.size(); i++)
+	{
+		m_Device.destroyBuffer(m_DrawBuffers[i]);
+		m_Allocator->Free(m_DrawAllocations[i]);
+	}
+	m_Device.destroyBuffer(m_LevelBuffer);
+	m_Allocator->Free(m_LevelAllocation);
+	m_Device.destroyBuffer(m_MeshBuffer);
+	m_Allocator->Free(m_MeshAllocation);
+	m_Device.destroyBuffer(m_MeshIdBuffer);
+	m_Allocator->Free(m_MeshIdAllocation);
+	m_Device.destroyBuffer(m_SphereBuffer);
+	m_Allocator->Free(m_SphereAllocation);
+	m_Device = vk::Device();
+}
+
+void ObjectCulling::RecordCull(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const Frustum& frustum, const LodSelector& lods)
+{
+	vk::Buffer drawBuffer = m_DrawBuffers[frameIndex];
+	vk::DeviceSize drawSize = COMMANDS_OFFSET + sizeof(vk::DrawIndexedIndirectCommand) * m_ObjectCount;
+	commandBuffer.fillBuffer(drawBuffer, 0, sizeof(uint32_t), 0);
+	BarrierBatch reset;
+	reset.Buffer(drawBuffer, 0, sizeof(uint32_t), vk::PipelineStageFlagBits2::eClear, vk::AccessFlagBits2::eTransferWrite,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+	//the previous frame's pass left its levels here
+	reset.Buffer(m_LevelBuffer, 0, sizeof(uint32_t) * m_ObjectCount, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+	reset.Record(commandBuffer, m_Synchronization2);
+
+	CullParameters parameters{};
+	for (int plane = 0; plane < Frustum::PlaneCount; plane++)
+	{
+		parameters.Planes[plane] = frustum.Planes[plane];
+	}
+	parameters.Camera = lods.GetCamera();
+	parameters.ObjectCount = m_ObjectCount;
+	parameters.LodThreshold = lods.GetThreshold();
+	parameters.LodHysteresis = lods.GetHysteresis();
+	//64 matches local_size_x in object_cull.comp
+	m_Kernel.Dispatch(commandBuffer, frameIndex, &parameters, (m_ObjectCount + 63) / 64);
+
+	BarrierBatch ready;
+	ready.Buffer(drawBuffer, 0, drawSize, vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+		vk::PipelineStageFlagBits2::eDrawIndirect, vk::AccessFlagBits2::eIndirectCommandRead);
+	ready.Record(commandBuffer, m_Synchronization2);
+}
+
+void ObjectCulling::RecordDraws(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	commandBuffer.drawIndexedIndirectCount(m_DrawBuffers[frameIndex], COMMANDS_OFFSET, m_DrawBuffers[frameIndex], 0, m_ObjectCount,
+		sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void ObjectCulling::CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, Allocation& allocation)
+{
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = vk::StructureType::eBufferCreateInfo;
+	bufferInfo.setUsage(usage)
+			  .setSize(size)
+			  .setSharingMode(vk::SharingMode::eExclusive);
+	if (m_Device.createBuffer(&bufferInfo, nullptr, &buffer) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create object culling buffer!");
+	}
+	AllocationCreateInfo allocationInfo{};
+	allocationInfo.Properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	allocation = m_Allocator->AllocateForBuffer(buffer, allocationInfo);
+	m_Device.bindBufferMemory(buffer, allocation.Memory, allocation.Offset);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <glm.hpp>
+#include "MemoryAllocator.h"
+#include "UploadManager.h"
+#include "ComputeKernel.h"
+#include "Frustum.h"
+#include "Scene.h"
+#include "LodSelector.h"
+
+//GPU-driven object culling: a compute pass tests every object's bounding sphere against the frustum and appends a
+//VkDrawIndexedIndirectCommand for each survivor, with firstInstance set to the object's index so the vertex shader
+//can fetch its transform. the draws go out as one drawIndexedIndirectCount, whatever the object count the CPU records
+//the same handful of commands per frame. the pass also picks each survivor's level of detail the way LodSelector does,
+//keeping every object's level in a buffer for the hysteresis
+class ObjectCulling
+{
+public:
+	//needs drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance
+	static bool IsSupported(bool multiDrawIndirect, bool drawIndirectCount, bool drawIndirectFirstInstance)
+	{
+		return multiDrawIndirect && drawIndirectCount && drawIndirectFirstInstance;
+	}
+
+	void Init(vk::Device device, MemoryAllocator* allocator, UploadManager* uploads, vk::PipelineCache pipelineCache,
+		const Scene& scene, uint32_t framesInFlight, bool synchronization2);
+	void Destroy();
+
+	//outside of rendering. the frustum and the selector's camera are in the space the scene's transforms map into
+	void RecordCull(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const Frustum& frustum, const LodSelector& lods);
+	//inside rendering, with the shared vertex and index buffers bound
+	void RecordDraws(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+
+	uint32_t GetObjectCount() const { return m_ObjectCount; }
+
+private:
+	struct CullParameters
+	{
+		glm::vec4 Planes[Frustum::PlaneCount];
+		glm::vec4 Camera;
+		uint32_t ObjectCount;
+		float LodThreshold;
+		float LodHysteresis;
+	};
+	//levels per mesh in the LOD table, matches MAX_LODS in object_cull.comp
+	static constexpr uint32_t MAX_LODS = 8;
+	//the draw count sits in front of the commands, padded so they start 16-byte aligned
+	static constexpr vk::DeviceSize COMMANDS_OFFSET = 16;
+
+	void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::Buffer& buffer, Allocation& allocation);
+
+private:
+	vk::Device m_Device;
+	MemoryAllocator* m_Allocator = nullptr;
+	bool m_Synchronization2 = false;
+	uint32_t m_ObjectCount = 0;
+
+	//structure of arrays, one buffer per field
+	vk::Buffer m_SphereBuffer;
+	Allocation m_SphereAllocation;
+	vk::Buffer m_MeshIdBuffer;
+	Allocation m_MeshIdAllocation;
+	//firstIndex, indexCount, vertexOffset, error per mesh and level
+	vk::Buffer m_MeshBuffer;
+	Allocation m_MeshAllocation;
+	//every object's current level, carried across frames
+	vk::Buffer m_LevelBuffer;
+	Allocation m_LevelAllocation;
+	//count + commands, one per frame in flight
+	std::vector<vk::Buffer> m_DrawBuffers;
+	std::vector<Allocation> m_DrawAllocations;
+
+	ComputeKernel m_Kernel;
+};
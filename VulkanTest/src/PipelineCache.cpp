@@ -0,0 +1,130 @@
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+
+#include "PipelineCache.h"
+
+void PipelineCache::Load(vk::Device device, const vk::PhysicalDeviceProperties& properties, const std::string& path)
+{
+	m_Device = device;
+	m_Properties = properties;
+	m_Path = path;
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::vector<char> data;
+	if (!m_Path.empty())
+	{
+		std::ifstream file(m_Path, std::ios::ate | std::ios::binary);
+		if (file.is_open())
+		{
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(data.data(), data.size());
+		}
+	}
+	if (!data.empty() && !IsCompatible(data))
+	{
+		//stale blob from another driver or GPU, start over rather than hand it to the driver
+		std::cout << "pipeline cache: " << m_Path << " was written by a different device/driver, ignoring it" << std::endl;
+		data.clear();
+	}
+
+	vk::PipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = vk::StructureType::ePipelineCacheCreateInfo;
+	cacheInfo.setInitialDataSize(data.size())
+			 .setPInitialData(data.empty() ? nullptr : data.data());
+	if (m_Device.createPipelineCache(&cacheInfo, nullptr, &m_Cache) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+	double loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << "pipeline cache: loaded " << data.size() << " bytes in " << loadMilliseconds << "ms" << std::endl;
+}
+
+bool PipelineCache::IsCompatible(const std::vector<char>& data) const
+{
+	//VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+	uint32_t header[4];
+	if (data.size() < sizeof(header) + VK_UUID_SIZE)
+	{
+		return false;
+	}
+	memcpy(header, data.data(), sizeof(header));
+	if (header[0] < sizeof(header) + VK_UUID_SIZE ||
+		header[1] != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne) ||
+		header[2] != m_Properties.vendorID ||
+		header[3] != m_Properties.deviceID)
+	{
+		return false;
+	}
+	return memcmp(data.data() + sizeof(header), m_Properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::RecordCreation(double milliseconds, const vk::PipelineCreationFeedback& feedback)
+{
+	std::lock_guard<std::mutex> lock(m_StatisticsMutex);
+	if (!(feedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid))
+	{
+		m_Unknown++;
+		m_UnknownMilliseconds += milliseconds;
+	}
+	else if (feedback.flags & vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit)
+	{
+		m_Hits++;
+		m_HitMilliseconds += milliseconds;
+	}
+	else
+	{
+		m_Misses++;
+		m_MissMilliseconds += milliseconds;
+	}
+}
+
+void PipelineCache::Save()
+{
+	std::cout << "pipeline cache: " << m_Hits << " hits (" << m_HitMilliseconds << "ms), "
+			  << m_Misses << " misses (" << m_MissMilliseconds << "ms)";
+	if (m_Unknown > 0)
+	{
+		std::cout << ", " << m_Unknown << " without feedback (" << m_UnknownMilliseconds << "ms)";
+	}
+	std::cout << std::endl;
+
+	if (m_Path.empty() || !m_Cache)
+	{
+		return;
+	}
+	std::vector<uint8_t> data = m_Device.getPipelineCacheData(m_Cache);
+
+	//write next to the target and rename over it so a crash never leaves a truncated cache behind
+	std::string tempPath = m_Path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "pipeline cache: failed to open " << tempPath << " for writing" << std::endl;
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file.good())
+		{
+			std::cout << "pipeline cache: failed to write " << tempPath << std::endl;
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, m_Path, error);
+	if (error)
+	{
+		std::cout << "pipeline cache: failed to replace " << m_Path << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+void PipelineCache::Destroy()
+{
+	m_Device.destroyPipelineCache(m_Cache);
+	m_Cache = nullptr;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <string>
+#include <vector>
+#include <mutex>
+
+//VkPipelineCache backed by a file: loaded when the device comes up, written back at shutdown
+class PipelineCache
+{
+public:
+	void Load(vk::Device device, const vk::PhysicalDeviceProperties& properties, const std::string& path);
+	void Save();
+	void Destroy();
+	//feed the creation feedback of every pipeline built against this cache into the hit/miss statistics
+	void RecordCreation(double milliseconds, const vk::PipelineCreationFeedback& feedback);
+	vk::PipelineCache Get() const { return m_Cache; }
+private:
+	bool IsCompatible(const std::vector<char>& data) const;
+private:
+	vk::Device m_Device;
+	vk::PhysicalDeviceProperties m_Properties;
+	std::string m_Path;
+	vk::PipelineCache m_Cache;
+	//pipelines compile on worker threads, the cache handle itself is internally synchronized
+	std::mutex m_StatisticsMutex;
+	uint32_t m_Hits = 0;
+	uint32_t m_Misses = 0;
+	uint32_t m_Unknown = 0;
+	double m_HitMilliseconds = 0.0;
+	double m_MissMilliseconds = 0.0;
+	double m_UnknownMilliseconds = 0.0;
+};
@@ -0,0 +1,471 @@
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "PipelineRegistry.h"
+#include "../utils/readFile.h"
+
+namespace
+{
+	//FNV-1a, good enough to spread pipeline descriptions over the map
+	struct Hasher
+	{
+		uint64_t Value = 14695981039346656037ull;
+
+		void Bytes(const void* data, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				Value ^= bytes[i];
+				Value *= 1099511628211ull;
+			}
+		}
+
+		void U32(uint32_t value) { Bytes(&value, sizeof(value)); }
+		void String(const std::string& text) { U32(static_cast<uint32_t>(text.size())); Bytes(text.data(), text.size()); }
+	};
+}
+
+uint64_t GraphicsPipelineDesc::Hash() const
+{
+	Hasher hasher;
+	hasher.String(VertexShader);
+	hasher.String(FragmentShader);
+	hasher.U32(static_cast<uint32_t>(Bindings.size()));
+	for (auto& binding : Bindings)
+	{
+		hasher.U32(binding.binding);
+		hasher.U32(binding.stride);
+		hasher.U32(static_cast<uint32_t>(binding.inputRate));
+	}
+	hasher.U32(static_cast<uint32_t>(Attributes.size()));
+	for (auto& attribute : Attributes)
+	{
+		hasher.U32(attribute.location);
+		hasher.U32(attribute.binding);
+		hasher.U32(static_cast<uint32_t>(attribute.format));
+		hasher.U32(attribute.offset);
+	}
+	hasher.U32(static_cast<uint32_t>(PushConstantRanges.size()));
+	for (auto& range : PushConstantRanges)
+	{
+		hasher.U32(static_cast<uint32_t>(range.stageFlags));
+		hasher.U32(range.offset);
+		hasher.U32(range.size);
+	}
+	hasher.U32(static_cast<uint32_t>(Topology));
+	hasher.U32(static_cast<uint32_t>(PolygonMode));
+	hasher.U32(static_cast<uint32_t>(CullMode));
+	hasher.U32(static_cast<uint32_t>(FrontFace));
+	hasher.U32(BlendEnable);
+	hasher.U32(static_cast<uint32_t>(ColorFormat));
+	hasher.U32(Subpass);
+	return hasher.Value;
+}
+
+std::string GraphicsPipelineDesc::Serialize() const
+{
+	std::ostringstream out;
+	out << VertexShader << ' ' << FragmentShader << ' '
+		<< static_cast<uint32_t>(Topology) << ' '
+		<< static_cast<uint32_t>(PolygonMode) << ' '
+		<< static_cast<uint32_t>(CullMode) << ' '
+		<< static_cast<uint32_t>(FrontFace) << ' '
+		<< BlendEnable << ' '
+		<< static_cast<uint32_t>(ColorFormat) << ' '
+		<< Subpass << ' ' << Bindings.size();
+	for (auto& binding : Bindings)
+	{
+		out << ' ' << binding.binding << ' ' << binding.stride << ' ' << static_cast<uint32_t>(binding.inputRate);
+	}
+	out << ' ' << Attributes.size();
+	for (auto& attribute : Attributes)
+	{
+		out << ' ' << attribute.location << ' ' << attribute.binding << ' ' << static_cast<uint32_t>(attribute.format) << ' ' << attribute.offset;
+	}
+	out << ' ' << PushConstantRanges.size();
+	for (auto& range : PushConstantRanges)
+	{
+		out << ' ' << static_cast<uint32_t>(range.stageFlags) << ' ' << range.offset << ' ' << range.size;
+	}
+	return out.str();
+}
+
+bool GraphicsPipelineDesc::Deserialize(const std::string& line, GraphicsPipelineDesc& desc)
+{
+	std::istringstream in(line);
+	uint32_t topology, polygonMode, cullMode, frontFace, blendEnable, colorFormat;
+	size_t bindingCount, attributeCount, rangeCount;
+	if (!(in >> desc.VertexShader >> desc.FragmentShader >> topology >> polygonMode >> cullMode >> frontFace >> blendEnable >> colorFormat >> desc.Subpass >> bindingCount))
+	{
+		return false;
+	}
+	desc.Topology = static_cast<vk::PrimitiveTopology>(topology);
+	desc.PolygonMode = static_cast<vk::PolygonMode>(polygonMode);
+	desc.CullMode = static_cast<vk::CullModeFlags>(cullMode);
+	desc.FrontFace = static_cast<vk::FrontFace>(frontFace);
+	desc.BlendEnable = blendEnable != 0;
+	desc.ColorFormat = static_cast<vk::Format>(colorFormat);
+
+	desc.Bindings.resize(bindingCount);
+	for (auto& binding : desc.Bindings)
+	{
+		uint32_t inputRate;
+		if (!(in >> binding.binding >> binding.stride >> inputRate))
+		{
+			return false;
+		}
+		binding.inputRate = static_cast<vk::VertexInputRate>(inputRate);
+	}
+	if (!(in >> attributeCount))
+	{
+		return false;
+	}
+	desc.Attributes.resize(attributeCount);
+	for (auto& attribute : desc.Attributes)
+	{
+		uint32_t format;
+		if (!(in >> attribute.location >> attribute.binding >> format >> attribute.offset))
+		{
+			return false;
+		}
+		attribute.format = static_cast<vk::Format>(format);
+	}
+	//lists written before push constants were recorded end here and are dropped
+	if (!(in >> rangeCount))
+	{
+		return false;
+	}
+	desc.PushConstantRanges.resize(rangeCount);
+	for (auto& range : desc.PushConstantRanges)
+	{
+		uint32_t stageFlags;
+		if (!(in >> stageFlags >> range.offset >> range.size))
+		{
+			return false;
+		}
+		range.stageFlags = static_cast<vk::ShaderStageFlags>(stageFlags);
+	}
+	return true;
+}
+
+void PipelineRegistry::Init(vk::Device device, PipelineCache* cache, vk::PipelineLayout layout, vk::RenderPass renderPass, bool creationFeedback)
+{
+	m_Device = device;
+	m_Cache = cache;
+	m_Layout = layout;
+	m_RenderPass = renderPass;
+	m_CreationFeedback = creationFeedback;
+	m_Workers = std::make_unique<ThreadPool>();
+}
+
+void PipelineRegistry::Destroy()
+{
+	WaitIdle();
+	m_Workers.reset();
+	for (auto& [key, entry] : m_Entries)
+	{
+		if (entry.Pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::deferred)
+		{
+			continue;
+		}
+		try
+		{
+			m_Device.destroyPipeline(entry.Pipeline.get());
+		}
+		catch (const std::exception&)
+		{
+			//a failed compile left nothing to destroy
+		}
+	}
+	m_Entries.clear();
+	for (auto& [path, module] : m_ShaderModules)
+	{
+		m_Device.destroyShaderModule(module);
+	}
+	m_ShaderModules.clear();
+}
+
+uint64_t PipelineRegistry::Request(const GraphicsPipelineDesc& desc)
+{
+	uint64_t key = desc.Hash();
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_Entries.find(key) == m_Entries.end())
+	{
+		Entry entry;
+		entry.Desc = desc;
+		entry.Pipeline = m_Workers->Submit([this, desc] { return Compile(desc); }).share();
+		m_Entries.emplace(key, std::move(entry));
+	}
+	return key;
+}
+
+vk::Pipeline PipelineRegistry::Get(const GraphicsPipelineDesc& desc)
+{
+	uint64_t key = desc.Hash();
+	std::shared_future<vk::Pipeline> pipeline;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Entries.find(key);
+		if (it == m_Entries.end())
+		{
+			//deferred: the first get() below compiles on this thread
+			Entry entry;
+			entry.Desc = desc;
+			entry.Pipeline = std::async(std::launch::deferred, [this, desc] { return Compile(desc); }).share();
+			it = m_Entries.emplace(key, std::move(entry)).first;
+		}
+		it->second.Used = true;
+		pipeline = it->second.Pipeline;
+	}
+	return pipeline.get();
+}
+
+vk::Pipeline PipelineRegistry::Get(uint64_t key)
+{
+	std::shared_future<vk::Pipeline> pipeline;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Entries.find(key);
+		if (it == m_Entries.end())
+		{
+			throw std::runtime_error("unknown pipeline key!");
+		}
+		it->second.Used = true;
+		pipeline = it->second.Pipeline;
+	}
+	return pipeline.get();
+}
+
+void PipelineRegistry::WaitIdle()
+{
+	std::vector<std::shared_future<vk::Pipeline>> pending;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& [key, entry] : m_Entries)
+		{
+			pending.push_back(entry.Pipeline);
+		}
+	}
+	for (auto& pipeline : pending)
+	{
+		//deferred entries only compile when their owner calls Get
+		if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::deferred)
+		{
+			pipeline.wait();
+		}
+	}
+}
+
+void PipelineRegistry::LoadWarmupList(const std::string& path, vk::Format colorFormat, const std::vector<vk::PushConstantRange>& pushConstantRanges)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		return;
+	}
+	uint32_t requested = 0;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		GraphicsPipelineDesc desc;
+		if (!GraphicsPipelineDesc::Deserialize(line, desc) || desc.ColorFormat != colorFormat || desc.PushConstantRanges != pushConstantRanges)
+		{
+			continue;
+		}
+		Request(desc);
+		requested++;
+	}
+	std::cout << "pipeline registry: warming up " << requested << " pipelines from " << path << std::endl;
+}
+
+void PipelineRegistry::SaveWarmupList(const std::string& path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "pipeline registry: failed to write " << path << std::endl;
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (auto& [key, entry] : m_Entries)
+	{
+		if (entry.Used)
+		{
+			file << entry.Desc.Serialize() << '\n';
+		}
+	}
+}
+
+vk::ShaderModule PipelineRegistry::GetShaderModule(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_ShaderMutex);
+	auto it = m_ShaderModules.find(path);
+	if (it != m_ShaderModules.end())
+	{
+		return it->second;
+	}
+
+	std::vector<char> sourceCode = ReadFile(path);
+	vk::ShaderModuleCreateInfo shaderModuleInfo{};
+	shaderModuleInfo.sType = vk::StructureType::eShaderModuleCreateInfo;
+	shaderModuleInfo.setPCode(reinterpret_cast<const uint32_t*>(sourceCode.data()))
+			        .setCodeSize(sourceCode.size());
+
+	vk::ShaderModule shaderModule;
+	if (m_Device.createShaderModule(&shaderModuleInfo, nullptr, &shaderModule) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create shader module!");
+	}
+	m_ShaderModules.emplace(path, shaderModule);
+	return shaderModule;
+}
+
+vk::Pipeline PipelineRegistry::Compile(const GraphicsPipelineDesc& desc)
+{
+	#pragma region shader
+	vk::PipelineShaderStageCreateInfo vertexShaderInfo{};
+	vertexShaderInfo.sType = vk::StructureType::ePipelineShaderStageCreateInfo;
+	vertexShaderInfo.setStage(vk::ShaderStageFlagBits::eVertex)
+					.setModule(GetShaderModule(desc.VertexShader))
+					.setPName("main");
+
+	vk::PipelineShaderStageCreateInfo fragmentShaderInfo{};
+	fragmentShaderInfo.sType = vk::StructureType::ePipelineShaderStageCreateInfo;
+	fragmentShaderInfo.setStage(vk::ShaderStageFlagBits::eFragment)
+					  .setModule(GetShaderModule(desc.FragmentShader))
+					  .setPName("main");
+
+	vk::PipelineShaderStageCreateInfo shaderStages[] = { vertexShaderInfo, fragmentShaderInfo };
+	#pragma endregion
+
+	#pragma region vertexInput
+	vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = vk::StructureType::ePipelineVertexInputStateCreateInfo;
+	vertexInputInfo.setVertexBindingDescriptionCount(static_cast<uint32_t>(desc.Bindings.size()))
+				   .setPVertexBindingDescriptions(desc.Bindings.data())
+				   .setVertexAttributeDescriptionCount(static_cast<uint32_t>(desc.Attributes.size()))
+				   .setPVertexAttributeDescriptions(desc.Attributes.data());
+	#pragma endregion
+
+	#pragma region inputAssembly
+	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo{};
+	inputAssemblyInfo.sType = vk::StructureType::ePipelineInputAssemblyStateCreateInfo;
+	inputAssemblyInfo.setTopology(desc.Topology)
+			         .setPrimitiveRestartEnable(VK_FALSE);
+	#pragma endregion
+
+	#pragma region viewport
+	vk::PipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = vk::StructureType::ePipelineViewportStateCreateInfo;
+	viewportInfo.setViewportCount(1)
+			    .setScissorCount(1);
+	#pragma endregion
+
+	#pragma region rasterizer
+	vk::PipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = vk::StructureType::ePipelineRasterizationStateCreateInfo;
+	rasterizer.setDepthClampEnable(VK_FALSE)
+			  .setRasterizerDiscardEnable(VK_FALSE)
+			  .setPolygonMode(desc.PolygonMode)
+			  .setLineWidth(1.0f)
+			  .setCullMode(desc.CullMode)
+			  .setFrontFace(desc.FrontFace)
+			  .setDepthBiasEnable(VK_FALSE);
+	#pragma endregion
+
+	#pragma region multisamples
+	vk::PipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = vk::StructureType::ePipelineMultisampleStateCreateInfo;
+	multisampling.setSampleShadingEnable(VK_FALSE)
+				 .setRasterizationSamples(vk::SampleCountFlagBits::e1);
+	#pragma endregion
+
+	#pragma region blending
+	vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA)
+						.setBlendEnable(desc.BlendEnable)
+						.setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+						.setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+						.setColorBlendOp(vk::BlendOp::eAdd)
+						.setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+						.setDstAlphaBlendFactor(vk::BlendFactor::eZero)
+						.setAlphaBlendOp(vk::BlendOp::eAdd);
+
+	std::array<float, 4> blendConstants = { 0.0f, 0.0f, 0.0f, 0.0f };
+	vk::PipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = vk::StructureType::ePipelineColorBlendStateCreateInfo;
+	colorBlending.setLogicOpEnable(VK_FALSE)
+				 .setLogicOp(vk::LogicOp::eCopy)
+				 .setAttachmentCount(1)
+				 .setPAttachments(&colorBlendAttachment)
+				 .setBlendConstants(blendConstants);
+	#pragma endregion
+
+	#pragma region dynamicState
+	std::vector<vk::DynamicState> dynamicStates = {
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor
+	};
+	vk::PipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = vk::StructureType::ePipelineDynamicStateCreateInfo;
+	dynamicState.setDynamicStateCount(dynamicStates.size())
+		        .setPDynamicStates(dynamicStates.data());
+	#pragma endregion
+
+	#pragma region pipeline
+	vk::GraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = vk::StructureType::eGraphicsPipelineCreateInfo;
+	pipelineInfo.setStageCount(2)
+				.setPStages(shaderStages)
+				.setPVertexInputState(&vertexInputInfo)
+				.setPInputAssemblyState(&inputAssemblyInfo)
+				.setPViewportState(&viewportInfo)
+				.setPRasterizationState(&rasterizer)
+				.setPMultisampleState(&multisampling)
+				.setPDepthStencilState(nullptr)
+				.setPColorBlendState(&colorBlending)
+				.setPDynamicState(&dynamicState)
+				.setLayout(m_Layout)
+				.setRenderPass(m_RenderPass)
+				.setSubpass(desc.Subpass)
+				.setBasePipelineHandle(VK_NULL_HANDLE)
+				.setBasePipelineIndex(-1);
+
+	//creation feedback is core in 1.3 and tells whether the pipeline came out of the cache
+	vk::PipelineCreationFeedback pipelineFeedback{};
+	vk::PipelineCreationFeedback stageFeedbacks[2]{};
+	vk::PipelineCreationFeedbackCreateInfo feedbackInfo{};
+	feedbackInfo.sType = vk::StructureType::ePipelineCreationFeedbackCreateInfo;
+	feedbackInfo.setPPipelineCreationFeedback(&pipelineFeedback)
+				.setPipelineStageCreationFeedbackCount(2)
+				.setPPipelineStageCreationFeedbacks(stageFeedbacks);
+	if (m_CreationFeedback)
+	{
+		pipelineInfo.setPNext(&feedbackInfo);
+	}
+
+	vk::PipelineRenderingCreateInfo renderingInfo{};
+	renderingInfo.sType = vk::StructureType::ePipelineRenderingCreateInfo;
+	renderingInfo.setColorAttachmentCount(1)
+				 .setPColorAttachmentFormats(&desc.ColorFormat);
+	if (!m_RenderPass)
+	{
+		renderingInfo.setPNext(pipelineInfo.pNext);
+		pipelineInfo.setPNext(&renderingInfo);
+	}
+
+	vk::Pipeline pipeline;
+	auto startTime = std::chrono::high_resolution_clock::now();
+	if (m_Device.createGraphicsPipelines(m_Cache->Get(), 1, &pipelineInfo, nullptr, &pipeline) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create graphics pipeline!");
+	}
+	m_Cache->RecordCreation(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count(), pipelineFeedback);
+	#pragma endregion
+
+	return pipeline;
+}
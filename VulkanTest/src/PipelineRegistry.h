@@ -0,0 +1,87 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <unordered_map>
+#include "PipelineCache.h"
+#include "../utils/ThreadPool.h"
+
+//everything that makes two graphics pipelines different, the registry key is Hash() of it
+struct GraphicsPipelineDesc
+{
+	std::string VertexShader;
+	std::string FragmentShader;
+	std::vector<vk::VertexInputBindingDescription> Bindings;
+	std::vector<vk::VertexInputAttributeDescription> Attributes;
+	//the pipeline layout's push constant ranges, a pipeline only runs with a layout that has the same ones
+	std::vector<vk::PushConstantRange> PushConstantRanges;
+	vk::PrimitiveTopology Topology = vk::PrimitiveTopology::eTriangleList;
+	vk::PolygonMode PolygonMode = vk::PolygonMode::eFill;
+	vk::CullModeFlags CullMode = vk::CullModeFlagBits::eBack;
+	vk::FrontFace FrontFace = vk::FrontFace::eCounterClockwise;
+	bool BlendEnable = false;
+	//render pass compatibility only depends on the attachment formats and the subpass
+	vk::Format ColorFormat = vk::Format::eUndefined;
+	uint32_t Subpass = 0;
+
+	//fills Bindings/Attributes from a compile-time VertexLayout
+	template<typename Layout>
+	void SetVertexLayout()
+	{
+		Bindings.assign(Layout::Bindings.begin(), Layout::Bindings.end());
+		Attributes.assign(Layout::Attributes.begin(), Layout::Attributes.end());
+	}
+
+	uint64_t Hash() const;
+	std::string Serialize() const;
+	static bool Deserialize(const std::string& line, GraphicsPipelineDesc& desc);
+};
+
+class PipelineRegistry
+{
+public:
+	//a null renderPass builds pipelines for dynamic rendering against desc.ColorFormat instead
+	void Init(vk::Device device, PipelineCache* cache, vk::PipelineLayout layout, vk::RenderPass renderPass, bool creationFeedback);
+	void Destroy();
+
+	//queue a compile on the worker pool and return right away
+	uint64_t Request(const GraphicsPipelineDesc& desc);
+	//the pipeline for desc, compiled on the calling thread if nobody requested it yet
+	vk::Pipeline Get(const GraphicsPipelineDesc& desc);
+	//same as above for a key returned by Request, skips hashing the description again
+	vk::Pipeline Get(uint64_t key);
+	void WaitIdle();
+
+	//precompile the permutations a previous run used, skipping ones built for other attachment formats or push constants
+	void LoadWarmupList(const std::string& path, vk::Format colorFormat, const std::vector<vk::PushConstantRange>& pushConstantRanges);
+	//writes the permutations this run drew with, warmed up ones it never used are dropped
+	void SaveWarmupList(const std::string& path);
+
+private:
+	vk::Pipeline Compile(const GraphicsPipelineDesc& desc);
+	vk::ShaderModule GetShaderModule(const std::string& path);
+
+	struct Entry
+	{
+		GraphicsPipelineDesc Desc;
+		std::shared_future<vk::Pipeline> Pipeline;
+		//set by Get
+		bool Used = false;
+	};
+
+private:
+	vk::Device m_Device;
+	PipelineCache* m_Cache = nullptr;
+	vk::PipelineLayout m_Layout;
+	vk::RenderPass m_RenderPass;
+	bool m_CreationFeedback = false;
+
+	std::unique_ptr<ThreadPool> m_Workers;
+	std::mutex m_Mutex;
+	std::unordered_map<uint64_t, Entry> m_Entries;
+	std::mutex m_ShaderMutex;
+	std::unordered_map<std::string, vk::ShaderModule> m_ShaderModules;
+};
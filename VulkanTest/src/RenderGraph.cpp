@@ -0,0 +1,507 @@
+#include <iostream>
+#include <algorithm>
+
+#include "RenderGraph.h"
+
+namespace
+{
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool LifetimesOverlap(uint32_t firstA, uint32_t lastA, uint32_t firstB, uint32_t lastB)
+	{
+		return firstA <= lastB && firstB <= lastA;
+	}
+
+	vk::ImageAspectFlags GetAspect(vk::ImageUsageFlags usage)
+	{
+		return (usage & vk::ImageUsageFlagBits::eDepthStencilAttachment) ? vk::ImageAspectFlagBits::eDepth : vk::ImageAspectFlagBits::eColor;
+	}
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(ImageHandle image, ImageUsage usage)
+{
+	m_Graph->m_Passes[m_Pass].Accesses.push_back({ image, usage });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(ImageHandle image, ImageUsage usage)
+{
+	if (!GetUsageInfo(usage).Write)
+	{
+		throw std::runtime_error("render graph: usage is not a write!");
+	}
+	m_Graph->m_Passes[m_Pass].Accesses.push_back({ image, usage });
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::SideEffect()
+{
+	m_Graph->m_Passes[m_Pass].SideEffect = true;
+	return *this;
+}
+
+RenderGraph::UsageInfo RenderGraph::GetUsageInfo(ImageUsage usage)
+{
+	switch (usage)
+	{
+	case ImageUsage::ColorAttachment:
+		return { vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+			vk::ImageLayout::eColorAttachmentOptimal, vk::ImageUsageFlagBits::eColorAttachment, true };
+	case ImageUsage::DepthAttachment:
+		return { vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+			vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment, true };
+	case ImageUsage::Sampled:
+		return { vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderRead,
+			vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageUsageFlagBits::eSampled, false };
+	case ImageUsage::TransferSrc:
+		return { vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead,
+			vk::ImageLayout::eTransferSrcOptimal, vk::ImageUsageFlagBits::eTransferSrc, false };
+	case ImageUsage::TransferDst:
+		return { vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+			vk::ImageLayout::eTransferDstOptimal, vk::ImageUsageFlagBits::eTransferDst, true };
+	case ImageUsage::Present:
+		//the present engine waits on a semaphore, there is nothing to make visible
+		return { vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+			vk::ImageLayout::ePresentSrcKHR, vk::ImageUsageFlags(), false };
+	}
+	throw std::runtime_error("render graph: unknown image usage!");
+}
+
+ImageHandle RenderGraph::ImportImage(const std::string& name, vk::Format format, vk::Extent2D extent, vk::ImageLayout initialLayout,
+	vk::PipelineStageFlags2 readyStages, ImageUsage finalUsage)
+{
+	ImageResource resource;
+	resource.Name = name;
+	resource.Format = format;
+	resource.Extent = extent;
+	resource.Imported = true;
+	resource.InitialLayout = initialLayout;
+	resource.ReadyStages = readyStages;
+	resource.FinalUsage = finalUsage;
+	m_Images.push_back(resource);
+	return static_cast<ImageHandle>(m_Images.size() - 1);
+}
+
+ImageHandle RenderGraph::CreateTransientImage(const std::string& name, vk::Format format, vk::Extent2D extent)
+{
+	ImageResource resource;
+	resource.Name = name;
+	resource.Format = format;
+	resource.Extent = extent;
+	m_Images.push_back(resource);
+	return static_cast<ImageHandle>(m_Images.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const std::string& name, ExecuteFunction execute)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Execute = std::move(execute);
+	m_Passes.push_back(std::move(pass));
+	return PassBuilder(this, static_cast<uint32_t>(m_Passes.size() - 1));
+}
+
+void RenderGraph::Compile(vk::Device device, MemoryAllocator* allocator, bool synchronization2)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_Synchronization2 = synchronization2;
+	CullPasses();
+	CreateTransientImages();
+	PlaceBarriers();
+}
+
+void RenderGraph::CullPasses()
+{
+	//walk backwards: a pass lives if it has side effects, writes something that outlives the frame,
+	//or writes an image a living pass after it reads
+	std::vector<bool> needed(m_Images.size(), false);
+	for (size_t i = m_Passes.size(); i-- > 0;)
+	{
+		Pass& pass = m_Passes[i];
+		pass.Alive = pass.SideEffect;
+		for (auto& access : pass.Accesses)
+		{
+			if (GetUsageInfo(access.Usage).Write && (m_Images[access.Image].Imported || needed[access.Image]))
+			{
+				pass.Alive = true;
+			}
+		}
+		if (!pass.Alive)
+		{
+			continue;
+		}
+		for (auto& access : pass.Accesses)
+		{
+			if (!GetUsageInfo(access.Usage).Write)
+			{
+				needed[access.Image] = true;
+			}
+		}
+	}
+
+	for (auto& image : m_Images)
+	{
+		image.FirstPass = ~0u;
+		image.LastPass = 0;
+		image.UsageFlags = image.Imported ? GetUsageInfo(image.FinalUsage).UsageFlags : vk::ImageUsageFlags();
+	}
+	for (uint32_t i = 0; i < m_Passes.size(); i++)
+	{
+		if (!m_Passes[i].Alive)
+		{
+			continue;
+		}
+		for (auto& access : m_Passes[i].Accesses)
+		{
+			ImageResource& image = m_Images[access.Image];
+			image.FirstPass = (std::min)(image.FirstPass, i);
+			image.LastPass = (std::max)(image.LastPass, i);
+			image.UsageFlags |= GetUsageInfo(access.Usage).UsageFlags;
+		}
+	}
+}
+
+void RenderGraph::CreateTransientImages()
+{
+	std::vector<uint32_t> heapImages;
+	vk::MemoryRequirements heapRequirements{};
+	heapRequirements.alignment = 1;
+	heapRequirements.memoryTypeBits = ~0u;
+	m_UnaliasedSize = 0;
+
+	for (uint32_t i = 0; i < m_Images.size(); i++)
+	{
+		ImageResource& resource = m_Images[i];
+		if (resource.Imported || resource.FirstPass == ~0u)
+		{
+			continue;
+		}
+
+		vk::ImageCreateInfo imageInfo{};
+		imageInfo.sType = vk::StructureType::eImageCreateInfo;
+		imageInfo.setArrayLayers(1)
+				 .setExtent(vk::Extent3D(resource.Extent.width, resource.Extent.height, 1))
+				 .setFormat(resource.Format)
+				 .setImageType(vk::ImageType::e2D)
+				 .setInitialLayout(vk::ImageLayout::eUndefined)
+				 .setMipLevels(1)
+				 .setSamples(vk::SampleCountFlagBits::e1)
+				 .setSharingMode(vk::SharingMode::eExclusive)
+				 .setTiling(vk::ImageTiling::eOptimal)
+				 .setUsage(resource.UsageFlags);
+		if (m_Device.createImage(&imageInfo, nullptr, &resource.Image) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("render graph: failed to create transient image!");
+		}
+
+		vk::ImageMemoryRequirementsInfo2 requirementsInfo{};
+		requirementsInfo.sType = vk::StructureType::eImageMemoryRequirementsInfo2;
+		requirementsInfo.setImage(resource.Image);
+		vk::MemoryDedicatedRequirements dedicatedRequirements{};
+		vk::MemoryRequirements2 requirements{};
+		requirements.setPNext(&dedicatedRequirements);
+		m_Device.getImageMemoryRequirements2(&requirementsInfo, &requirements);
+		const vk::MemoryRequirements& memory = requirements.memoryRequirements;
+		resource.Size = memory.size;
+
+		//images that must own their memory, or whose memory types do not overlap the heap's, are allocated on their own
+		if (dedicatedRequirements.requiresDedicatedAllocation || !(heapRequirements.memoryTypeBits & memory.memoryTypeBits))
+		{
+			AllocationCreateInfo allocationInfo{};
+			allocationInfo.Properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+			resource.Memory = m_Allocator->AllocateForImage(resource.Image, vk::ImageTiling::eOptimal, allocationInfo);
+			m_Device.bindImageMemory(resource.Image, resource.Memory.Memory, resource.Memory.Offset);
+			continue;
+		}
+		m_UnaliasedSize += memory.size;
+		heapRequirements.memoryTypeBits &= memory.memoryTypeBits;
+		heapRequirements.alignment = (std::max)(heapRequirements.alignment, memory.alignment);
+		resource.InHeap = true;
+		heapImages.push_back(i);
+	}
+
+	//largest first, each image goes to the lowest offset that does not collide with an image alive at the same time
+	std::sort(heapImages.begin(), heapImages.end(), [this](uint32_t a, uint32_t b) { return m_Images[a].Size > m_Images[b].Size; });
+	std::vector<uint32_t> placed;
+	m_HeapSize = 0;
+	for (uint32_t index : heapImages)
+	{
+		ImageResource& resource = m_Images[index];
+		std::vector<vk::DeviceSize> candidates = { 0 };
+		for (uint32_t other : placed)
+		{
+			const ImageResource& placedImage = m_Images[other];
+			if (LifetimesOverlap(resource.FirstPass, resource.LastPass, placedImage.FirstPass, placedImage.LastPass))
+			{
+				candidates.push_back(AlignUp(placedImage.HeapOffset + placedImage.Size, heapRequirements.alignment));
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+		for (vk::DeviceSize offset : candidates)
+		{
+			bool fits = true;
+			for (uint32_t other : placed)
+			{
+				const ImageResource& placedImage = m_Images[other];
+				bool memoryOverlaps = offset < placedImage.HeapOffset + placedImage.Size && placedImage.HeapOffset < offset + resource.Size;
+				if (memoryOverlaps && LifetimesOverlap(resource.FirstPass, resource.LastPass, placedImage.FirstPass, placedImage.LastPass))
+				{
+					fits = false;
+					break;
+				}
+			}
+			if (fits)
+			{
+				resource.HeapOffset = offset;
+				break;
+			}
+		}
+		placed.push_back(index);
+		m_HeapSize = (std::max)(m_HeapSize, resource.HeapOffset + resource.Size);
+	}
+
+	//the memory a transient image takes over was last used by the most recent earlier image in the same range
+	for (uint32_t index : heapImages)
+	{
+		ImageResource& resource = m_Images[index];
+		for (uint32_t other : heapImages)
+		{
+			const ImageResource& previous = m_Images[other];
+			bool memoryOverlaps = resource.HeapOffset < previous.HeapOffset + previous.Size && previous.HeapOffset < resource.HeapOffset + resource.Size;
+			if (other != index && memoryOverlaps && previous.LastPass < resource.FirstPass &&
+				(resource.AliasOf == ~0u || previous.LastPass > m_Images[resource.AliasOf].LastPass))
+			{
+				resource.AliasOf = other;
+			}
+		}
+	}
+
+	if (!heapImages.empty())
+	{
+		heapRequirements.size = m_HeapSize;
+		AllocationCreateInfo allocationInfo{};
+		allocationInfo.Properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+		m_Heap = m_Allocator->AllocateForRequirements(heapRequirements, true, allocationInfo);
+		for (uint32_t index : heapImages)
+		{
+			ImageResource& resource = m_Images[index];
+			m_Device.bindImageMemory(resource.Image, m_Heap.Memory, m_Heap.Offset + resource.HeapOffset);
+		}
+	}
+
+	for (auto& resource : m_Images)
+	{
+		if (resource.Imported || !resource.Image)
+		{
+			continue;
+		}
+		vk::ImageSubresourceRange range{};
+		range.setAspectMask(GetAspect(resource.UsageFlags))
+			 .setBaseArrayLayer(0)
+			 .setBaseMipLevel(0)
+			 .setLayerCount(1)
+			 .setLevelCount(1);
+		vk::ImageViewCreateInfo viewInfo{};
+		viewInfo.sType = vk::StructureType::eImageViewCreateInfo;
+		viewInfo.setImage(resource.Image)
+				.setViewType(vk::ImageViewType::e2D)
+				.setFormat(resource.Format)
+				.setComponents(vk::ComponentMapping())
+				.setSubresourceRange(range);
+		if (m_Device.createImageView(&viewInfo, nullptr, &resource.View) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("render graph: failed to create transient image view!");
+		}
+	}
+}
+
+void RenderGraph::PlaceBarriers()
+{
+	//what the frame has done to each image so far
+	struct State
+	{
+		vk::ImageLayout Layout;
+		//stages of the last write (or layout transition) and the reads since then
+		vk::PipelineStageFlags2 WriteStages;
+		vk::AccessFlags2 WriteAccess;
+		vk::PipelineStageFlags2 ReadStages;
+		//stages the last write has already been made visible to
+		vk::PipelineStageFlags2 VisibleStages;
+	};
+	std::vector<State> states(m_Images.size());
+	for (uint32_t i = 0; i < m_Images.size(); i++)
+	{
+		states[i].Layout = m_Images[i].Imported ? m_Images[i].InitialLayout : vk::ImageLayout::eUndefined;
+		states[i].WriteStages = m_Images[i].ReadyStages;
+	}
+
+	//the image itself is patched in by Execute, every barrier carries its own stages
+	auto addBarrier = [this](BarrierBatch& batch, ImageHandle handle, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+		vk::PipelineStageFlags2 srcStages, vk::AccessFlags2 srcAccess, vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess)
+	{
+		vk::ImageSubresourceRange range{};
+		range.setAspectMask(GetAspect(m_Images[handle].UsageFlags))
+			 .setBaseArrayLayer(0)
+			 .setBaseMipLevel(0)
+			 .setLayerCount(1)
+			 .setLevelCount(1);
+		batch.Image(vk::Image(), range, oldLayout, newLayout, srcStages, srcAccess, dstStages, dstAccess);
+	};
+
+	for (uint32_t passIndex = 0; passIndex < m_Passes.size(); passIndex++)
+	{
+		Pass& pass = m_Passes[passIndex];
+		pass.Barriers.Clear();
+		pass.BarrierImages.clear();
+		if (!pass.Alive)
+		{
+			continue;
+		}
+
+		for (auto& access : pass.Accesses)
+		{
+			ImageResource& image = m_Images[access.Image];
+			State& state = states[access.Image];
+			UsageInfo usage = GetUsageInfo(access.Usage);
+
+			//first touch of an aliased image: wait for whoever used the memory before, contents are discarded anyway
+			if (image.FirstPass == passIndex && image.AliasOf != ~0u)
+			{
+				const State& previous = states[image.AliasOf];
+				state.WriteStages = previous.WriteStages | previous.ReadStages;
+				state.WriteAccess = previous.WriteAccess;
+			}
+
+			bool transition = state.Layout != usage.Layout;
+			bool hazard = usage.Write ? static_cast<bool>(state.WriteStages | state.ReadStages) :
+				static_cast<bool>(state.WriteStages) && (state.VisibleStages & usage.Stages) != usage.Stages;
+			if (transition || hazard)
+			{
+				vk::PipelineStageFlags2 srcStages = usage.Write || transition ? state.WriteStages | state.ReadStages : state.WriteStages;
+				addBarrier(pass.Barriers, access.Image, state.Layout, usage.Layout, srcStages, state.WriteAccess, usage.Stages, usage.Access);
+				pass.BarrierImages.push_back(access.Image);
+			}
+
+			if (usage.Write || transition)
+			{
+				//a layout transition counts as a write that is only visible to this barrier's destination
+				state.Layout = usage.Layout;
+				state.WriteStages = usage.Stages;
+				state.WriteAccess = usage.Write ? usage.Access : vk::AccessFlags2();
+				state.ReadStages = {};
+				state.VisibleStages = usage.Write ? vk::PipelineStageFlags2() : usage.Stages;
+			}
+			if (!usage.Write)
+			{
+				state.ReadStages |= usage.Stages;
+				state.VisibleStages |= usage.Stages;
+			}
+		}
+	}
+
+	m_FinalBarriers.Clear();
+	m_FinalBarrierImages.clear();
+	for (uint32_t i = 0; i < m_Images.size(); i++)
+	{
+		if (!m_Images[i].Imported)
+		{
+			continue;
+		}
+		const State& state = states[i];
+		UsageInfo usage = GetUsageInfo(m_Images[i].FinalUsage);
+		if (state.Layout == usage.Layout && !state.WriteAccess)
+		{
+			continue;
+		}
+		addBarrier(m_FinalBarriers, i, state.Layout, usage.Layout, state.WriteStages | state.ReadStages, state.WriteAccess, usage.Stages, usage.Access);
+		m_FinalBarrierImages.push_back(i);
+	}
+}
+
+void RenderGraph::SetImportedImage(ImageHandle handle, vk::Image image, vk::ImageView view)
+{
+	m_Images[handle].Image = image;
+	m_Images[handle].View = view;
+}
+
+void RenderGraph::Execute(vk::CommandBuffer commandBuffer)
+{
+	auto recordBarriers = [&](BarrierBatch& barriers, const std::vector<ImageHandle>& images)
+	{
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			barriers.Images()[i].setImage(m_Images[images[i]].Image);
+		}
+		barriers.Record(commandBuffer, m_Synchronization2);
+	};
+
+	for (auto& pass : m_Passes)
+	{
+		if (!pass.Alive)
+		{
+			continue;
+		}
+		recordBarriers(pass.Barriers, pass.BarrierImages);
+		pass.Execute(commandBuffer);
+	}
+	recordBarriers(m_FinalBarriers, m_FinalBarrierImages);
+}
+
+void RenderGraph::Reset()
+{
+	for (auto& resource : m_Images)
+	{
+		if (resource.Imported)
+		{
+			continue;
+		}
+		if (resource.View)
+		{
+			m_Device.destroyImageView(resource.View);
+		}
+		if (resource.Image)
+		{
+			m_Device.destroyImage(resource.Image);
+		}
+		if (resource.Memory.Memory)
+		{
+			m_Allocator->Free(resource.Memory);
+		}
+	}
+	if (m_Heap.Memory)
+	{
+		m_Allocator->Free(m_Heap);
+		m_Heap = Allocation();
+	}
+	m_Images.clear();
+	m_Passes.clear();
+	m_FinalBarriers.Clear();
+	m_FinalBarrierImages.clear();
+	m_HeapSize = 0;
+	m_UnaliasedSize = 0;
+}
+
+void RenderGraph::PrintSummary() const
+{
+	uint32_t alive = 0;
+	uint32_t barriers = static_cast<uint32_t>(m_FinalBarrierImages.size());
+	for (auto& pass : m_Passes)
+	{
+		if (pass.Alive)
+		{
+			alive++;
+			barriers += static_cast<uint32_t>(pass.BarrierImages.size());
+		}
+		else
+		{
+			std::cout << "render graph: culled pass " << pass.Name << std::endl;
+		}
+	}
+	std::cout << "render graph: " << alive << "/" << m_Passes.size() << " passes, " << barriers << " image barriers, transient memory "
+			  << m_HeapSize << " bytes aliased from " << m_UnaliasedSize << std::endl;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "BarrierBatch.h"
+
+//how a pass touches an image, each one maps to a fixed stage, access mask and layout
+enum class ImageUsage
+{
+	ColorAttachment,
+	DepthAttachment,
+	Sampled,
+	TransferSrc,
+	TransferDst,
+	//only valid as the final usage of an imported image
+	Present
+};
+
+using ImageHandle = uint32_t;
+
+//a frame described as passes that declare what they read and write. Compile() culls passes nothing
+//depends on, places every barrier and packs the transient images into one aliased heap
+class RenderGraph
+{
+public:
+	using ExecuteFunction = std::function<void(vk::CommandBuffer commandBuffer)>;
+
+	class PassBuilder
+	{
+	public:
+		PassBuilder& Read(ImageHandle image, ImageUsage usage);
+		PassBuilder& Write(ImageHandle image, ImageUsage usage);
+		//keep the pass even when none of its outputs are read, e.g. it writes to a buffer read back on the host
+		PassBuilder& SideEffect();
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph* graph, uint32_t pass) : m_Graph(graph), m_Pass(pass) {}
+		RenderGraph* m_Graph;
+		uint32_t m_Pass;
+	};
+
+	//an image owned outside the graph (swapchain, offscreen target). it is in initialLayout when the frame starts and
+	//usable from readyStages on (the wait stage of the acquire semaphore), the graph leaves it in finalUsage's layout
+	ImageHandle ImportImage(const std::string& name, vk::Format format, vk::Extent2D extent, vk::ImageLayout initialLayout,
+		vk::PipelineStageFlags2 readyStages, ImageUsage finalUsage);
+	//an image that only lives within the frame, created by Compile() with the union of its declared usages
+	ImageHandle CreateTransientImage(const std::string& name, vk::Format format, vk::Extent2D extent);
+	PassBuilder AddPass(const std::string& name, ExecuteFunction execute);
+
+	//barriers are recorded with vkCmdPipelineBarrier2 when synchronization2 is enabled
+	void Compile(vk::Device device, MemoryAllocator* allocator, bool synchronization2);
+	//point an imported handle at this frame's image before Execute
+	void SetImportedImage(ImageHandle handle, vk::Image image, vk::ImageView view);
+	void Execute(vk::CommandBuffer commandBuffer);
+	//drops passes, resources and the transient heap so the graph can be declared again
+	void Reset();
+
+	vk::Image GetImage(ImageHandle handle) const { return m_Images[handle].Image; }
+	vk::ImageView GetImageView(ImageHandle handle) const { return m_Images[handle].View; }
+	void PrintSummary() const;
+
+private:
+	struct UsageInfo
+	{
+		vk::PipelineStageFlags2 Stages;
+		vk::AccessFlags2 Access;
+		vk::ImageLayout Layout;
+		vk::ImageUsageFlags UsageFlags;
+		bool Write;
+	};
+	static UsageInfo GetUsageInfo(ImageUsage usage);
+
+	struct ImageResource
+	{
+		std::string Name;
+		vk::Format Format;
+		vk::Extent2D Extent;
+		bool Imported = false;
+		vk::ImageLayout InitialLayout = vk::ImageLayout::eUndefined;
+		vk::PipelineStageFlags2 ReadyStages;
+		ImageUsage FinalUsage = ImageUsage::Sampled;
+		vk::ImageUsageFlags UsageFlags;
+
+		vk::Image Image;
+		vk::ImageView View;
+		//transient images either live in the shared heap or, if they cannot alias, in Memory
+		Allocation Memory;
+		bool InHeap = false;
+		vk::DeviceSize HeapOffset = 0;
+		vk::DeviceSize Size = 0;
+		//first and last alive pass touching the image
+		uint32_t FirstPass = ~0u;
+		uint32_t LastPass = 0;
+		//the image whose memory range this one takes over, its last use has to finish before our first
+		uint32_t AliasOf = ~0u;
+	};
+
+	struct ImageAccess
+	{
+		ImageHandle Image;
+		ImageUsage Usage;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		ExecuteFunction Execute;
+		std::vector<ImageAccess> Accesses;
+		bool SideEffect = false;
+		bool Alive = false;
+		//computed by Compile, recorded in front of the pass
+		BarrierBatch Barriers;
+		//imported images change every frame, the handles are patched in right before recording
+		std::vector<ImageHandle> BarrierImages;
+	};
+
+	void CullPasses();
+	void CreateTransientImages();
+	void PlaceBarriers();
+
+private:
+	vk::Device m_Device;
+	MemoryAllocator* m_Allocator = nullptr;
+	bool m_Synchronization2 = false;
+	std::vector<ImageResource> m_Images;
+	std::vector<Pass> m_Passes;
+	Allocation m_Heap;
+	vk::DeviceSize m_HeapSize = 0;
+	vk::DeviceSize m_UnaliasedSize = 0;
+
+	//transitions of imported images into their final layout, recorded after the last pass
+	BarrierBatch m_FinalBarriers;
+	std::vector<ImageHandle> m_FinalBarrierImages;
+};
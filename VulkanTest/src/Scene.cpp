@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <gtc/matrix_transform.hpp>
+
+#include "Scene.h"
+
+namespace
+{
+	glm::vec4 TransformSphere(const glm::mat4& transform, const glm::vec4& sphere)
+	{
+		glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+		//the largest axis scale keeps the sphere conservative under non-uniform scaling
+		float scale = (std::max)({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+		return glm::vec4(center, sphere.w * scale);
+	}
+
+	//Arvo: each output axis takes the smaller/larger of every column's contribution
+	void TransformBox(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, glm::vec3& outMin, glm::vec3& outMax)
+	{
+		outMin = outMax = glm::vec3(transform[3]);
+		for (int column = 0; column < 3; column++)
+		{
+			glm::vec3 a = glm::vec3(transform[column]) * min[column];
+			glm::vec3 b = glm::vec3(transform[column]) * max[column];
+			outMin += glm::min(a, b);
+			outMax += glm::max(a, b);
+		}
+	}
+
+	void WriteInstance(InstanceData& instance, const glm::mat4& transform, uint32_t material)
+	{
+		//glm is column-major, the rows are gathered across the columns
+		instance.Row0 = glm::vec4(transform[0][0], transform[1][0], transform[2][0], transform[3][0]);
+		instance.Row1 = glm::vec4(transform[0][1], transform[1][1], transform[2][1], transform[3][1]);
+		instance.Row2 = glm::vec4(transform[0][2], transform[1][2], transform[2][2], transform[3][2]);
+		instance.Material = material;
+	}
+}
+
+uint32_t Scene::AddMesh(const SceneMesh& mesh)
+{
+	Meshes.push_back(mesh);
+	return static_cast<uint32_t>(Meshes.size() - 1);
+}
+
+uint32_t Scene::AddObject(const glm::mat4& transform, uint32_t mesh, uint32_t material)
+{
+	Transforms.push_back(transform);
+	Spheres.push_back(TransformSphere(transform, Meshes[mesh].Bounds));
+	BoxMins.emplace_back();
+	BoxMaxs.emplace_back();
+	TransformBox(transform, Meshes[mesh].BoxMin, Meshes[mesh].BoxMax, BoxMins.back(), BoxMaxs.back());
+	MeshIds.push_back(mesh);
+	Materials.push_back(material);
+	return GetObjectCount() - 1;
+}
+
+void Scene::SetTransform(uint32_t object, const glm::mat4& transform)
+{
+	Transforms[object] = transform;
+	Spheres[object] = TransformSphere(transform, Meshes[MeshIds[object]].Bounds);
+	TransformBox(transform, Meshes[MeshIds[object]].BoxMin, Meshes[MeshIds[object]].BoxMax, BoxMins[object], BoxMaxs[object]);
+}
+
+glm::vec4 Scene::ComputeBounds() const
+{
+	if (Spheres.empty())
+	{
+		return glm::vec4(0.0f);
+	}
+	glm::vec3 min = glm::vec3(Spheres[0]) - Spheres[0].w;
+	glm::vec3 max = glm::vec3(Spheres[0]) + Spheres[0].w;
+	for (const glm::vec4& sphere : Spheres)
+	{
+		min = glm::min(min, glm::vec3(sphere) - sphere.w);
+		max = glm::max(max, glm::vec3(sphere) + sphere.w);
+	}
+	glm::vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+	for (const glm::vec4& sphere : Spheres)
+	{
+		radius = (std::max)(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+	}
+	return glm::vec4(center, radius);
+}
+
+std::vector<InstanceBatch> Scene::SortIntoBatches()
+{
+	std::vector<uint32_t> order(GetObjectCount());
+	std::iota(order.begin(), order.end(), 0);
+	//stable, objects keep their relative order inside a batch
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+	{
+		return MeshIds[a] != MeshIds[b] ? MeshIds[a] < MeshIds[b] : Materials[a] < Materials[b];
+	});
+
+	auto permute = [&order](auto& field)
+	{
+		std::remove_reference_t<decltype(field)> sorted(field.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			sorted[i] = field[order[i]];
+		}
+		field.swap(sorted);
+	};
+	permute(Transforms);
+	permute(Spheres);
+	permute(BoxMins);
+	permute(BoxMaxs);
+	permute(MeshIds);
+	permute(Materials);
+
+	//every object in its new order
+	std::iota(order.begin(), order.end(), 0);
+	std::vector<InstanceBatch> batches;
+	GatherBatches(order, batches);
+	return batches;
+}
+
+void Scene::WriteInstances(void* destination) const
+{
+	InstanceData* instances = static_cast<InstanceData*>(destination);
+	for (uint32_t object = 0; object < GetObjectCount(); object++)
+	{
+		WriteInstance(instances[object], Transforms[object], Materials[object]);
+	}
+}
+
+void Scene::WriteInstances(void* destination, const std::vector<uint32_t>& objects) const
+{
+	InstanceData* instances = static_cast<InstanceData*>(destination);
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		WriteInstance(instances[i], Transforms[objects[i]], Materials[objects[i]]);
+	}
+}
+
+void Scene::GatherBatches(const std::vector<uint32_t>& objects, std::vector<InstanceBatch>& batches) const
+{
+	batches.clear();
+	for (uint32_t i = 0; i < objects.size(); i++)
+	{
+		uint32_t object = objects[i];
+		if (batches.empty() || batches.back().Mesh != MeshIds[object] || batches.back().Material != Materials[object])
+		{
+			InstanceBatch batch;
+			batch.Mesh = MeshIds[object];
+			batch.Material = Materials[object];
+			batch.FirstInstance = i;
+			batches.push_back(batch);
+		}
+		batches.back().InstanceCount++;
+	}
+}
+
+void Scene::PopulateGrid(uint32_t mesh, uint32_t count, uint32_t materialCount)
+{
+	materialCount = (std::max)(materialCount, 1u);
+	const glm::vec4& bounds = Meshes[mesh].Bounds;
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+	float spacing = (std::max)(bounds.w, 0.01f) * 2.5f;
+	glm::vec3 origin = glm::vec3(static_cast<float>(side - 1) * spacing * -0.5f);
+
+	Transforms.reserve(Transforms.size() + count);
+	Spheres.reserve(Spheres.size() + count);
+	BoxMins.reserve(BoxMins.size() + count);
+	BoxMaxs.reserve(BoxMaxs.size() + count);
+	MeshIds.reserve(MeshIds.size() + count);
+	Materials.reserve(Materials.size() + count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		glm::vec3 cell(static_cast<float>(i % side), static_cast<float>((i / side) % side), static_cast<float>(i / (side * side)));
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), origin + cell * spacing);
+		//a different orientation per object so the grid does not read as one repeated tile, turned about the mesh's centre
+		transform = glm::rotate(transform, static_cast<float>(i) * 0.37f, glm::vec3(0.0f, 0.0f, 1.0f));
+		transform = glm::translate(transform, -glm::vec3(bounds));
+		AddObject(transform, mesh, i % materialCount);
+	}
+}
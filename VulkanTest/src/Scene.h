@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "MeshSimplifier.h"
+
+//a range of the shared vertex and index buffers one object draws
+struct SceneMesh
+{
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+	int32_t VertexOffset = 0;
+	//bounding sphere in the mesh's own space, xyz centre, w radius
+	glm::vec4 Bounds = glm::vec4(0.0f);
+	//axis-aligned box in the mesh's own space
+	glm::vec3 BoxMin = glm::vec3(0.0f);
+	glm::vec3 BoxMax = glm::vec3(0.0f);
+	//simplified levels below the full-detail range, coarser each, indexing the same vertices
+	std::vector<MeshLod> Lods;
+
+	uint32_t GetLodCount() const { return static_cast<uint32_t>(Lods.size()) + 1; }
+	//level 0 is the full-detail range
+	MeshLod GetLod(uint32_t level) const { return level == 0 ? MeshLod{ FirstIndex, IndexCount, 0.0f } : Lods[level - 1]; }
+};
+
+//per-instance vertex stream entry: the object's affine transform as its top three rows, and its material
+struct InstanceData
+{
+	glm::vec4 Row0;
+	glm::vec4 Row1;
+	glm::vec4 Row2;
+	uint32_t Material;
+};
+
+//a run of consecutive objects sharing mesh and material, drawn as one instanced draw
+struct InstanceBatch
+{
+	uint32_t Mesh = 0;
+	uint32_t Material = 0;
+	uint32_t FirstInstance = 0;
+	uint32_t InstanceCount = 0;
+	//level of the mesh the batch draws
+	uint32_t Lod = 0;
+};
+
+//the objects drawn every frame, structure of arrays so culling streams through only the fields it reads
+struct Scene
+{
+	std::vector<SceneMesh> Meshes;
+
+	//per object
+	std::vector<glm::mat4> Transforms;
+	//world-space bounding sphere and box, kept in sync with Transforms
+	std::vector<glm::vec4> Spheres;
+	std::vector<glm::vec3> BoxMins;
+	std::vector<glm::vec3> BoxMaxs;
+	std::vector<uint32_t> MeshIds;
+	std::vector<uint32_t> Materials;
+
+	uint32_t AddMesh(const SceneMesh& mesh);
+	uint32_t AddObject(const glm::mat4& transform, uint32_t mesh, uint32_t material = 0);
+	void SetTransform(uint32_t object, const glm::mat4& transform);
+	uint32_t GetObjectCount() const { return static_cast<uint32_t>(Transforms.size()); }
+	//sphere around every object's sphere
+	glm::vec4 ComputeBounds() const;
+
+	//reorders the objects so equal (mesh, material) pairs are adjacent and returns the runs. object indices change,
+	//afterwards an object's index is also its instance index
+	std::vector<InstanceBatch> SortIntoBatches();
+	//one InstanceData per object in object order, meant to fill mapped staging memory directly
+	void WriteInstances(void* destination) const;
+	//the same for a subset, one InstanceData per entry of objects
+	void WriteInstances(void* destination, const std::vector<uint32_t>& objects) const;
+	//batches over an ascending object list (e.g. what survived culling) after SortIntoBatches, FirstInstance counts
+	//entries of that list
+	void GatherBatches(const std::vector<uint32_t>& objects, std::vector<InstanceBatch>& batches) const;
+
+	//count copies of mesh on a cubic grid centred on the origin, spaced so neighbours never overlap. materials are
+	//handed out round-robin
+	void PopulateGrid(uint32_t mesh, uint32_t count, uint32_t materialCount = 1);
+};
@@ -0,0 +1,573 @@
+#include <iostream>
+#include <cstring>
+
+#include "UploadManager.h"
+
+namespace
+{
+	vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+void UploadManager::Init(vk::Device device, MemoryAllocator* allocator, vk::Queue transferQueue, uint32_t transferFamily,
+	vk::Queue graphicsQueue, uint32_t graphicsFamily, vk::DeviceSize stagingSize, bool timeline, bool synchronization2)
+{
+	m_Device = device;
+	m_Allocator = allocator;
+	m_TransferQueue = transferQueue;
+	m_TransferFamily = transferFamily;
+	m_GraphicsQueue = graphicsQueue;
+	m_GraphicsFamily = graphicsFamily;
+	m_Timeline = timeline;
+	m_Synchronization2 = synchronization2;
+	m_StagingSize = stagingSize;
+
+	vk::CommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = vk::StructureType::eCommandPoolCreateInfo;
+	poolInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+			.setQueueFamilyIndex(m_TransferFamily);
+	if (m_Device.createCommandPool(&poolInfo, nullptr, &m_CommandPool) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+	if (IsDedicatedTransfer())
+	{
+		poolInfo.setQueueFamilyIndex(m_GraphicsFamily);
+		if (m_Device.createCommandPool(&poolInfo, nullptr, &m_AcquirePool) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to create upload acquire command pool!");
+		}
+	}
+
+	if (m_Timeline)
+	{
+		vk::SemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = vk::StructureType::eSemaphoreTypeCreateInfo;
+		typeInfo.setSemaphoreType(vk::SemaphoreType::eTimeline)
+				.setInitialValue(0);
+		vk::SemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = vk::StructureType::eSemaphoreCreateInfo;
+		semaphoreInfo.setPNext(&typeInfo);
+		if (m_Device.createSemaphore(&semaphoreInfo, nullptr, &m_TimelineSemaphore) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to create upload timeline semaphore!");
+		}
+	}
+
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = vk::StructureType::eBufferCreateInfo;
+	bufferInfo.setSize(m_StagingSize)
+			  .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+			  .setSharingMode(vk::SharingMode::eExclusive);
+	if (m_Device.createBuffer(&bufferInfo, nullptr, &m_StagingBuffer) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create staging ring!");
+	}
+	AllocationCreateInfo allocationInfo{};
+	allocationInfo.Properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	m_StagingAllocation = m_Allocator->AllocateForBuffer(m_StagingBuffer, allocationInfo);
+	m_Device.bindBufferMemory(m_StagingBuffer, m_StagingAllocation.Memory, m_StagingAllocation.Offset);
+}
+
+void UploadManager::Destroy()
+{
+	WaitIdle();
+	std::cout << "uploads: " << m_UploadCount << " copies, " << m_UploadedBytes << " bytes in " << m_SubmittedBatches << " submissions" << std::endl;
+
+	if (m_HasOpenBatch)
+	{
+		m_Recycled.push_back(std::move(m_Open));
+		m_HasOpenBatch = false;
+	}
+	for (auto& batch : m_Recycled)
+	{
+		if (batch.Fence)
+		{
+			m_Device.destroyFence(batch.Fence);
+		}
+		if (batch.Handoff)
+		{
+			m_Device.destroySemaphore(batch.Handoff);
+		}
+	}
+	m_Recycled.clear();
+	m_Device.destroyBuffer(m_StagingBuffer);
+	m_Allocator->Free(m_StagingAllocation);
+	if (m_TimelineSemaphore)
+	{
+		m_Device.destroySemaphore(m_TimelineSemaphore);
+	}
+	//frees every command buffer allocated from it as well
+	m_Device.destroyCommandPool(m_CommandPool);
+	if (m_AcquirePool)
+	{
+		m_Device.destroyCommandPool(m_AcquirePool);
+	}
+}
+
+UploadTicket UploadManager::UploadBuffer(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size,
+	vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess)
+{
+	return UploadBuffer(dstBuffer, dstOffset, size, dstStage, dstAccess, [data, size](void* staging) { memcpy(staging, data, size); });
+}
+
+UploadTicket UploadManager::UploadBuffer(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, vk::DeviceSize size,
+	vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess, const std::function<void(void*)>& write)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+	vk::DeviceSize srcOffset;
+	vk::Buffer srcBuffer = AcquireStaging(write, size, 4, srcOffset);
+
+	Batch& batch = OpenBatch();
+	vk::BufferCopy copyRegion{};
+	copyRegion.setSrcOffset(srcOffset)
+			  .setDstOffset(dstOffset)
+			  .setSize(size);
+	batch.BufferCopies.push_back({ srcBuffer, dstBuffer, copyRegion });
+
+	batch.PostCopyBarriers.Buffer(dstBuffer, dstOffset, size,
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, dstStage, dstAccess,
+		IsDedicatedTransfer() ? m_TransferFamily : VK_QUEUE_FAMILY_IGNORED, IsDedicatedTransfer() ? m_GraphicsFamily : VK_QUEUE_FAMILY_IGNORED);
+
+	m_OpenBatchHasWork = true;
+	m_UploadCount++;
+	m_UploadedBytes += size;
+	return batch.Ticket;
+}
+
+UploadTicket UploadManager::UploadImage(vk::Image image, uint32_t width, uint32_t height, const void* data, vk::DeviceSize size,
+	vk::ImageLayout finalLayout, vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+	//bufferOffset has to be a multiple of the texel size, 16 covers every uncompressed format
+	vk::DeviceSize srcOffset;
+	vk::Buffer srcBuffer = AcquireStaging([data, size](void* staging) { memcpy(staging, data, size); }, size, 16, srcOffset);
+
+	Batch& batch = OpenBatch();
+	vk::ImageSubresourceRange subresourceRange;
+	subresourceRange.setAspectMask(vk::ImageAspectFlagBits::eColor)
+					.setBaseArrayLayer(0)
+					.setBaseMipLevel(0)
+					.setLayerCount(1)
+					.setLevelCount(1);
+
+	batch.PreCopyBarriers.Image(image, subresourceRange, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+		vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite);
+
+	vk::ImageSubresourceLayers layer;
+	layer.setAspectMask(vk::ImageAspectFlagBits::eColor)
+		 .setMipLevel(0)
+		 .setBaseArrayLayer(0)
+		 .setLayerCount(1);
+	vk::BufferImageCopy copyInfo{};
+	copyInfo.setBufferOffset(srcOffset)
+			.setBufferRowLength(0)
+			.setBufferImageHeight(0)
+			.setImageExtent(vk::Extent3D(width, height, 1))
+			.setImageOffset(vk::Offset3D(0, 0, 0))
+			.setImageSubresource(layer);
+	batch.ImageCopies.push_back({ srcBuffer, image, copyInfo });
+
+	//with a dedicated transfer queue the layout change happens once, between release and acquire
+	batch.PostCopyBarriers.Image(image, subresourceRange, vk::ImageLayout::eTransferDstOptimal, finalLayout,
+		vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, dstStage, dstAccess,
+		IsDedicatedTransfer() ? m_TransferFamily : VK_QUEUE_FAMILY_IGNORED, IsDedicatedTransfer() ? m_GraphicsFamily : VK_QUEUE_FAMILY_IGNORED);
+
+	m_OpenBatchHasWork = true;
+	m_UploadCount++;
+	m_UploadedBytes += size;
+	return batch.Ticket;
+}
+
+UploadTicket UploadManager::Flush()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+	return FlushLocked();
+}
+
+bool UploadManager::IsComplete(UploadTicket ticket)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+	Retire(false);
+	if (m_HasOpenBatch && m_OpenBatchHasWork && ticket >= m_Open.Ticket)
+	{
+		return false;
+	}
+	return ticket <= m_CompletedTicket;
+}
+
+void UploadManager::Wait(UploadTicket ticket)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+	WaitLocked(ticket);
+}
+
+void UploadManager::WaitIdle()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+	WaitLocked(m_NextTicket);
+}
+
+vk::Buffer UploadManager::AcquireStaging(const std::function<void(void*)>& write, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset)
+{
+	bool allocated = TryAllocateStaging(size, alignment, offset);
+	if (!allocated && m_OpenBatchHasWork)
+	{
+		FlushLocked();
+	}
+	//make room by retiring the oldest batches, the ring is full of data still being read by the GPU
+	while (!allocated && !m_InFlight.empty())
+	{
+		Retire(true);
+		allocated = TryAllocateStaging(size, alignment, offset);
+	}
+
+	if (allocated)
+	{
+		write(static_cast<char*>(m_StagingAllocation.Mapped) + offset);
+		OpenBatch().StagingEnd = m_Head;
+		return m_StagingBuffer;
+	}
+
+	//larger than the whole ring
+	vk::Buffer buffer;
+	vk::BufferCreateInfo bufferInfo{};
+	bufferInfo.sType = vk::StructureType::eBufferCreateInfo;
+	bufferInfo.setSize(size)
+			  .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+			  .setSharingMode(vk::SharingMode::eExclusive);
+	if (m_Device.createBuffer(&bufferInfo, nullptr, &buffer) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to create staging buffer!");
+	}
+	AllocationCreateInfo allocationInfo{};
+	allocationInfo.Properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	allocationInfo.Strategy = AllocationStrategy::Linear;
+	Allocation allocation = m_Allocator->AllocateForBuffer(buffer, allocationInfo);
+	m_Device.bindBufferMemory(buffer, allocation.Memory, allocation.Offset);
+	write(allocation.Mapped);
+
+	OpenBatch().Temporaries.emplace_back(buffer, allocation);
+	offset = 0;
+	return buffer;
+}
+
+bool UploadManager::TryAllocateStaging(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset)
+{
+	if (m_StagingEmpty)
+	{
+		m_Head = 0;
+		m_Tail = 0;
+	}
+	vk::DeviceSize start = AlignUp(m_Head, alignment);
+	if (m_StagingEmpty || m_Head > m_Tail)
+	{
+		//free space is [head, end) followed by [0, tail)
+		if (start + size <= m_StagingSize)
+		{
+			offset = start;
+		}
+		else if (size <= m_Tail)
+		{
+			offset = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if (m_Head < m_Tail && start + size <= m_Tail)
+	{
+		offset = start;
+	}
+	else
+	{
+		return false;
+	}
+	m_Head = offset + size;
+	m_StagingEmpty = false;
+	return true;
+}
+
+UploadManager::Batch& UploadManager::OpenBatch()
+{
+	if (m_HasOpenBatch)
+	{
+		return m_Open;
+	}
+
+	if (!m_Recycled.empty())
+	{
+		m_Open = std::move(m_Recycled.back());
+		m_Recycled.pop_back();
+	}
+	else
+	{
+		m_Open = Batch();
+		vk::CommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = vk::StructureType::eCommandBufferAllocateInfo;
+		allocInfo.setCommandPool(m_CommandPool)
+				 .setCommandBufferCount(1)
+				 .setLevel(vk::CommandBufferLevel::ePrimary);
+		if (m_Device.allocateCommandBuffers(&allocInfo, &m_Open.CommandBuffer) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+		if (IsDedicatedTransfer())
+		{
+			allocInfo.setCommandPool(m_AcquirePool);
+			if (m_Device.allocateCommandBuffers(&allocInfo, &m_Open.AcquireCommandBuffer) != vk::Result::eSuccess)
+			{
+				throw std::runtime_error("failed to allocate upload command buffer!");
+			}
+			vk::SemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = vk::StructureType::eSemaphoreCreateInfo;
+			if (m_Device.createSemaphore(&semaphoreInfo, nullptr, &m_Open.Handoff) != vk::Result::eSuccess)
+			{
+				throw std::runtime_error("failed to create upload semaphore!");
+			}
+		}
+		if (!m_Timeline)
+		{
+			vk::FenceCreateInfo fenceInfo{};
+			fenceInfo.sType = vk::StructureType::eFenceCreateInfo;
+			if (m_Device.createFence(&fenceInfo, nullptr, &m_Open.Fence) != vk::Result::eSuccess)
+			{
+				throw std::runtime_error("failed to create upload fence!");
+			}
+		}
+	}
+
+	m_Open.Ticket = m_NextTicket;
+	m_Open.StagingEnd = m_Head;
+	m_HasOpenBatch = true;
+	m_OpenBatchHasWork = false;
+	return m_Open;
+}
+
+UploadTicket UploadManager::FlushLocked()
+{
+	if (!m_HasOpenBatch || !m_OpenBatchHasWork)
+	{
+		return m_NextTicket - 1;
+	}
+
+	Batch& batch = m_Open;
+	RecordBatch(batch);
+
+	vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = vk::StructureType::eTimelineSemaphoreSubmitInfo;
+	timelineInfo.setSignalSemaphoreValueCount(1)
+				.setPSignalSemaphoreValues(&batch.Ticket);
+
+	vk::SubmitInfo submitInfo{};
+	submitInfo.sType = vk::StructureType::eSubmitInfo;
+	submitInfo.setCommandBufferCount(1)
+			  .setPCommandBuffers(&batch.CommandBuffer);
+
+	if (!IsDedicatedTransfer())
+	{
+		if (m_Timeline)
+		{
+			submitInfo.setPNext(&timelineInfo)
+					  .setSignalSemaphoreCount(1)
+					  .setPSignalSemaphores(&m_TimelineSemaphore);
+		}
+		if (m_TransferQueue.submit(1, &submitInfo, batch.Fence) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+	}
+	else
+	{
+		submitInfo.setSignalSemaphoreCount(1)
+				  .setPSignalSemaphores(&batch.Handoff);
+		if (m_TransferQueue.submit(1, &submitInfo, VK_NULL_HANDLE) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to submit upload batch!");
+		}
+
+		//acquire on the graphics queue once the copies are done, the source access mask is ignored here.
+		//the source stages chain with the semaphore wait below
+		for (auto& barrier : batch.PostCopyBarriers.Buffers())
+		{
+			barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+				   .setSrcAccessMask({});
+		}
+		for (auto& barrier : batch.PostCopyBarriers.Images())
+		{
+			barrier.setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+				   .setSrcAccessMask({});
+		}
+		vk::CommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = vk::StructureType::eCommandBufferBeginInfo;
+		beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		if (batch.AcquireCommandBuffer.begin(&beginInfo) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to begin upload command buffer!");
+		}
+		batch.PostCopyBarriers.Record(batch.AcquireCommandBuffer, m_Synchronization2);
+		batch.AcquireCommandBuffer.end();
+
+		vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+		vk::SubmitInfo acquireInfo{};
+		acquireInfo.sType = vk::StructureType::eSubmitInfo;
+		acquireInfo.setWaitSemaphoreCount(1)
+				   .setPWaitSemaphores(&batch.Handoff)
+				   .setPWaitDstStageMask(&waitStage)
+				   .setCommandBufferCount(1)
+				   .setPCommandBuffers(&batch.AcquireCommandBuffer);
+		if (m_Timeline)
+		{
+			acquireInfo.setPNext(&timelineInfo)
+					   .setSignalSemaphoreCount(1)
+					   .setPSignalSemaphores(&m_TimelineSemaphore);
+		}
+		if (m_GraphicsQueue.submit(1, &acquireInfo, batch.Fence) != vk::Result::eSuccess)
+		{
+			throw std::runtime_error("failed to submit upload acquire!");
+		}
+	}
+	batch.BufferCopies.clear();
+	batch.ImageCopies.clear();
+	batch.PreCopyBarriers.Clear();
+	batch.PostCopyBarriers.Clear();
+
+	UploadTicket ticket = m_Open.Ticket;
+	m_InFlight.push_back(std::move(m_Open));
+	m_Open = Batch();
+	m_HasOpenBatch = false;
+	m_OpenBatchHasWork = false;
+	m_NextTicket++;
+	m_SubmittedBatches++;
+	return ticket;
+}
+
+void UploadManager::RecordBatch(Batch& batch)
+{
+	vk::CommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = vk::StructureType::eCommandBufferBeginInfo;
+	beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+	if (batch.CommandBuffer.begin(&beginInfo) != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to begin upload command buffer!");
+	}
+
+	batch.PreCopyBarriers.Record(batch.CommandBuffer, m_Synchronization2);
+	//consecutive copies between the same pair of buffers go out as one command
+	for (size_t first = 0; first < batch.BufferCopies.size();)
+	{
+		std::vector<vk::BufferCopy> regions;
+		size_t last = first;
+		for (; last < batch.BufferCopies.size() && batch.BufferCopies[last].Src == batch.BufferCopies[first].Src &&
+			batch.BufferCopies[last].Dst == batch.BufferCopies[first].Dst; last++)
+		{
+			regions.push_back(batch.BufferCopies[last].Region);
+		}
+		batch.CommandBuffer.copyBuffer(batch.BufferCopies[first].Src, batch.BufferCopies[first].Dst, regions);
+		first = last;
+	}
+	for (auto& copy : batch.ImageCopies)
+	{
+		batch.CommandBuffer.copyBufferToImage(copy.Src, copy.Dst, vk::ImageLayout::eTransferDstOptimal, 1, &copy.Region);
+	}
+
+	if (IsDedicatedTransfer())
+	{
+		//release on the transfer queue: the destination stages and access are ignored there
+		BarrierBatch releases = batch.PostCopyBarriers;
+		for (auto& barrier : releases.Buffers())
+		{
+			barrier.setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+				   .setDstAccessMask({});
+		}
+		for (auto& barrier : releases.Images())
+		{
+			barrier.setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+				   .setDstAccessMask({});
+		}
+		releases.Record(batch.CommandBuffer, m_Synchronization2);
+	}
+	else
+	{
+		batch.PostCopyBarriers.Record(batch.CommandBuffer, m_Synchronization2);
+	}
+	batch.CommandBuffer.end();
+}
+
+void UploadManager::WaitLocked(UploadTicket ticket)
+{
+	if (m_HasOpenBatch && m_OpenBatchHasWork && ticket >= m_Open.Ticket)
+	{
+		FlushLocked();
+	}
+	while (m_CompletedTicket < ticket && !m_InFlight.empty())
+	{
+		Retire(true);
+	}
+}
+
+void UploadManager::Retire(bool wait)
+{
+	if (wait && !m_InFlight.empty())
+	{
+		Batch& oldest = m_InFlight.front();
+		if (m_Timeline)
+		{
+			vk::SemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = vk::StructureType::eSemaphoreWaitInfo;
+			waitInfo.setSemaphoreCount(1)
+					.setPSemaphores(&m_TimelineSemaphore)
+					.setPValues(&oldest.Ticket);
+			if (m_Device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess)
+			{
+				throw std::runtime_error("failed to wait for upload batch!");
+			}
+		}
+		else
+		{
+			m_Device.waitForFences(1, &oldest.Fence, VK_TRUE, UINT64_MAX);
+		}
+	}
+
+	while (!m_InFlight.empty() && IsSignaled(m_InFlight.front()))
+	{
+		Batch batch = std::move(m_InFlight.front());
+		m_InFlight.pop_front();
+		for (auto& temporary : batch.Temporaries)
+		{
+			m_Device.destroyBuffer(temporary.first);
+			m_Allocator->Free(temporary.second);
+		}
+		batch.Temporaries.clear();
+		m_Tail = batch.StagingEnd;
+		m_CompletedTicket = batch.Ticket;
+
+		batch.CommandBuffer.reset();
+		if (batch.AcquireCommandBuffer)
+		{
+			batch.AcquireCommandBuffer.reset();
+		}
+		if (batch.Fence)
+		{
+			m_Device.resetFences(1, &batch.Fence);
+		}
+		m_Recycled.push_back(std::move(batch));
+	}
+
+	if (m_InFlight.empty() && !(m_HasOpenBatch && m_OpenBatchHasWork))
+	{
+		m_StagingEmpty = true;
+	}
+}
+
+bool UploadManager::IsSignaled(const Batch& batch)
+{
+	if (m_Timeline)
+	{
+		return m_Device.getSemaphoreCounterValue(m_TimelineSemaphore) >= batch.Ticket;
+	}
+	return m_Device.getFenceStatus(batch.Fence) == vk::Result::eSuccess;
+}
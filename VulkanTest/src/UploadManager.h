@@ -0,0 +1,121 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "BarrierBatch.h"
+
+//identifies the batch an upload was recorded into, tickets of later batches are always larger
+using UploadTicket = uint64_t;
+
+//copies data to device-local resources through a persistent staging ring, many copies share one submission.
+//copies run on a dedicated transfer queue when there is one, ownership then moves to the graphics queue at the end of each batch
+class UploadManager
+{
+public:
+	//with timeline set completion is tracked by one timeline semaphore, otherwise by a fence per batch.
+	//the graphics queue is only submitted to from Flush, on the same thread that renders
+	void Init(vk::Device device, MemoryAllocator* allocator, vk::Queue transferQueue, uint32_t transferFamily,
+		vk::Queue graphicsQueue, uint32_t graphicsFamily, vk::DeviceSize stagingSize, bool timeline, bool synchronization2);
+	void Destroy();
+
+	//the data is visible to dstStage/dstAccess on the graphics queue once the ticket completes
+	UploadTicket UploadBuffer(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size,
+		vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess);
+	//write fills the size bytes of staging memory directly, for data that is produced (or converted) while uploading
+	UploadTicket UploadBuffer(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, vk::DeviceSize size,
+		vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess, const std::function<void(void*)>& write);
+	//whole-image upload of mip 0: undefined -> transfer dst -> finalLayout
+	UploadTicket UploadImage(vk::Image image, uint32_t width, uint32_t height, const void* data, vk::DeviceSize size,
+		vk::ImageLayout finalLayout, vk::PipelineStageFlags2 dstStage, vk::AccessFlags2 dstAccess);
+
+	//submit everything recorded so far, returns the ticket of that batch
+	UploadTicket Flush();
+	bool IsComplete(UploadTicket ticket);
+	//flushes first when the ticket belongs to the batch still being recorded
+	void Wait(UploadTicket ticket);
+	void WaitIdle();
+
+private:
+	struct BufferCopy
+	{
+		vk::Buffer Src;
+		vk::Buffer Dst;
+		vk::BufferCopy Region;
+	};
+
+	struct ImageCopy
+	{
+		vk::Buffer Src;
+		vk::Image Dst;
+		vk::BufferImageCopy Region;
+	};
+
+	//nothing is recorded until Flush, the batch then becomes one barrier call, the copies and one more barrier call
+	struct Batch
+	{
+		UploadTicket Ticket = 0;
+		vk::CommandBuffer CommandBuffer;
+		//graphics-queue side of the ownership transfer, only used with a dedicated transfer queue
+		vk::CommandBuffer AcquireCommandBuffer;
+		vk::Semaphore Handoff;
+		vk::Fence Fence;
+		std::vector<BufferCopy> BufferCopies;
+		std::vector<ImageCopy> ImageCopies;
+		//undefined -> transfer dst for every image of the batch
+		BarrierBatch PreCopyBarriers;
+		//transfer write -> consumer, doubles as the release/acquire pair with a dedicated transfer queue
+		BarrierBatch PostCopyBarriers;
+		//ring position right after this batch's last staging range, the tail moves here once it retires
+		vk::DeviceSize StagingEnd = 0;
+		//uploads larger than the whole ring get a staging buffer of their own
+		std::vector<std::pair<vk::Buffer, Allocation>> Temporaries;
+	};
+
+	//returns the offset of size bytes inside the ring and the buffer to copy from, write fills them
+	vk::Buffer AcquireStaging(const std::function<void(void*)>& write, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset);
+	bool TryAllocateStaging(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset);
+	Batch& OpenBatch();
+	UploadTicket FlushLocked();
+	void RecordBatch(Batch& batch);
+	void WaitLocked(UploadTicket ticket);
+	//retire finished batches from the front, blocking on the oldest one if wait is set
+	void Retire(bool wait);
+	bool IsSignaled(const Batch& batch);
+	bool IsDedicatedTransfer() const { return m_TransferFamily != m_GraphicsFamily; }
+
+private:
+	vk::Device m_Device;
+	MemoryAllocator* m_Allocator = nullptr;
+	vk::Queue m_TransferQueue;
+	uint32_t m_TransferFamily = 0;
+	vk::Queue m_GraphicsQueue;
+	uint32_t m_GraphicsFamily = 0;
+	vk::CommandPool m_CommandPool;
+	vk::CommandPool m_AcquirePool;
+	bool m_Timeline = false;
+	bool m_Synchronization2 = false;
+	vk::Semaphore m_TimelineSemaphore;
+
+	std::recursive_mutex m_Mutex;
+	vk::Buffer m_StagingBuffer;
+	Allocation m_StagingAllocation;
+	vk::DeviceSize m_StagingSize = 0;
+	vk::DeviceSize m_Head = 0;
+	vk::DeviceSize m_Tail = 0;
+	bool m_StagingEmpty = true;
+
+	bool m_HasOpenBatch = false;
+	bool m_OpenBatchHasWork = false;
+	Batch m_Open;
+	std::deque<Batch> m_InFlight;
+	std::vector<Batch> m_Recycled;
+	UploadTicket m_NextTicket = 1;
+	UploadTicket m_CompletedTicket = 0;
+
+	uint64_t m_SubmittedBatches = 0;
+	uint64_t m_UploadCount = 0;
+	uint64_t m_UploadedBytes = 0;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm.hpp>
+
+//compile-time vertex input descriptions: a layout is a list of streams (bindings), a stream a list of attributes of
+//one vertex struct. everything is derived from the declared members, the descriptions are constexpr std::arrays
+//
+//	using MyLayout = VertexLayout<
+//		VertexStream<MyVertex, 0, vk::VertexInputRate::eVertex, VERTEX_ATTRIBUTE(MyVertex, position, 0)>,
+//		VertexStream<MyInstance, 1, vk::VertexInputRate::eInstance, VERTEX_ATTRIBUTE(MyInstance, offset, 1)>>;
+//	static_assert(MyLayout::MatchesLocations<0, 1>());
+
+//the format a member type is fetched with, specialize for packed types
+template<typename T>
+struct VertexFormatOf;
+
+template<> struct VertexFormatOf<float> { static constexpr vk::Format Value = vk::Format::eR32Sfloat; };
+template<> struct VertexFormatOf<glm::vec2> { static constexpr vk::Format Value = vk::Format::eR32G32Sfloat; };
+template<> struct VertexFormatOf<glm::vec3> { static constexpr vk::Format Value = vk::Format::eR32G32B32Sfloat; };
+template<> struct VertexFormatOf<glm::vec4> { static constexpr vk::Format Value = vk::Format::eR32G32B32A32Sfloat; };
+template<> struct VertexFormatOf<uint32_t> { static constexpr vk::Format Value = vk::Format::eR32Uint; };
+template<> struct VertexFormatOf<glm::uvec2> { static constexpr vk::Format Value = vk::Format::eR32G32Uint; };
+template<> struct VertexFormatOf<glm::uvec4> { static constexpr vk::Format Value = vk::Format::eR32G32B32A32Uint; };
+template<> struct VertexFormatOf<glm::ivec4> { static constexpr vk::Format Value = vk::Format::eR32G32B32A32Sint; };
+
+template<uint32_t AttributeLocation, vk::Format AttributeFormat, uint32_t AttributeOffset, uint32_t AttributeSize>
+struct VertexAttribute
+{
+	static constexpr uint32_t Location = AttributeLocation;
+	static constexpr vk::Format Format = AttributeFormat;
+	static constexpr uint32_t Offset = AttributeOffset;
+	static constexpr uint32_t Size = AttributeSize;
+};
+
+//member of a vertex struct at a shader location, the format follows the member's type
+#define VERTEX_ATTRIBUTE(Vertex, member, location) \
+	VertexAttribute<location, VertexFormatOf<decltype(Vertex::member)>::Value, offsetof(Vertex, member), sizeof(Vertex::member)>
+//same with an explicit format, for members whose type does not say how to fetch them (packed, normalized)
+#define VERTEX_ATTRIBUTE_FORMAT(Vertex, member, location, format) \
+	VertexAttribute<location, format, offsetof(Vertex, member), sizeof(Vertex::member)>
+
+template<typename Vertex, uint32_t StreamBinding, vk::VertexInputRate StreamRate, typename... Attributes>
+struct VertexStream
+{
+	using Type = Vertex;
+	static constexpr uint32_t Binding = StreamBinding;
+	static constexpr uint32_t Stride = sizeof(Vertex);
+	static constexpr size_t AttributeCount = sizeof...(Attributes);
+	static_assert(AttributeCount > 0, "a vertex stream needs at least one attribute");
+	static_assert(((Attributes::Offset + Attributes::Size <= sizeof(Vertex)) && ...), "attribute reaches past the end of the vertex");
+
+	static constexpr vk::VertexInputBindingDescription GetBinding()
+	{
+		return vk::VertexInputBindingDescription(Binding, Stride, StreamRate);
+	}
+
+	static constexpr std::array<vk::VertexInputAttributeDescription, AttributeCount> GetAttributes()
+	{
+		return { vk::VertexInputAttributeDescription(Attributes::Location, Binding, Attributes::Format, Attributes::Offset)... };
+	}
+};
+
+namespace VertexLayoutDetail
+{
+	template<size_t AttributeCount, size_t BindingCount>
+	constexpr bool IsUnique(const std::array<vk::VertexInputAttributeDescription, AttributeCount>& attributes,
+		const std::array<vk::VertexInputBindingDescription, BindingCount>& bindings)
+	{
+		for (size_t i = 0; i < AttributeCount; i++)
+		{
+			for (size_t j = i + 1; j < AttributeCount; j++)
+			{
+				if (attributes[i].location == attributes[j].location)
+				{
+					return false;
+				}
+			}
+		}
+		for (size_t i = 0; i < BindingCount; i++)
+		{
+			for (size_t j = i + 1; j < BindingCount; j++)
+			{
+				if (bindings[i].binding == bindings[j].binding)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+template<typename... Streams>
+struct VertexLayout
+{
+	static constexpr size_t BindingCount = sizeof...(Streams);
+	static constexpr size_t AttributeCount = (Streams::AttributeCount + ...);
+
+	static constexpr std::array<vk::VertexInputBindingDescription, BindingCount> Bindings = { Streams::GetBinding()... };
+	static constexpr std::array<vk::VertexInputAttributeDescription, AttributeCount> Attributes = []()
+	{
+		std::array<vk::VertexInputAttributeDescription, AttributeCount> attributes{};
+		size_t next = 0;
+		([&]()
+		{
+			for (const auto& attribute : Streams::GetAttributes())
+			{
+				attributes[next++] = attribute;
+			}
+		}(), ...);
+		return attributes;
+	}();
+
+	static constexpr bool HasLocation(uint32_t location)
+	{
+		for (const auto& attribute : Attributes)
+		{
+			if (attribute.location == location)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//true when the layout feeds exactly these shader input locations, for static_assert next to the shader it is used with
+	template<uint32_t... Locations>
+	static constexpr bool MatchesLocations()
+	{
+		return sizeof...(Locations) == AttributeCount && (HasLocation(Locations) && ...);
+	}
+
+	static_assert(VertexLayoutDetail::IsUnique(Attributes, Bindings), "vertex layout uses a location or binding twice");
+};
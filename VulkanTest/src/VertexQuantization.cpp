@@ -0,0 +1,188 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "VertexQuantization.h"
+
+namespace
+{
+	int16_t ToSnorm16(float value)
+	{
+		return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	uint16_t ToUnorm16(float value)
+	{
+		return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	uint16_t ToHalf(float value)
+	{
+		return static_cast<uint16_t>(glm::packHalf2x16(glm::vec2(value, 0.0f)) & 0xffff);
+	}
+
+	//bounds with zero extent keep a scale of 1 so nothing divides by zero
+	float SafeScale(float extent)
+	{
+		return extent > 0.0f ? extent : 1.0f;
+	}
+
+	template<typename T>
+	void Write(uint8_t* destination, const T& value)
+	{
+		memcpy(destination, &value, sizeof(T));
+	}
+}
+
+uint32_t GetFormatSize(VertexAttributeFormat format)
+{
+	switch (format)
+	{
+	case VertexAttributeFormat::Float2: return 8;
+	case VertexAttributeFormat::Float3: return 12;
+	case VertexAttributeFormat::Half2: return 4;
+	case VertexAttributeFormat::Half4: return 8;
+	case VertexAttributeFormat::Snorm16x2: return 4;
+	case VertexAttributeFormat::Snorm16x4: return 8;
+	case VertexAttributeFormat::Unorm16x2: return 4;
+	}
+	return 0;
+}
+
+glm::vec2 EncodeOctahedral(const glm::vec3& normal)
+{
+	float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length == 0.0f)
+	{
+		return glm::vec2(0.0f);
+	}
+	glm::vec3 n = normal / length;
+	glm::vec2 encoded(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		//fold the lower hemisphere over the diagonals
+		encoded.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		encoded.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return encoded;
+}
+
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded)
+{
+	glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+PackedVertices EncodeVertices(const std::vector<MeshVertex>& vertices, const VertexEncoding& encoding)
+{
+	PackedVertices packed;
+	VertexAttributeFormat positionFormat = encoding.Position == PositionEncoding::Float32 ? VertexAttributeFormat::Float3
+		: encoding.Position == PositionEncoding::Half ? VertexAttributeFormat::Half4 : VertexAttributeFormat::Snorm16x4;
+	VertexAttributeFormat normalFormat = encoding.Normal == NormalEncoding::Float32 ? VertexAttributeFormat::Float3 : VertexAttributeFormat::Snorm16x2;
+	VertexAttributeFormat texCoordFormat = encoding.TexCoord == TexCoordEncoding::Float32 ? VertexAttributeFormat::Float2
+		: encoding.TexCoord == TexCoordEncoding::Half ? VertexAttributeFormat::Half2 : VertexAttributeFormat::Unorm16x2;
+	for (VertexAttributeFormat format : { positionFormat, normalFormat, texCoordFormat })
+	{
+		packed.Attributes.push_back({ static_cast<uint32_t>(packed.Attributes.size()), format, packed.Stride });
+		packed.Stride += GetFormatSize(format);
+	}
+
+	glm::vec3 minPosition(0.0f), maxPosition(0.0f);
+	glm::vec2 minCoord(0.0f), maxCoord(0.0f);
+	if (!vertices.empty())
+	{
+		minPosition = maxPosition = vertices[0].Position;
+		minCoord = maxCoord = vertices[0].TexCoord;
+	}
+	for (const MeshVertex& vertex : vertices)
+	{
+		minPosition = glm::min(minPosition, vertex.Position);
+		maxPosition = glm::max(maxPosition, vertex.Position);
+		minCoord = glm::min(minCoord, vertex.TexCoord);
+		maxCoord = glm::max(maxCoord, vertex.TexCoord);
+	}
+
+	VertexDequantization& dequantization = packed.Dequantization;
+	glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+	glm::vec3 halfExtent = (maxPosition - minPosition) * 0.5f;
+	if (encoding.Position == PositionEncoding::Half)
+	{
+		dequantization.PositionOffset = glm::vec4(center, 0.0f);
+	}
+	else if (encoding.Position == PositionEncoding::Snorm16)
+	{
+		dequantization.PositionScale = glm::vec4(SafeScale(halfExtent.x), SafeScale(halfExtent.y), SafeScale(halfExtent.z), 1.0f);
+		dequantization.PositionOffset = glm::vec4(center, 0.0f);
+	}
+	dequantization.PositionOffset.w = encoding.Normal == NormalEncoding::Octahedral ? 1.0f : 0.0f;
+	if (encoding.TexCoord == TexCoordEncoding::Unorm16)
+	{
+		glm::vec2 extent = maxCoord - minCoord;
+		dequantization.TexCoordScaleOffset = glm::vec4(SafeScale(extent.x), SafeScale(extent.y), minCoord.x, minCoord.y);
+	}
+	glm::vec3 positionScale(dequantization.PositionScale);
+	glm::vec3 positionOffset(dequantization.PositionOffset);
+	glm::vec2 coordScale(dequantization.TexCoordScaleOffset.x, dequantization.TexCoordScaleOffset.y);
+	glm::vec2 coordOffset(dequantization.TexCoordScaleOffset.z, dequantization.TexCoordScaleOffset.w);
+
+	packed.Data.resize(vertices.size() * packed.Stride);
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const MeshVertex& vertex = vertices[i];
+		uint8_t* destination = packed.Data.data() + i * packed.Stride;
+
+		glm::vec3 position = (vertex.Position - positionOffset) / positionScale;
+		uint8_t* attribute = destination + packed.Attributes[0].Offset;
+		if (encoding.Position == PositionEncoding::Float32)
+		{
+			Write(attribute, position);
+		}
+		else if (encoding.Position == PositionEncoding::Half)
+		{
+			uint16_t half[4] = { ToHalf(position.x), ToHalf(position.y), ToHalf(position.z), ToHalf(1.0f) };
+			Write(attribute, half);
+		}
+		else
+		{
+			int16_t snorm[4] = { ToSnorm16(position.x), ToSnorm16(position.y), ToSnorm16(position.z), 32767 };
+			Write(attribute, snorm);
+		}
+
+		attribute = destination + packed.Attributes[1].Offset;
+		if (encoding.Normal == NormalEncoding::Float32)
+		{
+			Write(attribute, vertex.Normal);
+		}
+		else
+		{
+			glm::vec2 octahedral = EncodeOctahedral(vertex.Normal);
+			int16_t snorm[2] = { ToSnorm16(octahedral.x), ToSnorm16(octahedral.y) };
+			Write(attribute, snorm);
+		}
+
+		glm::vec2 coord = (vertex.TexCoord - coordOffset) / coordScale;
+		attribute = destination + packed.Attributes[2].Offset;
+		if (encoding.TexCoord == TexCoordEncoding::Float32)
+		{
+			Write(attribute, coord);
+		}
+		else if (encoding.TexCoord == TexCoordEncoding::Half)
+		{
+			uint16_t half[2] = { ToHalf(coord.x), ToHalf(coord.y) };
+			Write(attribute, half);
+		}
+		else
+		{
+			uint16_t unorm[2] = { ToUnorm16(coord.x), ToUnorm16(coord.y) };
+			Write(attribute, unorm);
+		}
+	}
+
+	std::cout << "vertex encoding: " << packed.Stride << " bytes per vertex (" << sizeof(MeshVertex) << " unpacked), "
+			  << packed.Data.size() << " bytes total" << std::endl;
+	return packed;
+}
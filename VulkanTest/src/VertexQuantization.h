@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "MeshLoader.h"
+
+enum class PositionEncoding
+{
+	Float32,
+	//relative to the bounds' centre, keeps half's precision where the mesh is
+	Half,
+	//the bounds mapped to [-1, 1] per axis
+	Snorm16
+};
+
+enum class NormalEncoding
+{
+	Float32,
+	//unit vector folded onto an octahedron, two snorm16
+	Octahedral
+};
+
+enum class TexCoordEncoding
+{
+	Float32,
+	Half,
+	//the coordinate bounds mapped to [0, 1]
+	Unorm16
+};
+
+struct VertexEncoding
+{
+	PositionEncoding Position = PositionEncoding::Snorm16;
+	NormalEncoding Normal = NormalEncoding::Octahedral;
+	TexCoordEncoding TexCoord = TexCoordEncoding::Unorm16;
+};
+
+//the formats packed vertices use, mapped to the graphics API's own by the renderer
+enum class VertexAttributeFormat
+{
+	Float2,
+	Float3,
+	Half2,
+	//three used, the fourth pads to 8 bytes since 3x16-bit formats are rarely supported for vertex fetch
+	Half4,
+	Snorm16x2,
+	Snorm16x4,
+	Unorm16x2
+};
+
+struct PackedVertexAttribute
+{
+	uint32_t Location;
+	VertexAttributeFormat Format;
+	uint32_t Offset;
+};
+
+//what the vertex shader needs to undo the quantization: value = fetched * Scale + Offset
+struct VertexDequantization
+{
+	glm::vec4 PositionScale = glm::vec4(1.0f);
+	//w is 1 for octahedral normals
+	glm::vec4 PositionOffset = glm::vec4(0.0f);
+	//xy scale, zw offset
+	glm::vec4 TexCoordScaleOffset = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+//interleaved vertices in the layout described by Attributes: position at location 0, normal at 1, texcoord at 2
+struct PackedVertices
+{
+	std::vector<uint8_t> Data;
+	uint32_t Stride = 0;
+	std::vector<PackedVertexAttribute> Attributes;
+	VertexDequantization Dequantization;
+
+	size_t GetVertexCount() const { return Stride ? Data.size() / Stride : 0; }
+};
+
+PackedVertices EncodeVertices(const std::vector<MeshVertex>& vertices, const VertexEncoding& encoding);
+uint32_t GetFormatSize(VertexAttributeFormat format);
+
+glm::vec2 EncodeOctahedral(const glm::vec3& normal);
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded);
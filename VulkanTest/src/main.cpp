@@ -1,16 +1,200 @@
 #include "Application.h"
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
-int main()
+//a malformed value, or one below minimum, is reported and leaves the default in place
+static void ParseValue(const std::string& flag, const std::string& value, uint32_t& target, uint32_t minimum = 0)
 {
-	Application app;
 	try
 	{
-		app.Run();
+		unsigned long parsed = std::stoul(value);
+		if (parsed > UINT32_MAX || parsed < minimum)
+		{
+			throw std::out_of_range(flag);
+		}
+		target = static_cast<uint32_t>(parsed);
+	}
+	catch (const std::exception&)
+	{
+		std::cout << "invalid value for " << flag << ": " << value << std::endl;
+	}
+}
+
+static void ParseValue(const std::string& flag, const std::string& value, float& target)
+{
+	try
+	{
+		target = std::stof(value);
+	}
+	catch (const std::exception&)
+	{
+		std::cout << "invalid value for " << flag << ": " << value << std::endl;
+	}
+}
+
+static ApplicationConfig ParseCommandLine(int argc, char** argv)
+{
+	ApplicationConfig config;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--headless")
+		{
+			config.Headless = true;
+		}
+		else if (arg == "--frames" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.FrameCount);
+		}
+		else if (arg == "--frames-in-flight" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.FramesInFlight);
+		}
+		else if (arg == "--present" && hasValue)
+		{
+			std::string policy = argv[++i];
+			if (policy == "lowlatency")
+			{
+				config.Present = PresentPolicy::LowLatency;
+			}
+			else if (policy == "vsync")
+			{
+				config.Present = PresentPolicy::VSync;
+			}
+			else if (policy == "capped")
+			{
+				config.Present = PresentPolicy::Capped;
+			}
+			else if (policy == "immediate")
+			{
+				config.Present = PresentPolicy::Immediate;
+			}
+			else
+			{
+				std::cout << "unknown present policy: " << policy << std::endl;
+			}
+		}
+		else if (arg == "--fps-cap" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.FrameRateCap);
+		}
+		else if (arg == "--no-dynamic-rendering")
+		{
+			config.DynamicRendering = false;
+		}
+		else if (arg == "--mesh" && hasValue)
+		{
+			config.MeshPath = argv[++i];
+		}
+		else if (arg == "--no-mesh-optimize")
+		{
+			config.MeshOptimization = false;
+		}
+		else if (arg == "--vertex-format" && hasValue)
+		{
+			std::string format = argv[++i];
+			if (format == "float")
+			{
+				config.MeshEncoding = { PositionEncoding::Float32, NormalEncoding::Float32, TexCoordEncoding::Float32 };
+			}
+			else if (format == "half")
+			{
+				config.MeshEncoding = { PositionEncoding::Half, NormalEncoding::Octahedral, TexCoordEncoding::Half };
+			}
+			else if (format == "packed")
+			{
+				config.MeshEncoding = { PositionEncoding::Snorm16, NormalEncoding::Octahedral, TexCoordEncoding::Unorm16 };
+			}
+			else
+			{
+				std::cout << "unknown vertex format: " << format << std::endl;
+			}
+		}
+		else if (arg == "--no-meshlets")
+		{
+			config.Meshlets = false;
+		}
+		else if (arg == "--objects" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.ObjectCount);
+		}
+		else if (arg == "--materials" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.MaterialCount);
+		}
+		else if (arg == "--no-cpu-culling")
+		{
+			config.CpuCulling = false;
+		}
+		else if (arg == "--no-lods")
+		{
+			config.Lods = false;
+		}
+		else if (arg == "--lod-error" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.LodErrorPixels);
+		}
+		else if (arg == "--bvh-threshold" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.BvhThreshold);
+		}
+		else if (arg == "--cull-benchmark" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.CullBenchmark);
+		}
+		else if (arg == "--no-gpu-culling")
+		{
+			config.GpuCulling = false;
+		}
+		else if (arg == "--width" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.Width, 1);
+		}
+		else if (arg == "--height" && hasValue)
+		{
+			ParseValue(arg, argv[++i], config.Height, 1);
+		}
+		else if (arg == "--device" && hasValue)
+		{
+			config.DeviceOverride = argv[++i];
+		}
+		else if (arg == "--pipeline-cache" && hasValue)
+		{
+			config.PipelineCachePath = argv[++i];
+		}
+		else if (arg == "--pipeline-warmup" && hasValue)
+		{
+			config.PipelineWarmupPath = argv[++i];
+		}
+		else
+		{
+			std::cout << "ignoring unknown argument: " << arg << std::endl;
+		}
+	}
+	return config;
+}
+
+int main(int argc, char** argv)
+{
+	ApplicationConfig config = ParseCommandLine(argc, argv);
+	try
+	{
+		if (config.CullBenchmark > 0)
+		{
+			BenchmarkFrustumCulling(config.CullBenchmark);
+		}
+		else
+		{
+			Application app(config);
+			app.Run();
+		}
 	}
 	catch (const std::exception& e)
 	{
 		std::cout << e.what() << std::endl;
 	}
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <vector>
+#include <algorithm>
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t threadCount = DefaultThreadCount())
+	{
+		threadCount = (std::max)(threadCount, 1u);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			m_Workers.emplace_back([this] { WorkerLoop(); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Condition.notify_all();
+		for (auto& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template<typename Task>
+	auto Submit(Task&& task) -> std::future<decltype(task())>
+	{
+		using Result = decltype(task());
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+		std::future<Result> future = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Tasks.emplace([packaged] { (*packaged)(); });
+		}
+		m_Condition.notify_one();
+		return future;
+	}
+
+	uint32_t Size() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	//leave one core for the thread that feeds the pool
+	static uint32_t DefaultThreadCount()
+	{
+		uint32_t cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 1;
+	}
+
+private:
+	void WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Condition.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+				if (m_Stopping && m_Tasks.empty())
+				{
+					return;
+				}
+				task = std::move(m_Tasks.front());
+				m_Tasks.pop();
+			}
+			task();
+		}
+	}
+
+private:
+	std::vector<std::thread> m_Workers;
+	std::queue<std::function<void()>> m_Tasks;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_Stopping = false;
+};